@@ -39,6 +39,10 @@
 
 #define ReadStructOrDie(f, s)  ReadOrDie(f, (char *) &(s), sizeof (s))
 
+/// Size of a page of Nachos memory; must match `PAGE_SIZE` in
+/// `machine/mmu.hh`.
+#define PAGE_SIZE  128
+
 static char *outFileName = NULL;
 
 static void
@@ -205,6 +209,21 @@ main(int argc, char *argv[])
         free(name);
     }
 
+    /// The kernel shares the pages that hold only code among the processes
+    /// running the program, which the last one cannot if the data starts
+    /// inside it.
+    if (noffH.code.size % PAGE_SIZE != 0) {
+        unsigned codeEnd = noffH.code.virtualAddr + noffH.code.size;
+        unsigned lastPage = codeEnd / PAGE_SIZE;
+        if ((noffH.initData.size != 0
+               && noffH.initData.virtualAddr / PAGE_SIZE == lastPage)
+            || (noffH.uninitData.size != 0
+               && noffH.uninitData.virtualAddr / PAGE_SIZE == lastPage)) {
+            printf("WARNING: data is not page aligned, so the last page of "
+                   "code will not be shared.\n");
+        }
+    }
+
     fseek(out, 0, SEEK_SET);
     WriteOrDie(out, (const char *) &noffH, sizeof noffH);
     fclose(in);
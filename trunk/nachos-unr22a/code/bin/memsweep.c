@@ -0,0 +1,207 @@
+/// Program that runs Nachos with main memories of several sizes, and plots
+/// how the page faults and the running time of a workload vary with them.
+///
+/// Usage:
+///
+///     memsweep <min pages> <max pages> <step> <nachos> [<arguments>]
+///
+/// For every size, `nachos` is run as `nachos -m <pages> <arguments>`, and
+/// the statistics it prints when it halts are read from its output: the
+/// total ticks, the page faults (TLB misses in builds with a TLB) and the
+/// page-ins and evictions of the replacement policy.  The program prints a
+/// table with a row per size, followed by a curve of page-ins and one of
+/// ticks.  Sizes where Nachos does not exit successfully, for instance
+/// because an assertion fails, are reported and left out.
+///
+/// For example, from the `vmem` directory:
+///
+///     ../bin/memsweep 4 32 4 ./nachos -rp lru -x ../userland/sort
+///
+/// Copyright (c) 2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+
+
+#define MAX_RUNS     256
+#define COMMAND_SIZE 4096
+#define PLOT_WIDTH   60
+
+typedef struct {
+    unsigned pages;
+    unsigned long long ticks;
+    unsigned long faults;
+    unsigned long pageIns;
+    unsigned long evictions;
+    int complete;
+    int failed;
+} run;
+
+/// Append `s` to `command`, quoted for the shell.  Returns 0 if it does not
+/// fit.
+static int
+AppendQuoted(char *command, const char *s)
+{
+    size_t length = strlen(command);
+    if (length + 3 >= COMMAND_SIZE) {
+        return 0;
+    }
+    command[length++] = ' ';
+    command[length++] = '\'';
+    for (; *s != '\0'; s++) {
+        const char *piece = *s == '\'' ? "'\\''" : NULL;
+        size_t n = piece != NULL ? strlen(piece) : 1;
+        if (length + n + 2 >= COMMAND_SIZE) {
+            return 0;
+        }
+        if (piece != NULL) {
+            memcpy(command + length, piece, n);
+        } else {
+            command[length] = *s;
+        }
+        length += n;
+    }
+    command[length++] = '\'';
+    command[length] = '\0';
+    return 1;
+}
+
+/// Run Nachos with `pages` of memory and read its statistics into `r`.
+static int
+Run(run *r, unsigned pages, int argc, char *argv[])
+{
+    char command[COMMAND_SIZE];
+    char size[16];
+
+    command[0] = '\0';
+    snprintf(size, sizeof size, "%u", pages);
+    if (!AppendQuoted(command, argv[0]) || !AppendQuoted(command, "-m")
+          || !AppendQuoted(command, size)) {
+        return 0;
+    }
+    for (int i = 1; i < argc; i++) {
+        if (!AppendQuoted(command, argv[i])) {
+            return 0;
+        }
+    }
+
+    FILE *p = popen(command, "r");
+    if (p == NULL) {
+        perror("popen");
+        return 0;
+    }
+
+    memset(r, 0, sizeof *r);
+    r->pages = pages;
+    int found = 0;
+    char line[512];
+    while (fgets(line, sizeof line, p) != NULL) {
+        if (sscanf(line, "Ticks: total %llu", &r->ticks) == 1) {
+            found++;
+        } else if (sscanf(line, "Paging: faults %lu", &r->faults) == 1) {
+            found++;
+        } else {
+            const char *s = strstr(line, "page-ins ");
+            if (strncmp(line, "Replacement:", 12) == 0 && s != NULL) {
+                sscanf(s, "page-ins %lu, evictions %lu",
+                       &r->pageIns, &r->evictions);
+            }
+        }
+    }
+    int status = pclose(p);
+
+    r->complete = found == 2;
+    r->failed = status == -1 || !WIFEXITED(status)
+                || WEXITSTATUS(status) != 0;
+    return 1;
+}
+
+/// Plot `values`, one bar per run.
+static void
+Plot(const char *title, const run *runs, unsigned n,
+     const double *values)
+{
+    double max = 0;
+    for (unsigned i = 0; i < n; i++) {
+        if (values[i] > max) {
+            max = values[i];
+        }
+    }
+
+    printf("\n%s\n", title);
+    for (unsigned i = 0; i < n; i++) {
+        unsigned width = max > 0
+                           ? (unsigned) (values[i] * PLOT_WIDTH / max + 0.5)
+                           : 0;
+        printf("%6u |", runs[i].pages);
+        for (unsigned j = 0; j < width; j++) {
+            putchar('#');
+        }
+        printf(" %.0f\n", values[i]);
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (argc < 5) {
+        fprintf(stderr, "Usage: %s <min pages> <max pages> <step> "
+                        "<nachos> [<arguments>]\n", argv[0]);
+        return 1;
+    }
+
+    unsigned min = atoi(argv[1]);
+    unsigned max = atoi(argv[2]);
+    unsigned step = atoi(argv[3]);
+    if (min == 0 || max < min || step == 0) {
+        fprintf(stderr, "%s: expected 0 < min <= max and step > 0\n",
+                argv[0]);
+        return 1;
+    }
+
+    static run runs[MAX_RUNS];
+    unsigned n = 0;
+    for (unsigned pages = min; pages <= max && n < MAX_RUNS; pages += step) {
+        if (!Run(&runs[n], pages, argc - 4, argv + 4)) {
+            fprintf(stderr, "%s: could not run %s\n", argv[0], argv[4]);
+            return 1;
+        }
+        if (runs[n].failed) {
+            fprintf(stderr, "%s: Nachos failed with %u pages, skipped\n",
+                    argv[0], pages);
+            continue;
+        }
+        if (!runs[n].complete) {
+            fprintf(stderr, "%s: no statistics with %u pages\n",
+                    argv[0], pages);
+        }
+        n++;
+    }
+
+    printf("%6s %14s %10s %10s %10s\n",
+           "pages", "ticks", "faults", "page-ins", "evictions");
+    for (unsigned i = 0; i < n; i++) {
+        printf("%6u %14llu %10lu %10lu %10lu\n", runs[i].pages,
+               runs[i].ticks, runs[i].faults, runs[i].pageIns,
+               runs[i].evictions);
+    }
+
+    static double values[MAX_RUNS];
+    for (unsigned i = 0; i < n; i++) {
+        values[i] = runs[i].pageIns;
+    }
+    Plot("Page-ins per memory size:", runs, n, values);
+    for (unsigned i = 0; i < n; i++) {
+        values[i] = runs[i].ticks;
+    }
+    Plot("Ticks per memory size:", runs, n, values);
+
+    return 0;
+}
@@ -0,0 +1,47 @@
+/// Format of the page reference traces written by Nachos with `-tr`, and
+/// read by `pagesim`.
+///
+/// A trace is a header followed by records, every field being a 32-bit
+/// word stored least significant byte first.  Each record stands for a run
+/// of references of one kind to one virtual page of one process; the low
+/// two bits of its last word are the kind and the rest is the length of
+/// the run.  A record of kind `PAGE_TRACE_END` has no references: it tells
+/// that the process has ended, so its pages are freed and its identifier
+/// may be given to another process afterwards.
+///
+/// Copyright (c) 2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_BIN_PAGETRACE__H
+#define NACHOS_BIN_PAGETRACE__H
+
+
+#include <stdint.h>
+
+
+#define PAGE_TRACE_MAGIC    0x50475452  // Page trace file.
+#define PAGE_TRACE_VERSION  1
+
+#define PAGE_TRACE_FETCH  0  // Instruction fetches.
+#define PAGE_TRACE_READ   1  // Data loads.
+#define PAGE_TRACE_WRITE  2  // Data stores.
+#define PAGE_TRACE_END    3  // The process has ended.
+
+#define PAGE_TRACE_KIND_BITS  2
+#define PAGE_TRACE_MAX_COUNT  ((1U << (32 - PAGE_TRACE_KIND_BITS)) - 1)
+
+typedef struct pageTraceHeader {
+    uint32_t magic;     // Should be `PAGE_TRACE_MAGIC`.
+    uint32_t version;   // Should be `PAGE_TRACE_VERSION`.
+    uint32_t pageSize;  // Bytes per page of the traced machine.
+} pageTraceHeader;
+
+typedef struct pageTraceRecord {
+    uint32_t space;         // Identifier of the process.
+    uint32_t vpn;           // Virtual page referenced.
+    uint32_t countAndKind;  // Length of the run, then the kind.
+} pageTraceRecord;
+
+
+#endif
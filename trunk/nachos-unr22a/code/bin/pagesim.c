@@ -0,0 +1,562 @@
+/// Program that replays a page reference trace written by Nachos with
+/// `-tr`, and plots how many page faults several replacement policies
+/// would take with main memories of several sizes.
+///
+/// Usage:
+///
+///     pagesim <trace> <min frames> <max frames> [<step>]
+///
+/// Every size is simulated with these policies, all of them global, over
+/// the frames shared by every process:
+///
+/// * OPT replaces the page that will be referenced again the farthest in
+///   the future (Belady's optimal policy, a lower bound for the others).
+/// * LRU replaces the page referenced longest ago.
+/// * CLOCK replaces the next page, after the last victim, whose use bit is
+///   clear, clearing the bits it passes over.
+/// * FIFO replaces the page loaded longest ago.
+///
+/// Frames start empty, so the first reference to each page is a fault, and
+/// the pages of a process are freed when it ends.  The program prints a
+/// table with a row per size and a curve of faults per policy, and then,
+/// for windows of increasing length, the mean and peak size of the working
+/// set and its faults.  Windows are measured in references of every
+/// process, as the trace does not tell how time was shared among them.
+///
+/// Consecutive references to the same page only fault the first time, so
+/// they are replayed as one; they still count as that many references for
+/// the working set.
+///
+/// For example, from the `vmem` directory:
+///
+///     ./nachos -tr sort.trace -x ../userland/sort
+///     ../bin/pagesim sort.trace 4 32 4
+///
+/// Copyright (c) 2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "page_trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define MAX_RUNS    256
+#define PLOT_WIDTH  60
+#define NUM_POLICIES 4
+#define NEVER       (~0UL)
+
+static const char *const POLICY_NAMES[NUM_POLICIES] = {
+    "OPT", "LRU", "CLOCK", "FIFO"
+};
+
+/// A reference to a page, standing for `count` in a row, or the end of a
+/// process if `page` is `END_OF_SPACE`.
+typedef struct {
+    unsigned page;
+    unsigned count;
+    unsigned long time;     // Position of the first of the references.
+    unsigned long nextUse;  // Position of the next reference to the page.
+} reference;
+
+#define END_OF_SPACE (~0U)
+
+/// The trace, with pages numbered from 0 in order of appearance.
+typedef struct {
+    reference *refs;
+    unsigned long numRefs;
+    unsigned long capacity;
+    unsigned long numReferences;  // Including repeated ones.
+    unsigned long numKind[PAGE_TRACE_END + 1];
+    unsigned *pageSpace;          // Process of each page.
+    unsigned numPages;
+    unsigned numSpaces;
+    unsigned pageSize;
+} trace;
+
+/// Table from pages of processes to page numbers.
+typedef struct {
+    unsigned *space;
+    unsigned *vpn;
+    unsigned *page;
+    unsigned size;  // A power of two.
+    unsigned used;
+} pageMap;
+
+static unsigned
+Word(const unsigned char *p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (unsigned) p[3] << 24;
+}
+
+static void *
+Allocate(void *old, size_t size)
+{
+    void *p = realloc(old, size);
+    if (p == NULL) {
+        fprintf(stderr, "pagesim: out of memory\n");
+        exit(1);
+    }
+    return p;
+}
+
+static unsigned
+Slot(const pageMap *m, unsigned space, unsigned vpn)
+{
+    unsigned h = (space * 2654435761U ^ vpn * 40503U) & (m->size - 1);
+    while (m->page[h] != END_OF_SPACE
+             && (m->space[h] != space || m->vpn[h] != vpn)) {
+        h = (h + 1) & (m->size - 1);
+    }
+    return h;
+}
+
+static void
+Resize(pageMap *m, unsigned size)
+{
+    pageMap old = *m;
+    m->size = size;
+    m->space = Allocate(NULL, size * sizeof *m->space);
+    m->vpn = Allocate(NULL, size * sizeof *m->vpn);
+    m->page = Allocate(NULL, size * sizeof *m->page);
+    for (unsigned i = 0; i < size; i++) {
+        m->page[i] = END_OF_SPACE;
+    }
+    for (unsigned i = 0; i < old.size; i++) {
+        if (old.page[i] != END_OF_SPACE) {
+            unsigned h = Slot(m, old.space[i], old.vpn[i]);
+            m->space[h] = old.space[i];
+            m->vpn[h] = old.vpn[i];
+            m->page[h] = old.page[i];
+        }
+    }
+    free(old.space);
+    free(old.vpn);
+    free(old.page);
+}
+
+/// Forget the pages of `space`, so that a process given the same
+/// identifier later gets pages of its own.
+static void
+ForgetSpace(pageMap *m, unsigned space)
+{
+    pageMap old = *m;
+    m->space = m->vpn = m->page = NULL;
+    m->size = m->used = 0;
+    Resize(m, old.size);
+    for (unsigned i = 0; i < old.size; i++) {
+        if (old.page[i] != END_OF_SPACE && old.space[i] != space) {
+            unsigned h = Slot(m, old.space[i], old.vpn[i]);
+            m->space[h] = old.space[i];
+            m->vpn[h] = old.vpn[i];
+            m->page[h] = old.page[i];
+            m->used++;
+        }
+    }
+    free(old.space);
+    free(old.vpn);
+    free(old.page);
+}
+
+static void
+AddReference(trace *t, unsigned page, unsigned count)
+{
+    if (t->numRefs == t->capacity) {
+        t->capacity = t->capacity > 0 ? 2 * t->capacity : 4096;
+        t->refs = Allocate(t->refs, t->capacity * sizeof *t->refs);
+    }
+    reference *r = &t->refs[t->numRefs++];
+    r->page = page;
+    r->count = count;
+    r->time = t->numReferences;
+    t->numReferences += count;
+}
+
+/// Read the trace in `name` into `t`.  Returns 0 if it cannot be read.
+static int
+Load(trace *t, const char *name)
+{
+    FILE *f = fopen(name, "rb");
+    if (f == NULL) {
+        perror(name);
+        return 0;
+    }
+
+    unsigned char header[sizeof (pageTraceHeader)];
+    if (fread(header, sizeof header, 1, f) != 1
+          || Word(header) != PAGE_TRACE_MAGIC
+          || Word(header + 4) != PAGE_TRACE_VERSION) {
+        fprintf(stderr, "%s: not a page trace\n", name);
+        fclose(f);
+        return 0;
+    }
+
+    memset(t, 0, sizeof *t);
+    t->pageSize = Word(header + 8);
+    pageMap m = { NULL, NULL, NULL, 0, 0 };
+    Resize(&m, 1024);
+    unsigned pageCapacity = 0;
+
+    unsigned char record[sizeof (pageTraceRecord)];
+    while (fread(record, sizeof record, 1, f) == 1) {
+        unsigned space = Word(record);
+        unsigned vpn = Word(record + 4);
+        unsigned kind = Word(record + 8) & ((1 << PAGE_TRACE_KIND_BITS) - 1);
+        unsigned count = Word(record + 8) >> PAGE_TRACE_KIND_BITS;
+        t->numKind[kind] += kind == PAGE_TRACE_END ? 1 : count;
+
+        if (kind == PAGE_TRACE_END) {
+            ForgetSpace(&m, space);
+            AddReference(t, END_OF_SPACE, 0);
+            t->refs[t->numRefs - 1].nextUse = space;
+            continue;
+        }
+        if (count == 0) {
+            continue;
+        }
+
+        unsigned h = Slot(&m, space, vpn);
+        if (m.page[h] == END_OF_SPACE) {
+            if (t->numPages == pageCapacity) {
+                pageCapacity = pageCapacity > 0 ? 2 * pageCapacity : 1024;
+                t->pageSpace = Allocate(t->pageSpace,
+                                        pageCapacity * sizeof *t->pageSpace);
+            }
+            t->pageSpace[t->numPages] = space;
+            m.space[h] = space;
+            m.vpn[h] = vpn;
+            m.page[h] = t->numPages++;
+            if (++m.used > m.size / 2) {
+                Resize(&m, 2 * m.size);
+            }
+            h = Slot(&m, space, vpn);
+        }
+
+        unsigned page = m.page[h];
+        reference *last = t->numRefs > 0 ? &t->refs[t->numRefs - 1] : NULL;
+        if (last != NULL && last->page == page) {
+            last->count += count;
+            t->numReferences += count;
+        } else {
+            AddReference(t, page, count);
+        }
+    }
+    fclose(f);
+    free(m.space);
+    free(m.vpn);
+    free(m.page);
+
+    // For the end of a process, `nextUse` held its identifier until now.
+    unsigned long *next = Allocate(NULL, (t->numPages + 1) * sizeof *next);
+    for (unsigned p = 0; p < t->numPages; p++) {
+        next[p] = NEVER;
+    }
+    for (unsigned long i = t->numRefs; i-- > 0; ) {
+        reference *r = &t->refs[i];
+        if (r->page == END_OF_SPACE) {
+            t->numSpaces++;
+        } else {
+            r->nextUse = next[r->page];
+            next[r->page] = r->time;
+        }
+    }
+    free(next);
+    return 1;
+}
+
+/// State of a simulated memory.
+typedef struct {
+    unsigned numFrames;
+    unsigned *framePage;          // Page in each frame, or `END_OF_SPACE`.
+    unsigned long *frameStamp;    // Last use, or load, or next use.
+    char *frameUse;               // Use bits, for CLOCK.
+    unsigned hand;
+    unsigned *pageFrame;          // Frame of each page, or `END_OF_SPACE`.
+} memory;
+
+/// Pick the frame to replace under `policy`, every frame being in use.
+static unsigned
+Victim(memory *mem, int policy)
+{
+    unsigned victim = 0;
+    switch (policy) {
+        case 0:  // OPT: the farthest next use.
+            for (unsigned f = 1; f < mem->numFrames; f++) {
+                if (mem->frameStamp[f] > mem->frameStamp[victim]) {
+                    victim = f;
+                }
+            }
+            break;
+        case 1:  // LRU: the oldest use.
+        case 3:  // FIFO: the oldest load.
+            for (unsigned f = 1; f < mem->numFrames; f++) {
+                if (mem->frameStamp[f] < mem->frameStamp[victim]) {
+                    victim = f;
+                }
+            }
+            break;
+        case 2:  // CLOCK.
+            while (mem->frameUse[mem->hand]) {
+                mem->frameUse[mem->hand] = 0;
+                mem->hand = (mem->hand + 1) % mem->numFrames;
+            }
+            victim = mem->hand;
+            mem->hand = (mem->hand + 1) % mem->numFrames;
+            break;
+    }
+    return victim;
+}
+
+/// Replay `t` with `numFrames` frames under `policy`, and return the
+/// number of faults.
+static unsigned long
+Simulate(const trace *t, unsigned numFrames, int policy)
+{
+    memory mem;
+    mem.numFrames = numFrames;
+    mem.framePage = Allocate(NULL, numFrames * sizeof *mem.framePage);
+    mem.frameStamp = Allocate(NULL, numFrames * sizeof *mem.frameStamp);
+    mem.frameUse = Allocate(NULL, numFrames);
+    mem.pageFrame = Allocate(NULL, (t->numPages + 1) * sizeof *mem.pageFrame);
+    mem.hand = 0;
+    for (unsigned f = 0; f < numFrames; f++) {
+        mem.framePage[f] = END_OF_SPACE;
+    }
+    for (unsigned p = 0; p < t->numPages; p++) {
+        mem.pageFrame[p] = END_OF_SPACE;
+    }
+
+    unsigned long faults = 0;
+    unsigned numUsed = 0;
+    for (unsigned long i = 0; i < t->numRefs; i++) {
+        const reference *r = &t->refs[i];
+        if (r->page == END_OF_SPACE) {
+            // Free the frames of the process, and close the gaps so that
+            // frames in use come first.
+            unsigned space = r->nextUse;
+            unsigned kept = 0;
+            for (unsigned f = 0; f < numUsed; f++) {
+                unsigned page = mem.framePage[f];
+                if (t->pageSpace[page] == space) {
+                    mem.pageFrame[page] = END_OF_SPACE;
+                    continue;
+                }
+                mem.framePage[kept] = page;
+                mem.frameStamp[kept] = mem.frameStamp[f];
+                mem.frameUse[kept] = mem.frameUse[f];
+                mem.pageFrame[page] = kept++;
+            }
+            numUsed = kept;
+            continue;
+        }
+
+        unsigned f = mem.pageFrame[r->page];
+        if (f == END_OF_SPACE) {
+            faults++;
+            if (numUsed < numFrames) {
+                f = numUsed++;
+            } else {
+                f = Victim(&mem, policy);
+                mem.pageFrame[mem.framePage[f]] = END_OF_SPACE;
+            }
+            mem.framePage[f] = r->page;
+            mem.pageFrame[r->page] = f;
+            mem.frameStamp[f] = r->time;
+        }
+        mem.frameUse[f] = 1;
+        if (policy == 0) {
+            mem.frameStamp[f] = r->nextUse;
+        } else if (policy == 1) {
+            mem.frameStamp[f] = r->time + r->count - 1;
+        }
+    }
+
+    free(mem.framePage);
+    free(mem.frameStamp);
+    free(mem.frameUse);
+    free(mem.pageFrame);
+    return faults;
+}
+
+/// Working set over windows of `window` references: its mean and peak
+/// size and the references that find their page out of it.
+static void
+WorkingSet(const trace *t, unsigned long window, double *mean,
+           unsigned *peak, unsigned long *faults)
+{
+    char *in = Allocate(NULL, t->numPages + 1);
+    unsigned long *lastRef = Allocate(NULL,
+                                      (t->numPages + 1) * sizeof *lastRef);
+    memset(in, 0, t->numPages + 1);
+
+    // Each reference keeps its page in the set for `window` references, or
+    // until the next one to the page or the end of its process.
+    double total = 0;
+    unsigned size = 0;
+    *peak = 0;
+    *faults = 0;
+    unsigned long expiring = 0;  // First reference that may still expire.
+    for (unsigned long i = 0; i < t->numRefs; i++) {
+        const reference *r = &t->refs[i];
+        if (r->page == END_OF_SPACE) {
+            unsigned space = r->nextUse;
+            for (unsigned p = 0; p < t->numPages; p++) {
+                if (in[p] && t->pageSpace[p] == space) {
+                    in[p] = 0;
+                    size--;
+                    unsigned long span = r->time - lastRef[p];
+                    total += span < window ? span : window;
+                }
+            }
+            continue;
+        }
+
+        for (; expiring < i; expiring++) {
+            const reference *e = &t->refs[expiring];
+            unsigned long end = e->time + e->count - 1;
+            if (e->page != END_OF_SPACE && end + window > r->time) {
+                break;
+            }
+            if (e->page != END_OF_SPACE && in[e->page]
+                  && lastRef[e->page] == end) {
+                in[e->page] = 0;
+                size--;
+                total += window;
+            }
+        }
+
+        if (in[r->page]) {
+            unsigned long span = r->time - lastRef[r->page];
+            total += span;
+        } else {
+            in[r->page] = 1;
+            size++;
+            (*faults)++;
+        }
+        total += r->count - 1;
+        lastRef[r->page] = r->time + r->count - 1;
+        if (size > *peak) {
+            *peak = size;
+        }
+    }
+
+    // Pages still in the set at the end of the trace.
+    for (unsigned p = 0; p < t->numPages; p++) {
+        if (in[p]) {
+            unsigned long span = t->numReferences - lastRef[p];
+            total += span < window ? span : window;
+        }
+    }
+    *mean = t->numReferences > 0 ? total / t->numReferences : 0;
+
+    free(in);
+    free(lastRef);
+}
+
+/// Plot `values`, one bar per size.
+static void
+Plot(const char *title, const unsigned *frames, unsigned n,
+     const unsigned long *values)
+{
+    unsigned long max = 0;
+    for (unsigned i = 0; i < n; i++) {
+        if (values[i] > max) {
+            max = values[i];
+        }
+    }
+
+    printf("\n%s\n", title);
+    for (unsigned i = 0; i < n; i++) {
+        unsigned width = max > 0
+                           ? (unsigned) ((double) values[i] * PLOT_WIDTH
+                                           / max + 0.5)
+                           : 0;
+        printf("%6u |", frames[i]);
+        for (unsigned j = 0; j < width; j++) {
+            putchar('#');
+        }
+        printf(" %lu\n", values[i]);
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (argc < 4 || argc > 5) {
+        fprintf(stderr, "Usage: %s <trace> <min frames> <max frames> "
+                        "[<step>]\n", argv[0]);
+        return 1;
+    }
+
+    unsigned min = atoi(argv[2]);
+    unsigned max = atoi(argv[3]);
+    unsigned step = argc == 5 ? atoi(argv[4]) : 1;
+    if (min == 0 || max < min || step == 0) {
+        fprintf(stderr, "%s: expected 0 < min <= max and step > 0\n",
+                argv[0]);
+        return 1;
+    }
+
+    trace t;
+    if (!Load(&t, argv[1])) {
+        return 1;
+    }
+    printf("Trace: %lu references (%lu fetches, %lu loads, %lu stores) "
+           "to %u pages of %u bytes, %u processes ended\n",
+           t.numReferences, t.numKind[PAGE_TRACE_FETCH],
+           t.numKind[PAGE_TRACE_READ], t.numKind[PAGE_TRACE_WRITE],
+           t.numPages, t.pageSize, t.numSpaces);
+
+    static unsigned frames[MAX_RUNS];
+    static unsigned long faults[NUM_POLICIES][MAX_RUNS];
+    unsigned n = 0;
+    for (unsigned f = min; f <= max && n < MAX_RUNS; f += step) {
+        frames[n] = f;
+        for (int p = 0; p < NUM_POLICIES; p++) {
+            faults[p][n] = Simulate(&t, f, p);
+        }
+        n++;
+    }
+
+    printf("\n%6s", "frames");
+    for (int p = 0; p < NUM_POLICIES; p++) {
+        printf(" %10s", POLICY_NAMES[p]);
+    }
+    printf("\n");
+    for (unsigned i = 0; i < n; i++) {
+        printf("%6u", frames[i]);
+        for (int p = 0; p < NUM_POLICIES; p++) {
+            printf(" %10lu", faults[p][i]);
+        }
+        printf("\n");
+    }
+
+    for (int p = 0; p < NUM_POLICIES; p++) {
+        char title[64];
+        snprintf(title, sizeof title, "%s faults per memory size:",
+                 POLICY_NAMES[p]);
+        Plot(title, frames, n, faults[p]);
+    }
+
+    printf("\nWorking set:\n%10s %10s %6s %10s\n",
+           "window", "mean", "peak", "faults");
+    for (unsigned long w = 1; ; w *= 4) {
+        double mean;
+        unsigned peak;
+        unsigned long wsFaults;
+        WorkingSet(&t, w, &mean, &peak, &wsFaults);
+        printf("%10lu %10.2f %6u %10lu\n", w, mean, peak, wsFaults);
+        if (w >= t.numReferences) {
+            break;
+        }
+    }
+
+    free(t.refs);
+    free(t.pageSpace);
+    return 0;
+}
@@ -384,6 +384,12 @@ FileSystem::Remove(const char *name)
             DiskDelete(path);
         dirTable->LockRelease();
     } else {
+#ifdef USER_PROGRAM
+        executableCache->Invalidate(dirEntry.sector);
+#endif
+#ifdef SWAP
+        coreMap->ForgetText(dirEntry.sector);
+#endif
         fileTable->LockAcquire();
         if (fileTable->SetRemove(dirEntry.sector))
             DiskDelete(path);
@@ -163,6 +163,12 @@ OpenFile::WriteAt(const char *from, unsigned numBytes, unsigned position)
     ASSERT(from != nullptr);
     ASSERT(numBytes > 0);
 
+#ifdef USER_PROGRAM
+    executableCache->Invalidate(sector);
+#endif
+#ifdef SWAP
+    coreMap->ForgetText(sector);
+#endif
     if (RWLock != nullptr)
         RWLock->WriteAcquire();
 
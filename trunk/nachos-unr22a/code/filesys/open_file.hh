@@ -79,6 +79,12 @@ public:
         return SystemDep::Tell(file);
     }
 
+    /// Identify the UNIX file, the same for every open of it.
+    unsigned long GetFileId() const
+    {
+        return SystemDep::FileId(file);
+    }
+
 private:
     int file;
     unsigned currentOffset;
@@ -1,80 +1,985 @@
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
 #include "coremap.hh"
+#include "threads/system.hh"
 
 #include <stdio.h>
+#include <string.h>
+
+
+const char *
+ReplacementPolicyName(ReplacementPolicy policy)
+{
+    switch (policy) {
+        case FIFO_REPLACEMENT:  return "fifo";
+        case LRU_REPLACEMENT:   return "lru";
+        case CLOCK_REPLACEMENT: return "clock";
+    }
+    return "unknown";
+}
 
-Coremap::Coremap(unsigned physPages)
+Coremap::Coremap(unsigned physPages, ReplacementPolicy replacement)
 {
     ASSERT(physPages > 0);
     numPhysPages = physPages;
-    CoreMap = new AddressSpace*[numPhysPages];
-    timers = new unsigned[numPhysPages];
+    policy = replacement;
+    frames = new FrameInfo[numPhysPages];
+    for (unsigned i = 0; i < numPhysPages; i++) {
+        frames[i].space = nullptr;
+        frames[i].text = nullptr;
+        frames[i].family = nullptr;
+        frames[i].vpn = 0;
+        frames[i].refCount = 0;
+        frames[i].loading = false;
+        frames[i].pinCount = 0;
+        frames[i].dirty = false;
+        frames[i].cleaned = false;
+        frames[i].prevInSpace = frames[i].nextInSpace = NO_FRAME;
+        frames[i].lruPrev = frames[i].lruNext = NO_FRAME;
+    }
+    lruHead = lruTail = NO_FRAME;
+    victimIndex = 0;
     pages = new Bitmap(numPhysPages);
+
+    // The zero frame stays in the LRU list like every allocated frame,
+    // but it is never evicted.
+    zeroFrame = pages->Find();
+    memset(&machine->GetMMU()->mainMemory[zeroFrame * PAGE_SIZE], 0,
+           PAGE_SIZE);
+    LruPushBack(zeroFrame);
+
+    frameLock = new Lock("frame lock");
+    frameReleased = new Condition("frame released", frameLock);
+    numFrameWaiters = 0;
+    numFrameReleases = 0;
+    cleaner = nullptr;
+    cleanerAwake = false;
+    lowWater = highWater = 0;
+    texts = nullptr;
+    minQuota = maxQuota = pffInterval = 0;
+    loadGap = loadPause = 0;
+    windowStart = 0;
+    windowPageIns = 0;
+    numSpaces = numSuspended = 0;
+    resumed = nullptr;
+    numStaleAlarms = 0;
 }
 
 /// De-allocate a bitmap.
 Coremap::~Coremap()
 {
-    delete[] CoreMap;
-    delete[] timers;
+    delete [] frames;
     delete pages;
+    delete frameReleased;
+    delete frameLock;
+    delete cleaner;
+    delete resumed;
 }
+
 #ifdef SWAP
 unsigned
-Coremap::ReplacePage(AddressSpace* newSpace)
+Coremap::TakeFrame(AddressSpace *space)
 {
-    int physIndex = pages->Find();
+    if (space != nullptr && maxQuota > 0
+          && space->residentFrames >= space->frameQuota) {
+        unsigned victim = GetVictim(space);
+        if (victim != NO_FRAME) {
+            Evict(victim);
+            stats->numLocalReplacements++;
+            return victim;
+        }
+        // Every frame of its own is pinned: take one like anybody else.
+    }
+
+    for (;;) {
+        unsigned long seen = numFrameReleases;
+        int physIndex = pages->Find();
+        if (physIndex != -1) {
+            if (frames[physIndex].cleaned) {
+                stats->numPrecleanedFaults++;
+            }
+            return physIndex;
+        }
 
-    if (physIndex == -1) {
         unsigned victim = GetVictim();
-        AddressSpace* space = CoreMap[victim];
-        space->SwapPage(space->GetPhysicalPageIndex(victim));
-        physIndex = pages->Find();
-        DEBUG('v', "Succesfully swapped, newP: %d\n", physIndex);
+        if (victim != NO_FRAME) {
+            Evict(victim);
+            DEBUG('v', "Succesfully swapped, newP: %u\n", victim);
+            return victim;
+        }
+
+        // Every frame is being loaded or saved by some other thread.
+        WaitForFrames(seen);
     }
-    
-    CoreMap[physIndex] = newSpace;
-    return (unsigned) physIndex;
 }
-#endif
+
+void
+Coremap::CheckWatermark()
+{
+    if (cleaner != nullptr && !cleanerAwake
+          && pages->CountClear() < lowWater) {
+        cleanerAwake = true;
+        cleaner->V();
+    }
+}
+
+unsigned
+Coremap::ReplacePage(AddressSpace *newSpace, unsigned vpn)
+{
+    if (loadGap > 0) {
+        ControlLoad(newSpace);
+    }
+    if (pffInterval > 0) {
+        AdjustQuota(newSpace);
+    }
+    unsigned physIndex = TakeFrame(newSpace);
+    Assign(physIndex, newSpace, vpn);
+
+    // Pin it before waking the page cleaner up, which may switch threads.
+    frames[physIndex].pinCount++;
+    CheckWatermark();
+
+    // Whatever was decoded from the previous contents is stale now.
+    machine->GetMMU()->InvalidateDecoded(physIndex);
+    return physIndex;
+}
+
+unsigned
+Coremap::TakeSpareFrame(AddressSpace *space, unsigned vpn)
+{
+    if (pages->CountClear() <= lowWater) {
+        return NO_FRAME;
+    }
+    int frame = pages->Find();
+    ASSERT(frame != -1);
+    Assign(frame, space, vpn);
+    LruUnlink(frame);
+    LruPushBack(frame);
+    machine->GetMMU()->InvalidateDecoded(frame);
+    frames[frame].pinCount++;
+    return frame;
+}
+
+void
+Coremap::Evict(unsigned victim)
+{
+    // The victim stays allocated and pinned while it is written out, which
+    // may block, so that nobody else takes it meanwhile.
+    FrameInfo *frame = &frames[victim];
+    if (frame->text != nullptr) {
+        // Code is never written, and the executable still has it.
+        DropText(victim);
+        stats->numEvictions++;
+        stats->numTextDrops++;
+        return;
+    }
+    if (frame->family != nullptr) {
+        EvictShared(victim);
+        stats->numEvictions++;
+        return;
+    }
+    AddressSpace *space = frame->space;
+    unsigned vpn = frame->vpn;
+    bool dirty = frame->dirty;
+    Unlink(victim);
+    frame->pinCount++;
+    space->SwapPage(vpn, victim, dirty);
+    frame->pinCount--;
+    stats->numEvictions++;
+}
+
+static void
+PageCleaner(void *arg)
+{
+    ((Coremap *) arg)->RunCleaner();
+}
+
+void
+Coremap::StartCleaner(unsigned low, unsigned high)
+{
+    // One frame holds the zero page, and a fault may need two more.
+    ASSERT(low <= high && (high == 0 || high + 3 <= numPhysPages));
+    lowWater = low;
+    highWater = high;
+    if (highWater == 0) {
+        return;
+    }
+    cleaner = new Semaphore("page cleaner", 0);
+    Thread *t = new Thread("page cleaner");
+    t->Fork(PageCleaner, this);
+}
+
+void
+Coremap::RunCleaner()
+{
+    for (;;) {
+        cleaner->P();
+        while (pages->CountClear() < highWater) {
+            unsigned victim = GetVictim();
+            if (victim == NO_FRAME) {
+                break;
+            }
+            DEBUG('v', "Page cleaner evicting frame %u\n", victim);
+            Evict(victim);
+            pages->Clear(victim);
+            frames[victim].cleaned = true;
+        }
+        cleanerAwake = false;
+    }
+}
+
+void
+Coremap::SetQuotas(unsigned min, unsigned max, unsigned interval)
+{
+    ASSERT(min > 0 && min <= max);
+    minQuota = min;
+    maxQuota = max;
+    pffInterval = interval;
+}
+
+void
+Coremap::SetLoadControl(unsigned gap, unsigned pause)
+{
+    ASSERT(gap > 0);
+    loadGap = gap;
+    loadPause = pause;
+    resumed = new Semaphore("suspended processes", 0);
+}
+
+static void
+AlarmHandler(void *arg)
+{
+    ((Coremap *) arg)->EndSuspension();
+}
+
+void
+Coremap::EndSuspension()
+{
+    if (numStaleAlarms > 0) {
+        numStaleAlarms--;
+        return;
+    }
+    numSuspended--;
+    resumed->V();
+}
+
 void
-Coremap::Clear(AddressSpace* space)
+Coremap::ResumeSuspended()
 {
-    for (unsigned i=0;i<numPhysPages;++i) {
-        if (CoreMap[i] == space)
-            pages->Clear(i);
+    DEBUG('v', "No other process left to run: resuming %u suspended\n",
+          numSuspended);
+    numStaleAlarms += numSuspended;
+    for (; numSuspended > 0; numSuspended--) {
+        resumed->V();
     }
 }
 
 unsigned
-Coremap::GetVictim()
+Coremap::CountRunnable() const
+{
+    unsigned count = 0;
+    for (unsigned i = 0; i < Table<Thread *>::SIZE; i++) {
+        if (!activeThreads->HasKey(i)) {
+            continue;
+        }
+        Thread *t = activeThreads->Get(i);
+        if (t->space != nullptr
+              && (t->GetStatus() == RUNNING || t->GetStatus() == READY)) {
+            count++;
+        }
+    }
+    return count;
+}
+
+void
+Coremap::AddSpace(AddressSpace *space)
+{
+    space->frameQuota = pffInterval > 0 ? minQuota : maxQuota;
+    space->lastFaultTime = 0;
+    numSpaces++;
+}
+
+void
+Coremap::AdjustQuota(AddressSpace *space)
+{
+    unsigned long long now = space->GetUserTicks();
+    bool frequent = now - space->lastFaultTime < pffInterval;
+    space->lastFaultTime = now;
+
+    if (frequent && space->frameQuota < maxQuota) {
+        space->frameQuota++;
+        stats->numQuotaGrowths++;
+    } else if (!frequent && space->frameQuota > minQuota) {
+        space->frameQuota--;
+        stats->numQuotaShrinks++;
+        Trim(space, space->frameQuota);
+    }
+}
+
+void
+Coremap::Trim(AddressSpace *space, unsigned target)
+{
+    while (space->residentFrames > target) {
+        unsigned victim = GetVictim(space);
+        if (victim == NO_FRAME) {
+            return;
+        }
+        DEBUG('v', "Trimming frame %u\n", victim);
+        Evict(victim);
+        pages->Clear(victim);
+        stats->numTrimmedFrames++;
+    }
+}
+
+void
+Coremap::ControlLoad(AddressSpace *space)
+{
+    if (++windowPageIns < numPhysPages) {
+        return;
+    }
+    unsigned long long gap = (stats->userTicks - windowStart) / windowPageIns;
+    windowStart = stats->userTicks;
+    windowPageIns = 0;
+    // Processes blocked on something else would leave the memory idle.
+    if (gap >= loadGap || loadPause == 0 || CountRunnable() <= 1) {
+        return;
+    }
+
+    // The page being faulted in is only loaded once the process resumes;
+    // meanwhile, the others have its frames.  The alarm is set first, so
+    // that alarms keep the order of suspensions even if trimming blocks.
+    DEBUG('v', "Thrashing, page-ins %llu user ticks apart: suspending a "
+          "process\n", gap);
+    numSuspended++;
+    stats->numSuspensions++;
+    unsigned long long start = stats->totalTicks;
+    interrupt->Schedule(AlarmHandler, this, loadPause, ALARM_INT);
+    Trim(space, 0);
+    resumed->P();
+    stats->suspendedTicks += stats->totalTicks - start;
+
+    // Judge the load afresh, now that the process is back.
+    windowStart = stats->userTicks;
+    windowPageIns = 0;
+}
+
+unsigned
+Coremap::GetVictim(AddressSpace *owner)
+{
+    // Spaces down to their minimum quota keep their frames, unless nothing
+    // else can be evicted.
+    if (owner == nullptr && minQuota > 0) {
+        unsigned victim = FindVictim(nullptr, true);
+        if (victim != NO_FRAME) {
+            return victim;
+        }
+    }
+    return FindVictim(owner, false);
+}
+
+unsigned
+Coremap::FindVictim(AddressSpace *owner, bool spareSmall)
 {
     DEBUG('v', "Getting Victims\n");
-#ifdef USE_LRU
-    unsigned victim, m = 0;
-    for (unsigned i=0;i<numPhysPages;++i)
-        if(timers[i] > m){
-            victim = i;
-            m = timers[i];
+    switch (policy) {
+        case LRU_REPLACEMENT:
+            for (unsigned f = lruTail; f != NO_FRAME; f = frames[f].lruPrev) {
+                if (IsCandidate(f, owner, spareSmall)) {
+                    return f;
+                }
+            }
+            return NO_FRAME;
+
+        case CLOCK_REPLACEMENT:
+            // At most one full turn clears all the `use` bits, and the hand
+            // stops at the next frame that is not pinned.
+            for (unsigned i = 0; i <= 2 * numPhysPages; i++) {
+                unsigned f = victimIndex;
+                victimIndex = (victimIndex + 1) % numPhysPages;
+                if (IsCandidate(f, owner, spareSmall)
+                      && !TestAndClearUse(f)) {
+                    return f;
+                }
+            }
+            return NO_FRAME;
+
+        default:
+            for (unsigned i = 0; i < numPhysPages; i++) {
+                unsigned f = victimIndex++ % numPhysPages;
+                if (IsCandidate(f, owner, spareSmall)) {
+                    return f;
+                }
+            }
+            return NO_FRAME;
+    }
+}
+
+bool
+Coremap::TestAndClearUse(unsigned frame)
+{
+    FrameInfo *info = &frames[frame];
+    if (info->space != nullptr) {
+        return info->space->TestAndClearUse(info->vpn);
+    }
+    bool used = false;
+    if (info->text != nullptr) {
+        for (AddressSpace *s = info->text->firstUser; s != nullptr;
+               s = s->nextTextUser) {
+            if (s->MapsPage(info->vpn, frame)) {
+                used = s->TestAndClearUse(info->vpn) || used;
+            }
+        }
+    } else {
+        for (AddressSpace *s = info->family->firstMember; s != nullptr;
+               s = s->nextInFamily) {
+            if (s->MapsPage(info->vpn, frame)) {
+                used = s->TestAndClearUse(info->vpn) || used;
+            }
+        }
+    }
+    return used;
+}
+
+SharedText *
+Coremap::AttachText(AddressSpace *space, unsigned long fileId,
+                    unsigned numPages)
+{
+    SharedText *text = texts;
+    while (text != nullptr && (text->stale || text->fileId != fileId
+                                 || text->numPages != numPages)) {
+        text = text->next;
+    }
+    if (text == nullptr) {
+        text = new SharedText;
+        text->fileId = fileId;
+        text->numPages = numPages;
+        text->frames = new unsigned [numPages];
+        for (unsigned i = 0; i < numPages; i++) {
+            text->frames[i] = NO_FRAME;
         }
+        text->firstUser = nullptr;
+        text->stale = false;
+        text->next = texts;
+        texts = text;
+    }
+    space->nextTextUser = text->firstUser;
+    text->firstUser = space;
+    return text;
+}
 
-    return victim;
-#else
-    return victimIndex++ % numPhysPages;
-#endif
+unsigned
+Coremap::GetTextFrame(SharedText *text, unsigned vpn, bool *load)
+{
+    ASSERT(vpn < text->numPages);
+    ASSERT(load != nullptr);
+
+    for (;;) {
+        unsigned long seen = numFrameReleases;
+        unsigned f = text->frames[vpn];
+        if (f != NO_FRAME) {
+            if (frames[f].loading) {
+                // Some other space is reading the page in; wait for it.
+                WaitForFrames(seen);
+                continue;
+            }
+            frames[f].refCount++;
+            frames[f].pinCount++;
+            *load = false;
+            return f;
+        }
+
+        // Taking a frame may block, and another space may have loaded the
+        // page meanwhile.
+        f = TakeFrame();
+        if (text->frames[vpn] != NO_FRAME) {
+            pages->Clear(f);
+            continue;
+        }
+
+        FrameInfo *info = &frames[f];
+        pages->Mark(f);
+        info->text = text;
+        info->vpn = vpn;
+        info->refCount = 1;
+        info->loading = true;
+        info->dirty = false;
+        info->cleaned = false;
+        info->pinCount++;
+        text->frames[vpn] = f;
+        LruPushFront(f);
+        CheckWatermark();
+        *load = true;
+        return f;
+    }
+}
+
+void
+Coremap::TextLoaded(unsigned frame)
+{
+    ASSERT(frames[frame].loading);
+    frames[frame].loading = false;
+    WakeFrameWaiters();
 }
-#ifdef USE_LRU
+
 void
-Coremap::UpdateTimers(unsigned pageUsed)
+Coremap::ForgetText(unsigned long fileId)
 {
-    DEBUG('v', "Updating Timers\n");
-    for (unsigned i=0;i<numPhysPages;++i)
-        timers[i]++;
-    timers[pageUsed] = 0;
+    for (SharedText *text = texts; text != nullptr; text = text->next) {
+        if (text->fileId == fileId) {
+            text->stale = true;
+        }
+    }
 }
+
+void
+Coremap::DropText(unsigned frame)
+{
+    FrameInfo *info = &frames[frame];
+    SharedText *text = info->text;
+    ASSERT(text != nullptr && text->frames[info->vpn] == frame);
+
+    for (AddressSpace *s = text->firstUser; s != nullptr;
+           s = s->nextTextUser) {
+        if (s->MapsPage(info->vpn, frame)) {
+            s->DropPage(info->vpn, frame);
+        }
+    }
+    text->frames[info->vpn] = NO_FRAME;
+    info->text = nullptr;
+    info->refCount = 0;
+    LruUnlink(frame);
+}
+
+void
+Coremap::DetachText(AddressSpace *space)
+{
+    SharedText *text = space->text;
+
+    // Frames that no other space maps are of no use any more.
+    for (unsigned vpn = 0; vpn < text->numPages; vpn++) {
+        unsigned f = text->frames[vpn];
+        if (f != NO_FRAME && space->MapsPage(vpn, f)
+              && --frames[f].refCount == 0) {
+            ASSERT(frames[f].pinCount == 0);
+            DropText(f);
+            pages->Clear(f);
+        }
+    }
+
+    AddressSpace **link = &text->firstUser;
+    while (*link != space) {
+        link = &(*link)->nextTextUser;
+    }
+    *link = space->nextTextUser;
+    space->text = nullptr;
+
+    if (text->firstUser != nullptr) {
+        return;
+    }
+    SharedText **t = &texts;
+    while (*t != text) {
+        t = &(*t)->next;
+    }
+    *t = text->next;
+    delete [] text->frames;
+    delete text;
+}
+
+void
+Coremap::ShareSpace(AddressSpace *parent, AddressSpace *child)
+{
+    if (parent->text != nullptr) {
+        child->nextTextUser = parent->text->firstUser;
+        parent->text->firstUser = child;
+    }
+    child->text = parent->text;
+
+    if (parent->family == nullptr) {
+        parent->family = new ForkFamily;
+        parent->family->firstMember = parent;
+        parent->nextInFamily = nullptr;
+    }
+    child->family = parent->family;
+    child->nextInFamily = parent->family->firstMember;
+    parent->family->firstMember = child;
+
+    PageTable *table = parent->pageTable;
+    for (unsigned vpn = table->Next(0); vpn < parent->numPages;
+           vpn = table->Next(vpn + 1)) {
+        if (!table->At(vpn).valid) {
+            continue;
+        }
+        unsigned f = table->At(vpn).physicalPage;
+        if (f == zeroFrame) {
+            // Already read-only in both.
+            continue;
+        }
+        FrameInfo *info = &frames[f];
+        if (info->space != nullptr) {
+            // The frame stays where it is in the LRU list.
+            ASSERT(info->space == parent);
+            UnlinkFromSpace(f);
+            info->family = parent->family;
+            info->refCount = 1;
+        }
+        info->refCount++;
+        if (!parent->IsSharedText(vpn)) {
+            parent->pageTable->At(vpn).readOnly = true;
+            child->pageTable->At(vpn).readOnly = true;
+            stats->numCowShares++;
+        }
+    }
+    stats->numForks++;
+}
+
+unsigned
+Coremap::CopyOnWrite(AddressSpace *space, unsigned vpn)
+{
+    unsigned frame = space->pageTable->At(vpn).physicalPage;
+    FrameInfo *info = &frames[frame];
+    ASSERT(info->family == space->family && info->vpn == vpn);
+
+    if (info->refCount == 1) {
+        // Every other sharer wrote its own copy or is gone.
+        info->family = nullptr;
+        info->refCount = 0;
+        LinkToSpace(frame, space);
+        info->pinCount++;
+        return frame;
+    }
+
+    // Taking a frame may block; keep the original from being evicted
+    // meanwhile.
+    info->pinCount++;
+    unsigned copy = ReplacePage(space, vpn);
+    char *mainMemory = machine->GetMMU()->mainMemory;
+    memcpy(&mainMemory[copy * PAGE_SIZE], &mainMemory[frame * PAGE_SIZE],
+           PAGE_SIZE);
+    frames[copy].dirty = true;
+    info->pinCount--;
+
+    if (--info->refCount == 0) {
+        info->family = nullptr;
+        LruUnlink(frame);
+        pages->Clear(frame);
+    }
+    stats->numCowCopies++;
+    return copy;
+}
+
+void
+Coremap::EvictShared(unsigned frame)
+{
+    FrameInfo *info = &frames[frame];
+    ForkFamily *family = info->family;
+    unsigned vpn = info->vpn;
+
+    // A clean page need not be written if every sharer gets it back from
+    // the same place: the same slot, or the executable.
+    bool write = info->dirty;
+    unsigned slot = SwapArea::NO_SLOT;
+    bool first = true;
+    for (AddressSpace *s = family->firstMember; s != nullptr;
+           s = s->nextInFamily) {
+        if (!s->MapsPage(vpn, frame)) {
+            continue;
+        }
+        if (first) {
+            slot = s->swapSlots->At(vpn);
+            first = false;
+        } else if (s->swapSlots->At(vpn) != slot) {
+            write = true;
+        }
+    }
+
+    // Overwrite a slot that no one but a sharer uses, if there is one.
+    // Otherwise some sharer holds room in swap without a slot, so a free
+    // one is left.
+    bool taken = false;
+    if (write) {
+        slot = SwapArea::NO_SLOT;
+        for (AddressSpace *s = family->firstMember; s != nullptr;
+               s = s->nextInFamily) {
+            unsigned own = s->MapsPage(vpn, frame) ? s->swapSlots->At(vpn)
+                                                   : SwapArea::NO_SLOT;
+            if (own != SwapArea::NO_SLOT && !swapArea->IsShared(own)) {
+                slot = own;
+                taken = true;
+            }
+        }
+        if (slot == SwapArea::NO_SLOT) {
+            slot = swapArea->AllocateSlot();
+            ASSERT(slot != SwapArea::NO_SLOT);
+        }
+    }
+    for (AddressSpace *s = family->firstMember; s != nullptr;
+           s = s->nextInFamily) {
+        if (!s->MapsPage(vpn, frame)) {
+            continue;
+        }
+        // Whatever frame the page is loaded into next is its own.
+        s->DropPage(vpn, frame);
+        s->pageTable->At(vpn).readOnly = false;
+        unsigned &own = s->swapSlots->At(vpn);
+        if (write && own != slot) {
+            if (own != SwapArea::NO_SLOT) {
+                swapArea->FreeSlot(own);
+            }
+            if (taken) {
+                swapArea->ShareSlot(slot);
+            }
+            taken = true;
+            own = slot;
+        }
+        if (write) {
+            s->pageTable->At(vpn).isInSwap = true;
+        }
+    }
+    info->family = nullptr;
+    info->refCount = 0;
+    LruUnlink(frame);
+
+    // The sharers must not be touched after this, as writing may block.
+    if (write) {
+        char *mainMemory = machine->GetMMU()->mainMemory;
+        info->pinCount++;
+        swapArea->WriteSlot(slot, &mainMemory[frame * PAGE_SIZE]);
+        info->pinCount--;
+    }
+}
+
+void
+Coremap::LeaveFamily(AddressSpace *space)
+{
+    ForkFamily *family = space->family;
+
+    // Frames that no other member maps are of no use any more.
+    PageTable *table = space->pageTable;
+    for (unsigned vpn = table->Next(0); vpn < space->numPages;
+           vpn = table->Next(vpn + 1)) {
+        if (!table->At(vpn).valid) {
+            continue;
+        }
+        unsigned f = table->At(vpn).physicalPage;
+        if (frames[f].family == family && --frames[f].refCount == 0) {
+            ASSERT(frames[f].pinCount == 0);
+            frames[f].family = nullptr;
+            LruUnlink(f);
+            pages->Clear(f);
+        }
+    }
+
+    AddressSpace **link = &family->firstMember;
+    while (*link != space) {
+        link = &(*link)->nextInFamily;
+    }
+    *link = space->nextInFamily;
+    space->family = nullptr;
+
+    if (family->firstMember == nullptr) {
+        delete family;
+    }
+}
+
+void
+Coremap::Release(AddressSpace *space, unsigned frame)
+{
+    if (frame == zeroFrame) {
+        return;
+    }
+    FrameInfo *info = &frames[frame];
+    ASSERT(info->pinCount == 0 && info->text == nullptr);
+    if (info->family != nullptr) {
+        ASSERT(info->family == space->family);
+        if (--info->refCount > 0) {
+            return;
+        }
+        info->family = nullptr;
+        LruUnlink(frame);
+        pages->Clear(frame);
+    } else {
+        ASSERT(info->space == space);
+        Free(frame);
+    }
+    WakeFrameWaiters();
+}
+#endif
+
+void
+Coremap::Clear(AddressSpace *space)
+{
+    unsigned f = space->firstFrame;
+    while (f != NO_FRAME) {
+        unsigned next = frames[f].nextInSpace;
+        Free(f);
+        f = next;
+    }
+    ASSERT(space->firstFrame == NO_FRAME && space->residentFrames == 0);
+#ifdef SWAP
+    numSpaces--;
+    if (numSuspended > 0 && CountRunnable() == 0) {
+        ResumeSuspended();
+    }
+    if (space->text != nullptr) {
+        DetachText(space);
+    }
+    if (space->family != nullptr) {
+        LeaveFamily(space);
+    }
+    WakeFrameWaiters();
 #endif
+}
+
+void
+Coremap::Pin(unsigned frame)
+{
+    ASSERT(frame < numPhysPages && pages->Test(frame));
+    frames[frame].pinCount++;
+}
+
+void
+Coremap::Unpin(unsigned frame)
+{
+    ASSERT(frame < numPhysPages && frames[frame].pinCount > 0);
+    if (--frames[frame].pinCount == 0) {
+        WakeFrameWaiters();
+    }
+}
+
+void
+Coremap::Free(unsigned frame)
+{
+    Unlink(frame);
+    pages->Clear(frame);
+}
+
+void
+Coremap::WaitForFrames(unsigned long seen)
+{
+    frameLock->Acquire();
+    numFrameWaiters++;
+    while (numFrameReleases == seen) {
+        frameReleased->Wait();
+    }
+    numFrameWaiters--;
+    frameLock->Release();
+}
+
+void
+Coremap::WakeFrameWaiters()
+{
+    numFrameReleases++;
+    if (numFrameWaiters > 0) {
+        frameLock->Acquire();
+        frameReleased->Broadcast();
+        frameLock->Release();
+    }
+}
+
+void
+Coremap::Assign(unsigned frame, AddressSpace *space, unsigned vpn)
+{
+    FrameInfo *info = &frames[frame];
+    pages->Mark(frame);
+    info->vpn = vpn;
+    info->dirty = false;
+    info->cleaned = false;
+    LinkToSpace(frame, space);
+    LruPushFront(frame);
+}
+
+void
+Coremap::Unlink(unsigned frame)
+{
+    UnlinkFromSpace(frame);
+    LruUnlink(frame);
+}
+
+void
+Coremap::LinkToSpace(unsigned frame, AddressSpace *space)
+{
+    FrameInfo *info = &frames[frame];
+    info->space = space;
+    info->prevInSpace = NO_FRAME;
+    info->nextInSpace = space->firstFrame;
+    if (space->firstFrame != NO_FRAME) {
+        frames[space->firstFrame].prevInSpace = frame;
+    }
+    space->firstFrame = frame;
+    space->residentFrames++;
+}
+
+void
+Coremap::UnlinkFromSpace(unsigned frame)
+{
+    FrameInfo *info = &frames[frame];
+    ASSERT(info->space != nullptr);
+
+    if (info->prevInSpace != NO_FRAME) {
+        frames[info->prevInSpace].nextInSpace = info->nextInSpace;
+    } else {
+        info->space->firstFrame = info->nextInSpace;
+    }
+    if (info->nextInSpace != NO_FRAME) {
+        frames[info->nextInSpace].prevInSpace = info->prevInSpace;
+    }
+    info->prevInSpace = info->nextInSpace = NO_FRAME;
+    info->space->residentFrames--;
+    info->space = nullptr;
+}
 
 void
-Coremap::ClearPageIndex(unsigned page)
+Coremap::LruUnlink(unsigned frame)
 {
-    pages->Clear(page);
-}
\ No newline at end of file
+    unsigned prev = frames[frame].lruPrev, next = frames[frame].lruNext;
+    if (prev != NO_FRAME) {
+        frames[prev].lruNext = next;
+    } else {
+        lruHead = next;
+    }
+    if (next != NO_FRAME) {
+        frames[next].lruPrev = prev;
+    } else {
+        lruTail = prev;
+    }
+    frames[frame].lruPrev = frames[frame].lruNext = NO_FRAME;
+}
+
+void
+Coremap::LruPushFront(unsigned frame)
+{
+    frames[frame].lruPrev = NO_FRAME;
+    frames[frame].lruNext = lruHead;
+    if (lruHead != NO_FRAME) {
+        frames[lruHead].lruPrev = frame;
+    } else {
+        lruTail = frame;
+    }
+    lruHead = frame;
+}
+
+void
+Coremap::LruPushBack(unsigned frame)
+{
+    frames[frame].lruNext = NO_FRAME;
+    frames[frame].lruPrev = lruTail;
+    if (lruTail != NO_FRAME) {
+        frames[lruTail].lruNext = frame;
+    } else {
+        lruHead = frame;
+    }
+    lruTail = frame;
+}
+
+void
+Coremap::MoveToFront(unsigned frame)
+{
+    // A frame that is not allocated has nothing to reorder.
+    if (pages->Test(frame)) {
+        LruUnlink(frame);
+        LruPushFront(frame);
+    }
+}
@@ -1,32 +1,435 @@
+/// Frame table: what every physical frame holds, and the page replacement
+/// policies that pick a frame to evict when memory is full.
+///
+/// For each frame the coremap records the owning address space, the
+/// virtual page it holds, whether it was written since it was loaded and
+/// how many threads have it pinned.  The frames of each address space are
+/// also chained in a list, so evicting a page needs no search and tearing a
+/// space down only visits the frames it owns.
+///
+/// Pages that hold nothing but code are shared by every address space running
+/// the same executable.  Their frames belong to a `SharedText` rather than
+/// to a space, count how many spaces map them, and are dropped instead of
+/// swapped when evicted, as the executable still has them.
+///
+/// A forked address space starts out sharing every frame of its parent, both
+/// write protected.  Such frames belong to the `ForkFamily` of the spaces
+/// forked from one another and count how many of them map the frame; the
+/// first write to one gets the writer a copy.  Evicting a shared frame saves
+/// it to a single swap slot that all of its sharers then use.
+///
+/// One frame is kept filled with zeroes for good.  Pages that start out
+/// zeroed (the uninitialized data and the stack) are mapped to it read-only
+/// until they are first written, so pages that are only read never take a
+/// frame of their own.  It has no owner, so it is never evicted.
+///
+/// Replacement is global by default: the victim may belong to any space.
+/// With frame quotas, it is local once a space owns as many frames as its
+/// quota: its faults then replace its own pages, so that a process that
+/// needs much memory cannot take it all from the others.  Quotas range
+/// between a minimum and a maximum number of frames, and frames of spaces
+/// down to the minimum are only taken by global replacement if nothing
+/// else can be.  Quotas can follow the page-fault frequency (PFF) of each
+/// process: a page-in that comes soon after the previous one, in the
+/// virtual time of the process, raises its quota by one frame, and any
+/// other lowers it, releasing the frames over it.  Only the frames a space
+/// owns count: shared code and copy-on-write frames belong to no one.
+///
+/// Load control watches the page-ins of the whole system.  When they come
+/// too close together, in user ticks, the system is thrashing, and the
+/// process that faults is suspended for a while: its frames are released
+/// and it sleeps, letting the others run in the memory it leaves, until an
+/// alarm goes off or no other process is left to run.
+///
+/// Every policy does constant work per memory access:
+///
+/// * FIFO evicts frames in round robin order and ignores accesses.
+/// * LRU keeps the allocated frames in a doubly linked list, most recently
+///   used first; an access moves its frame to the front and the victim is
+///   the one at the back.
+/// * CLOCK (second chance) sweeps a hand over the frames, sparing those whose
+///   `use` bit is set and clearing the bit as it goes.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
 #ifndef NACHOS_LIB_COREMAP__HH
 #define NACHOS_LIB_COREMAP__HH
 
 #include "userprog/address_space.hh"
 #include "lib/bitmap.hh"
+#include "threads/condition.hh"
+
+
+enum ReplacementPolicy {
+    FIFO_REPLACEMENT,
+    LRU_REPLACEMENT,
+    CLOCK_REPLACEMENT
+};
+
+/// Name of `policy`, as given on the command line.
+const char *ReplacementPolicyName(ReplacementPolicy policy);
+
+/// Code pages of one executable, shared by the address spaces running it.
+struct SharedText {
+
+    /// Identifies the executable file, cf. `Executable::GetFileId`.
+    unsigned long fileId;
+
+    /// Number of pages, starting from page 0, that hold only code.
+    unsigned numPages;
+
+    /// Frame holding each page, or `Coremap::NO_FRAME`.
+    unsigned *frames;
+
+    /// Spaces running the executable, chained through `nextTextUser`.
+    AddressSpace *firstUser;
+
+    /// The file was changed since the pages were read, so new spaces must
+    /// not use them.
+    bool stale;
+
+    /// Next in the list of shared texts.
+    SharedText *next;
+};
+
+/// Address spaces forked from one another, which share frames until they
+/// write them.
+struct ForkFamily {
+
+    /// Members, chained through `nextInFamily`.
+    AddressSpace *firstMember;
+};
+
+/// What the coremap knows about one physical frame.
+struct FrameInfo {
+
+    /// Owner, or null if the frame is free or shared.
+    AddressSpace *space;
+
+    /// Shared code the frame belongs to, if any.
+    SharedText *text;
+
+    /// Family whose members share the frame copy-on-write, if any.
+    ForkFamily *family;
+
+    /// Virtual page held, in `space` or in every space sharing the frame.
+    unsigned vpn;
+
+    /// Number of spaces that map a frame of `text` or `family`.
+    unsigned refCount;
+
+    /// A frame of `text` is still being read in.
+    bool loading;
+
+    /// While positive, the frame cannot be evicted.
+    unsigned pinCount;
+
+    /// The page was written since it was loaded, so evicting it has to save
+    /// it to swap.
+    bool dirty;
+
+    /// The frame was freed by the page cleaner.
+    bool cleaned;
+
+    /// Neighbours in the list of frames of `space`.
+    unsigned prevInSpace;
+    unsigned nextInSpace;
+
+    /// Neighbours in the LRU list.
+    unsigned lruPrev;
+    unsigned lruNext;
+};
 
 class Coremap {
 public:
-    Coremap(unsigned numPhysPages);
+
+    /// Marks the end of a list of frames.
+    static const unsigned NO_FRAME = ~0U;
+
+    Coremap(unsigned numPhysPages, ReplacementPolicy policy);
 
     ~Coremap();
 
-    unsigned ReplacePage(AddressSpace* newSpace);
+    /// Find a frame for page `vpn` of `newSpace`, evicting some other page
+    /// if memory is full.
+    ///
+    /// The frame is returned pinned, so that it is not taken away while the
+    /// page is read in; the caller must `Unpin` it afterwards.
+    unsigned ReplacePage(AddressSpace *newSpace, unsigned vpn);
+
+    /// Like `ReplacePage`, but for a page that is only loaded in case it is
+    /// needed soon: a frame is only taken if it is free and the page cleaner
+    /// is left above its low watermark, and it goes to the end of the LRU
+    /// list.  Returns `NO_FRAME` if there is no such frame.
+    unsigned TakeSpareFrame(AddressSpace *space, unsigned vpn);
+
+    /// Release every frame owned by `space`, and stop sharing code with it.
+    void Clear(AddressSpace *space);
+
+    /// Share the first `numPages` pages of the executable identified by
+    /// `fileId` with every other space running it.
+    SharedText *AttachText(AddressSpace *space, unsigned long fileId,
+                           unsigned numPages);
+
+    /// Find the frame holding page `vpn` of `text`, for `space` to map it.
+    /// If no other space has it in memory, a frame is taken as with
+    /// `ReplacePage` and `*load` is set, and the caller must read the page
+    /// in and call `TextLoaded`.  Either way the frame is returned pinned
+    /// and counted as mapped by one more space.
+    unsigned GetTextFrame(SharedText *text, unsigned vpn, bool *load);
+
+    void TextLoaded(unsigned frame);
+
+    /// Make `child`, a copy of `parent`'s page table, share every frame
+    /// and the code of `parent`.  Frames that are not code are write
+    /// protected in both, until `CopyOnWrite`.
+    void ShareSpace(AddressSpace *parent, AddressSpace *child);
+
+    /// Page `vpn` of `space`, shared copy-on-write, is being written: return
+    /// the frame it should map from now on, a copy unless no other space
+    /// maps the page any more.  The frame is returned pinned; the caller
+    /// must `Unpin` it once it is mapped.
+    unsigned CopyOnWrite(AddressSpace *space, unsigned vpn);
+
+    /// `space` dropped its page held in `frame`, which it no longer needs:
+    /// free the frame, unless other spaces of its family still map it.  The
+    /// zero frame is left alone.
+    void Release(AddressSpace *space, unsigned frame);
+
+    /// The executable identified by `fileId` changed: spaces created from
+    /// now on will not share the code read so far.
+    void ForgetText(unsigned long fileId);
+
+    /// Pick a frame to evict among those holding a page and not pinned, or
+    /// return `NO_FRAME` if there is none.  If `owner` is not null, only
+    /// its own frames are considered.
+    unsigned GetVictim(AddressSpace *owner = nullptr);
+
+    /// Replace pages locally, with quotas of `min` to `max` frames per
+    /// space.  If `pffInterval` is zero, quotas stay at `max`; otherwise
+    /// they start at `min` and are adjusted at every page-in, up if the
+    /// process ran for less than `pffInterval` user ticks since its last
+    /// one and down if not.
+    void SetQuotas(unsigned min, unsigned max, unsigned pffInterval);
+
+    /// Suspend the faulting process for `pause` ticks whenever page-ins
+    /// come fewer than `gap` user ticks apart on average, over as many of
+    /// them as there are frames.  A process is only suspended while some
+    /// other one is ready to run.
+    void SetLoadControl(unsigned gap, unsigned pause);
 
-    void Clear(AddressSpace* space);
+    /// The pause of the process suspended longest ago is over.  Called by
+    /// the alarm set when it was suspended.
+    void EndSuspension();
 
-    unsigned GetVictim();
-    void UpdateTimers(unsigned pageUsed);
+    /// Start keeping track of `space`, which is new.
+    void AddSpace(AddressSpace *space);
 
-    void ClearPageIndex(unsigned pageUsed);
+    /// Record an access to `frame`.
+    void Touch(unsigned frame, bool writing = false)
+    {
+        if (writing) {
+            frames[frame].dirty = true;
+        }
+        if (policy == LRU_REPLACEMENT && frame != lruHead) {
+            MoveToFront(frame);
+        }
+    }
+
+    /// Start the page cleaner: a kernel thread that, once fewer than `low`
+    /// frames are free, evicts pages (writing the dirty ones to swap) until
+    /// `high` frames are free, so that faults find a clean frame and only
+    /// have to read.  No thread is started if `high` is zero.
+    void StartCleaner(unsigned low, unsigned high);
+
+    /// Body of the page cleaner thread.
+    void RunCleaner();
+
+    void Pin(unsigned frame);
+    void Unpin(unsigned frame);
+
+    const FrameInfo &GetFrame(unsigned frame) const
+    {
+        return frames[frame];
+    }
+
+    ReplacementPolicy GetPolicy() const
+    {
+        return policy;
+    }
+
+    /// Frame that always holds zeroes.
+    unsigned GetZeroFrame() const
+    {
+        return zeroFrame;
+    }
 
 private:
-    AddressSpace** CoreMap;
-    unsigned* timers;
+
+    /// Whether `frame` holds a page and is not pinned.
+    bool IsEvictable(unsigned frame) const
+    {
+        return (frames[frame].space != nullptr
+                  || frames[frame].text != nullptr
+                  || frames[frame].family != nullptr)
+               && frames[frame].pinCount == 0;
+    }
+
+    /// Whether `frame` may be evicted for `owner`, or for anyone if it is
+    /// null.  If `spareSmall`, frames of spaces down to their minimum quota
+    /// are not.
+    bool IsCandidate(unsigned frame, AddressSpace *owner,
+                     bool spareSmall) const
+    {
+        const FrameInfo &info = frames[frame];
+        return IsEvictable(frame)
+               && (owner == nullptr || info.space == owner)
+               && !(spareSmall && info.space != nullptr
+                      && info.space->residentFrames <= minQuota);
+    }
+
+    /// Pick a victim as `GetVictim` does, among the candidates.
+    unsigned FindVictim(AddressSpace *owner, bool spareSmall);
+
+    /// Whether the page in `frame` was referenced since the last call, by
+    /// any space mapping it.
+    bool TestAndClearUse(unsigned frame);
+
+    /// Take a frame, evicting some page if none is free.  The frame is left
+    /// allocated and unassigned.  If `space` is at its quota, one of its
+    /// own pages is evicted instead.
+    unsigned TakeFrame(AddressSpace *space = nullptr);
+
+    /// Adjust the quota of `space` to its page-fault frequency.
+    void AdjustQuota(AddressSpace *space);
+
+    /// Evict pages of `space`, releasing their frames, until it owns at
+    /// most `target` frames or the rest are pinned.
+    void Trim(AddressSpace *space, unsigned target);
+
+    /// Count a page-in by `space`, and suspend it if the system is
+    /// thrashing.
+    void ControlLoad(AddressSpace *space);
+
+    /// Count the user processes that are running or ready to run.
+    unsigned CountRunnable() const;
+
+    /// Resume every suspended process, as no other one is left to run.
+    void ResumeSuspended();
+
+    /// Wake the page cleaner up if free frames ran low.
+    void CheckWatermark();
+
+    /// Release `frame`.
+    void Free(unsigned frame);
+
+    /// Block until some frame was unpinned, loaded or freed since the
+    /// count of those events was `seen`.  Callers read the count before
+    /// looking for a frame, so that nothing released while they look, nor
+    /// while they take the lock, is missed.
+    void WaitForFrames(unsigned long seen);
+
+    /// A frame was unpinned, loaded or freed: wake up the threads waiting
+    /// for one.  Waking them may switch threads, so this is only called
+    /// where that is harmless.
+    void WakeFrameWaiters();
+
+    /// Take the page out of `victim`, saving it to swap if needed.  The
+    /// frame is left allocated, for the caller to reuse or free.
+    void Evict(unsigned victim);
+
+    /// Unmap the shared code in `frame` from every space that maps it.  The
+    /// frame is left allocated.
+    void DropText(unsigned frame);
+
+    /// Stop sharing code with `space`, releasing the frames that no other
+    /// space maps.
+    void DetachText(AddressSpace *space);
+
+    /// Unmap the copy-on-write `frame` from every space sharing it, and save
+    /// it to swap unless they all have it there already.  The frame is left
+    /// allocated.
+    void EvictShared(unsigned frame);
+
+    /// Take `space` out of its family, releasing the frames that no other
+    /// member maps.
+    void LeaveFamily(AddressSpace *space);
+
+    /// Give `frame` to page `vpn` of `space`.
+    void Assign(unsigned frame, AddressSpace *space, unsigned vpn);
+
+    /// Take `frame` out of the lists of its space and of LRU.
+    void Unlink(unsigned frame);
+
+    /// Add `frame` to, or take it out of, the list of frames of `space`.
+    void LinkToSpace(unsigned frame, AddressSpace *space);
+    void UnlinkFromSpace(unsigned frame);
+
+    void LruUnlink(unsigned frame);
+    void LruPushFront(unsigned frame);
+    void LruPushBack(unsigned frame);
+    void MoveToFront(unsigned frame);
+
+    FrameInfo *frames;
+
     unsigned numPhysPages;
-#ifndef USE_LRU
-    unsigned victimIndex = 0;
-#endif
+    ReplacementPolicy policy;
+
+    /// Shared frame of zeroes.
+    unsigned zeroFrame;
+
+    /// Next frame to consider, for FIFO and CLOCK.
+    unsigned victimIndex;
+
+    /// Ends of the LRU list, which holds exactly the frames marked in
+    /// `pages`.
+    unsigned lruHead;
+    unsigned lruTail;
+
     Bitmap *pages;
+
+    /// Every executable whose code is being shared.
+    SharedText *texts;
+
+    /// Threads waiting until some frame is unpinned, loaded or freed: when
+    /// every frame is pinned, or when a frame of shared code is still being
+    /// read in.
+    Lock *frameLock;
+    Condition *frameReleased;
+    unsigned numFrameWaiters;
+    unsigned long numFrameReleases;
+
+    /// Page cleaner: wakes it up, and tells whether it is already awake.
+    Semaphore *cleaner;
+    bool cleanerAwake;
+
+    /// Watermarks of free frames for the page cleaner.
+    unsigned lowWater;
+    unsigned highWater;
+
+    /// Frame quotas, or zero if replacement is global, and the page-fault
+    /// frequency threshold, or zero if quotas are fixed.
+    unsigned minQuota;
+    unsigned maxQuota;
+    unsigned pffInterval;
+
+    /// Load control, if `loadGap` is not zero: the page-ins counted since
+    /// the user ticks at `windowStart`, and the spaces there are, and how
+    /// many of them are suspended.
+    unsigned loadGap;
+    unsigned loadPause;
+    unsigned long long windowStart;
+    unsigned windowPageIns;
+    unsigned numSpaces;
+    unsigned numSuspended;
+
+    /// Suspended processes sleep here, in the order their alarms go off,
+    /// as all pauses are equally long.  Alarms of processes resumed early
+    /// are the oldest ones pending, and are counted to be ignored.
+    Semaphore *resumed;
+    unsigned numStaleAlarms;
 };
 
 
@@ -25,10 +25,10 @@ class ListElement {
 public:
 
     // Initialize a list element.
-    ListElement(Item itemPtr, int sortKey);
+    ListElement(Item itemPtr, long long sortKey);
 
     ListElement *next;  ///< Next element on list, null if this is the last.
-    int key;            ///< Priority, for a sorted list.
+    long long key;      ///< Priority, for a sorted list.
     Item item;          ///< Item on the list.
 };
 
@@ -73,10 +73,10 @@ public:
     /// Routines to put/get items on/off list in order (sorted by key).
 
     /// Put item into list.
-    void SortedInsert(Item item, int sortKey);
+    void SortedInsert(Item item, long long sortKey);
 
     /// Remove first item from list.
-    Item SortedPop(int *keyPtr);
+    Item SortedPop(long long *keyPtr);
 
 private:
 
@@ -91,7 +91,7 @@ private:
 /// * `anItem` is the item to be put on the list.
 /// * `sortKey` is the priority of the item, if any.
 template <class Item>
-ListElement<Item>::ListElement(Item anItem, int sortKey)
+ListElement<Item>::ListElement(Item anItem, long long sortKey)
 {
      item = anItem;
      key  = sortKey;
@@ -262,7 +262,7 @@ List<Item>::IsEmpty() const
 /// * `sortKey` is the priority of the item.
 template <class Item>
 void
-List<Item>::SortedInsert(Item item, int sortKey)
+List<Item>::SortedInsert(Item item, long long sortKey)
 {
     ListNode *element = new ListNode(item, sortKey);
 
@@ -290,14 +290,14 @@ List<Item>::SortedInsert(Item item, int sortKey)
 ///
 /// Returns pointer to removed item, null if nothing on the list.
 ///
-/// Sets `*keyPtr` to the priority value of the removed item (this is needed
-/// by `interrupt.cc`, for instance).
+/// Sets `*keyPtr` to the priority value of the removed item.  Keys are 64
+/// bits wide, so that simulated times can be used as keys.
 ///
 /// * `keyPtr` is a pointer to the location in which to store the priority of
 ///   the removed item.
 template <class Item>
 Item
-List<Item>::SortedPop(int *keyPtr)
+List<Item>::SortedPop(long long *keyPtr)
 {
     ListNode *element = first;
 
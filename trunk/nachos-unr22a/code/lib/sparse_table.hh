@@ -0,0 +1,186 @@
+/// A map from the integers below some size to some type, that only takes
+/// memory for the regions in use.
+///
+/// The table is kept in two levels: a directory of pointers to leaves of
+/// `LEAF_SIZE` consecutive elements.  A leaf is allocated, and all of its
+/// elements initialized, the first time one of them is asked for with
+/// `At`; until then, the directory only holds a null pointer for it.
+/// Finding an element takes two indexing steps whatever the size, and a
+/// leaf never moves once allocated, so pointers to its elements stay valid
+/// as long as the table.
+///
+/// Leaves are only freed along with the table, even once every element is
+/// back to its initial state, as when a process shrinks its heap.  This is
+/// on purpose: the MMU remembers pointers to page table entries, which
+/// would have to be tracked down before freeing a leaf, and what a process
+/// keeps is bounded by the most memory it ever touched, and given back when
+/// it exits.
+///
+/// Copyright (c) 2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_LIB_SPARSETABLE__HH
+#define NACHOS_LIB_SPARSETABLE__HH
+
+
+#include "assert.hh"
+#include "utility.hh"
+
+
+template <class T>
+class SparseTable {
+public:
+    static const unsigned LEAF_BITS = 6;
+    static const unsigned LEAF_SIZE = 1 << LEAF_BITS;
+
+    /// Construct a table of `size` elements, none of them allocated.  Each
+    /// element is set up with `init`, given its index, when its leaf is
+    /// allocated.
+    SparseTable(unsigned size, void (*init)(T *element, unsigned index));
+
+    /// Construct a copy of `other`, with the same leaves allocated.
+    SparseTable(const SparseTable &other);
+
+    ~SparseTable();
+
+    unsigned GetSize() const;
+
+    /// Return element `i`, or null if its leaf is not allocated.
+    T *Find(unsigned i) const;
+
+    /// Return element `i`, allocating its leaf if needed.
+    T &At(unsigned i);
+
+    /// Return the first index from `i` on whose leaf is allocated, or the
+    /// size of the table if there is none.  The allocated elements can be
+    /// visited with:
+    ///
+    ///     for (unsigned i = t.Next(0); i < t.GetSize(); i = t.Next(i + 1))
+    unsigned Next(unsigned i) const;
+
+    /// Number of leaves allocated.
+    unsigned CountLeaves() const;
+
+private:
+    SparseTable &operator=(const SparseTable &other);
+
+    /// Leaves, indexed by the high bits of the element index.
+    T **leaves;
+
+    unsigned size;
+    unsigned numLeaves;
+    void (*init)(T *element, unsigned index);
+};
+
+
+template <class T>
+SparseTable<T>::SparseTable(unsigned tableSize,
+                            void (*initElement)(T *element, unsigned index))
+{
+    ASSERT(initElement != nullptr);
+
+    size = tableSize;
+    numLeaves = DivRoundUp(size, LEAF_SIZE);
+    init = initElement;
+    leaves = new T * [numLeaves];
+    for (unsigned l = 0; l < numLeaves; l++) {
+        leaves[l] = nullptr;
+    }
+}
+
+template <class T>
+SparseTable<T>::SparseTable(const SparseTable &other)
+{
+    size = other.size;
+    numLeaves = other.numLeaves;
+    init = other.init;
+    leaves = new T * [numLeaves];
+    for (unsigned l = 0; l < numLeaves; l++) {
+        leaves[l] = nullptr;
+        if (other.leaves[l] != nullptr) {
+            leaves[l] = new T [LEAF_SIZE];
+            for (unsigned j = 0; j < LEAF_SIZE; j++) {
+                leaves[l][j] = other.leaves[l][j];
+            }
+        }
+    }
+}
+
+template <class T>
+SparseTable<T>::~SparseTable()
+{
+    for (unsigned l = 0; l < numLeaves; l++) {
+        delete [] leaves[l];
+    }
+    delete [] leaves;
+}
+
+template <class T>
+unsigned
+SparseTable<T>::GetSize() const
+{
+    return size;
+}
+
+template <class T>
+T *
+SparseTable<T>::Find(unsigned i) const
+{
+    ASSERT(i < size);
+
+    T *leaf = leaves[i >> LEAF_BITS];
+    return leaf != nullptr ? &leaf[i & (LEAF_SIZE - 1)] : nullptr;
+}
+
+template <class T>
+T &
+SparseTable<T>::At(unsigned i)
+{
+    ASSERT(i < size);
+
+    T *&leaf = leaves[i >> LEAF_BITS];
+    if (leaf == nullptr) {
+        leaf = new T [LEAF_SIZE];
+        unsigned first = i & ~(LEAF_SIZE - 1);
+        for (unsigned j = 0; j < LEAF_SIZE; j++) {
+            init(&leaf[j], first + j);
+        }
+    }
+    return leaf[i & (LEAF_SIZE - 1)];
+}
+
+template <class T>
+unsigned
+SparseTable<T>::Next(unsigned i) const
+{
+    if (i >= size) {
+        return size;
+    }
+    unsigned l = i >> LEAF_BITS;
+    if (leaves[l] != nullptr) {
+        return i;
+    }
+    for (l++; l < numLeaves; l++) {
+        if (leaves[l] != nullptr) {
+            return l << LEAF_BITS;
+        }
+    }
+    return size;
+}
+
+template <class T>
+unsigned
+SparseTable<T>::CountLeaves() const
+{
+    unsigned count = 0;
+    for (unsigned l = 0; l < numLeaves; l++) {
+        if (leaves[l] != nullptr) {
+            count++;
+        }
+    }
+    return count;
+}
+
+
+#endif
@@ -32,7 +32,7 @@
 static const char *INT_LEVEL_NAMES[] = { "disabled", "enabled" };
 static const char *INT_TYPE_NAMES[]  = {
     "timer", "disk", "console write", "console read",
-    "network send", "network recv"
+    "network send", "network recv", "alarm"
 };
 
 static inline bool
@@ -55,15 +55,171 @@ IsIntType(IntType t)
 /// * `time` is when (in simulated time) the interrupt is to occur.
 /// * `kind` is the hardware device that generated the interrupt.
 PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, void *param,
-                                   unsigned long time, IntType kind)
+                                   unsigned long long time, IntType kind)
 {
     ASSERT(func != nullptr);
     ASSERT(IsIntType(kind));
 
-    handler = func;
-    arg     = param;
-    when    = time;
-    type    = kind;
+    handler  = func;
+    arg      = param;
+    when     = time;
+    type     = kind;
+    order    = 0;
+    nextFree = nullptr;
+}
+
+PendingQueue::PendingQueue()
+{
+    capacity  = 16;
+    heap      = new PendingInterrupt * [capacity];
+    size      = 0;
+    pool      = nullptr;
+    scheduled = 0;
+}
+
+PendingQueue::~PendingQueue()
+{
+    for (unsigned i = 0; i < size; i++) {
+        delete heap[i];
+    }
+    delete [] heap;
+    while (pool != nullptr) {
+        PendingInterrupt *next = pool->nextFree;
+        delete pool;
+        pool = next;
+    }
+}
+
+bool
+PendingQueue::IsEmpty() const
+{
+    return size == 0;
+}
+
+unsigned
+PendingQueue::Size() const
+{
+    return size;
+}
+
+bool
+PendingQueue::Before(const PendingInterrupt *a, const PendingInterrupt *b)
+{
+    return a->when < b->when || (a->when == b->when && a->order < b->order);
+}
+
+void
+PendingQueue::SiftUp(unsigned i)
+{
+    PendingInterrupt *pend = heap[i];
+    while (i > 0) {
+        unsigned parent = (i - 1) / 2;
+        if (!Before(pend, heap[parent])) {
+            break;
+        }
+        heap[i] = heap[parent];
+        i = parent;
+    }
+    heap[i] = pend;
+}
+
+void
+PendingQueue::SiftDown(unsigned i)
+{
+    PendingInterrupt *pend = heap[i];
+    for (;;) {
+        unsigned child = 2 * i + 1;
+        if (child >= size) {
+            break;
+        }
+        if (child + 1 < size && Before(heap[child + 1], heap[child])) {
+            child++;
+        }
+        if (!Before(heap[child], pend)) {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = pend;
+}
+
+void
+PendingQueue::Insert(VoidFunctionPtr handler, void *arg,
+                     unsigned long long when, IntType type)
+{
+    PendingInterrupt *pend;
+    if (pool != nullptr) {
+        pend = pool;
+        pool = pool->nextFree;
+        pend->handler = handler;
+        pend->arg     = arg;
+        pend->when    = when;
+        pend->type    = type;
+    } else {
+        pend = new PendingInterrupt(handler, arg, when, type);
+    }
+    pend->order = scheduled++;
+
+    if (size == capacity) {
+        PendingInterrupt **larger = new PendingInterrupt * [2 * capacity];
+        for (unsigned i = 0; i < size; i++) {
+            larger[i] = heap[i];
+        }
+        delete [] heap;
+        heap = larger;
+        capacity *= 2;
+    }
+    heap[size] = pend;
+    SiftUp(size++);
+}
+
+const PendingInterrupt *
+PendingQueue::Peek() const
+{
+    return size > 0 ? heap[0] : nullptr;
+}
+
+PendingInterrupt *
+PendingQueue::Pop()
+{
+    ASSERT(size > 0);
+
+    PendingInterrupt *first = heap[0];
+    heap[0] = heap[--size];
+    if (size > 0) {
+        SiftDown(0);
+    }
+    return first;
+}
+
+void
+PendingQueue::Release(PendingInterrupt *pend)
+{
+    ASSERT(pend != nullptr);
+
+    pend->nextFree = pool;
+    pool = pend;
+}
+
+/// Only used for debugging, so it just sorts a copy of the heap.
+void
+PendingQueue::Apply(void (*func)(PendingInterrupt *)) const
+{
+    ASSERT(func != nullptr);
+
+    PendingInterrupt **sorted = new PendingInterrupt * [size];
+    for (unsigned i = 0; i < size; i++) {
+        unsigned j = i;
+        for (; j > 0 && Before(heap[i], sorted[j - 1]); j--) {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = heap[i];
+    }
+    for (unsigned i = 0; i < size; i++) {
+        func(sorted[i]);
+    }
+    delete [] sorted;
 }
 
 /// Initialize the simulation of hardware device interrupts.
@@ -72,7 +228,7 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, void *param,
 Interrupt::Interrupt()
 {
     level         = INT_OFF;
-    pending       = new List<PendingInterrupt *>;
+    pending       = new PendingQueue;
     inHandler     = false;
     yieldOnReturn = false;
     status        = SYSTEM_MODE;
@@ -81,9 +237,6 @@ Interrupt::Interrupt()
 /// De-allocate the data structures needed by the interrupt simulation.
 Interrupt::~Interrupt()
 {
-    while (!pending->IsEmpty()) {
-        delete pending->Pop();
-    }
     delete pending;
 }
 
@@ -156,7 +309,7 @@ Interrupt::OneTick()
         stats->totalTicks += USER_TICK;
         stats->userTicks += USER_TICK;
     }
-    DEBUG('i', "== Tick %u ==\n", stats->totalTicks);
+    DEBUG('i', "== Tick %llu ==\n", stats->totalTicks);
 
     // Check any pending interrupts are now ready to fire.
     ChangeLevel(INT_ON, INT_OFF);  // First, turn off interrupts (interrupt
@@ -172,6 +325,29 @@ Interrupt::OneTick()
     }
 }
 
+unsigned long long
+Interrupt::QuietTicks() const
+{
+    if (pending->IsEmpty()) {
+        return ULLONG_MAX;
+    }
+    unsigned long long next = pending->Peek()->when;
+    return next > stats->totalTicks ? next - stats->totalTicks - 1 : 0;
+}
+
+void
+Interrupt::AdvanceQuietly(unsigned long long ticks)
+{
+    ASSERT(ticks <= QuietTicks());
+
+    stats->totalTicks += ticks;
+    if (status == SYSTEM_MODE) {
+        stats->systemTicks += ticks;
+    } else {
+        stats->userTicks += ticks;
+    }
+}
+
 /// Called from within an interrupt handler, to cause a context switch (for
 /// example, on a time slice) in the interrupted thread, when the handler
 /// returns.
@@ -227,41 +403,14 @@ Interrupt::Halt()
     Cleanup();  // Never returns.
 }
 
-#ifdef DFS_TICKS_FIX
-/// Restart the total ticks statistic and the pending interrupts list.
-///
-/// This function makes sure Nachos keeps working even after overflowing the
-/// tick counter.  After some time (when `totalTicks` reach the maximum
-/// positive number) Nachos would schedule a pending interrupt at a negative
-/// time, and after that, it would hang.
-void
-Interrupt::RestartTicks()
-{
-    List<PendingInterrupt *> *oldPending = pending;
-    pending = new List<PendingInterrupt *>;
-
-    PendingInterrupt *i;
-    unsigned          oldWhen = 0;
-    while ((i = oldPending->SortedPop((int *) &oldWhen)) != nullptr) {
-        unsigned newWhen = oldWhen - stats->totalTicks;
-        pending->SortedInsert(i, newWhen);
-        DEBUG('x', "Interrupt at time %u re-scheduled at new time %u.\n",
-              oldWhen, newWhen);
-    }
-
-    delete oldPending;
-    stats->totalTicks = 0;
-    stats->tickResets += 1;
-}
-#endif
-
 /// Arrange for the CPU to be interrupted when simulated time reaches `now +
 /// when`.
 ///
-/// Implementation: just put it on a sorted list.
+/// Implementation: just put it in the queue of pending interrupts.
 ///
-/// NOTE: the Nachos kernel should not call this routine directly.  Instead,
-/// it is only called by the hardware device simulators.
+/// NOTE: the Nachos kernel should not call this routine directly, except to
+/// set alarms.  Instead, it is only called by the hardware device
+/// simulators.
 ///
 /// * `handler` is the procedure to call when the interrupt occurs.
 /// * `arg` is the argument to pass to the procedure.
@@ -270,31 +419,21 @@ Interrupt::RestartTicks()
 /// * `type` is the hardware device that generated the interrupt.
 void
 Interrupt::Schedule(VoidFunctionPtr handler, void *arg,
-                    unsigned long fromNow, IntType type)
+                    unsigned long long fromNow, IntType type)
 {
     ASSERT(handler != nullptr);
     ASSERT(fromNow > 0);
     ASSERT(IsIntType(type));
 
-#ifdef DFS_TICKS_FIX
-    if (UINT_MAX - stats->totalTicks < fromNow) {
-        DEBUG('x', "WARNING: total tick count is too large"
-                   " and will be reset.\n");
-        RestartTicks();
-    }
-#else
-    // Terminate Nachos if the ticks overflowed.
-    ASSERT(ULONG_MAX - stats->totalTicks > fromNow);
-#endif
+    // With 64-bit ticks this would take centuries of simulated time.
+    ASSERT(ULLONG_MAX - stats->totalTicks > fromNow);
 
-    unsigned when = stats->totalTicks + fromNow;
-    PendingInterrupt *toOccur = new PendingInterrupt(handler, arg,
-                                                     when, type);
+    unsigned long long when = stats->totalTicks + fromNow;
 
-    DEBUG('i', "Scheduling interrupt handler the %s at time = %u\n",
+    DEBUG('i', "Scheduling interrupt handler the %s at time = %llu\n",
           INT_TYPE_NAMES[type], when);
 
-    pending->SortedInsert(toOccur, when);
+    pending->Insert(handler, arg, when, type);
 }
 
 /// Check if an interrupt is scheduled to occur, and if so, fire it off.
@@ -309,35 +448,35 @@ bool
 Interrupt::CheckIfDue(bool advanceClock)
 {
     MachineStatus old = status;
-    unsigned      when;
 
     ASSERT(level == INT_OFF);  // Interrupts need to be disabled, to invoke
                                // an interrupt handler.
     if (debug.IsEnabled('i')) {
         DumpState();
     }
-    PendingInterrupt *toOccur = pending->SortedPop((int *) &when);
+    const PendingInterrupt *next = pending->Peek();
 
-    if (toOccur == nullptr) {  // No pending interrupts.
+    if (next == nullptr) {  // No pending interrupts.
         return false;
     }
 
+    unsigned long long when = next->when;
     if (advanceClock && when > stats->totalTicks) {  // Advance the clock.
         stats->idleTicks += (when - stats->totalTicks);
         stats->totalTicks = when;
-    } else if (when > stats->totalTicks) {  // Not time yet, put it back.
-        pending->SortedInsert(toOccur, when);
+    } else if (when > stats->totalTicks) {  // Not time yet.
         return false;
     }
 
     // Check if there is nothing more to do, and if so, quit.
-    if (status == IDLE_MODE && toOccur->type == TIMER_INT
-          && pending->IsEmpty()) {
-        pending->SortedInsert(toOccur, when);
+    if (status == IDLE_MODE && next->type == TIMER_INT
+          && pending->Size() == 1) {
         return false;
     }
 
-    DEBUG('i', "Invoking interrupt handler for the %s at time %u\n",
+    PendingInterrupt *toOccur = pending->Pop();
+
+    DEBUG('i', "Invoking interrupt handler for the %s at time %llu\n",
             INT_TYPE_NAMES[toOccur->type], toOccur->when);
 #ifdef USER_PROGRAM
     if (machine != nullptr) {
@@ -350,7 +489,7 @@ Interrupt::CheckIfDue(bool advanceClock)
     (*toOccur->handler)(toOccur->arg);  // Call the interrupt handler.
     status = old;  // Restore the machine status.
     inHandler = false;
-    delete toOccur;
+    pending->Release(toOccur);
     return true;
 }
 
@@ -379,7 +518,7 @@ PrintPending(PendingInterrupt *pend)
 {
     ASSERT(pend != nullptr);
 
-    printf("    Handler %s, scheduled at %lu\n",
+    printf("    Handler %s, scheduled at %llu\n",
            INT_TYPE_NAMES[pend->type], pend->when);
 }
 
@@ -388,7 +527,7 @@ PrintPending(PendingInterrupt *pend)
 void
 Interrupt::DumpState()
 {
-    printf("Time: %lu, interrupts %s\n",
+    printf("Time: %llu, interrupts %s\n",
            stats->totalTicks, INT_LEVEL_NAMES[level]);
     if (pending->IsEmpty()) {
         printf("No pending interrupts\n");
@@ -36,7 +36,7 @@
 #define NACHOS_MACHINE_INTERRUPT__HH
 
 
-#include "lib/list.hh"
+#include "lib/utility.hh"
 
 
 /// Interrupts can be disabled (`INT_OFF`) or enabled (`INT_ON`).
@@ -58,7 +58,8 @@ enum MachineStatus {
 
 /// `IntType` records which hardware device generated an interrupt.  In
 /// Nachos, we support a hardware timer device, a disk, a console display and
-/// keyboard, and a network.
+/// keyboard, and a network, plus one-shot alarms the kernel sets.  Unlike
+/// the timer, a pending alarm keeps an idle machine running.
 enum IntType {
     TIMER_INT,
     DISK_INT,
@@ -66,6 +67,7 @@ enum IntType {
     CONSOLE_READ_INT,
     NETWORK_SEND_INT,
     NETWORK_RECV_INT,
+    ALARM_INT,
     NUM_INT_TYPES
 };
 
@@ -79,14 +81,77 @@ public:
 
     /// initialize an interrupt that will occur in the future.
     PendingInterrupt(VoidFunctionPtr func, void *param,
-                     unsigned long time, IntType kind);
+                     unsigned long long time, IntType kind);
 
     VoidFunctionPtr handler;  ///< The function (in the hardware device
                               ///< emulator) to call when the interrupt
                               ///< occurs.
     void *arg;  ///< The argument to the function.
-    unsigned long when;  ///< When the interrupt is supposed to fire.
+    unsigned long long when;  ///< When the interrupt is supposed to fire.
     IntType type;  ///< For debugging.
+    unsigned long long order;  ///< Breaks ties between interrupts due at
+                               ///< the same time: the first scheduled
+                               ///< fires first.
+    PendingInterrupt *nextFree;  ///< Link in the pool of unused interrupts.
+};
+
+/// The set of interrupts scheduled to occur in the future.
+///
+/// Kept as a binary min-heap ordered by due time, so that scheduling and
+/// firing an interrupt take O(log n), and checking whether anything is due
+/// takes O(1) without taking the earliest interrupt out.  Interrupts that
+/// fired are kept in a pool and reused, instead of going back to the heap
+/// allocator every time.
+class PendingQueue {
+public:
+
+    /// Initialize an empty queue.
+    PendingQueue();
+
+    /// De-allocate the queue, including all pending and pooled interrupts.
+    ~PendingQueue();
+
+    bool IsEmpty() const;
+
+    unsigned Size() const;
+
+    /// Schedule an interrupt at time `when`.
+    void Insert(VoidFunctionPtr handler, void *arg,
+                unsigned long long when, IntType type);
+
+    /// Return the earliest interrupt, leaving it in the queue, or null if
+    /// the queue is empty.
+    const PendingInterrupt *Peek() const;
+
+    /// Remove the earliest interrupt and return it.  It must be handed
+    /// back with `Release` once it is no longer needed.
+    PendingInterrupt *Pop();
+
+    /// Return an interrupt obtained from `Pop` to the pool.
+    void Release(PendingInterrupt *pend);
+
+    /// Apply `func` to every pending interrupt, in the order they will
+    /// fire.
+    void Apply(void (*func)(PendingInterrupt *)) const;
+
+private:
+
+    /// Whether `a` has to fire before `b`.
+    static bool Before(const PendingInterrupt *a, const PendingInterrupt *b);
+
+    /// Restore the heap property by moving the entry at `i` up or down.
+    void SiftUp(unsigned i);
+    void SiftDown(unsigned i);
+
+    PendingInterrupt **heap;
+    unsigned size;
+    unsigned capacity;
+
+    /// Unused interrupts, linked through `nextFree`.
+    PendingInterrupt *pool;
+
+    /// Counter for the `order` of new interrupts.
+    unsigned long long scheduled;
 };
 
 /// The following class defines the data structures for the simulation
@@ -138,17 +203,29 @@ public:
 
     /// Schedule an interrupt to occur at time ``when''.
     ///
-    /// This is called by the hardware device simulators.
+    /// This is called by the hardware device simulators, and by the kernel
+    /// to set alarms.
     void Schedule(VoidFunctionPtr handler, void *arg,
-                  unsigned long when, IntType type);
+                  unsigned long long when, IntType type);
 
     /// Advance simulated time.
     void OneTick();
 
+    /// Number of ticks that can elapse before any pending interrupt is
+    /// due.
+    unsigned long long QuietTicks() const;
+
+    /// Advance simulated time by `ticks` without checking for interrupts.
+    ///
+    /// Only allowed within `QuietTicks`; lets the machine account for
+    /// several instructions at once, with the same result as calling
+    /// `OneTick` after each of them.
+    void AdvanceQuietly(unsigned long long ticks);
+
 private:
     IntStatus level;  ///< Are interrupts enabled or disabled?
-    List<PendingInterrupt *> *pending;  ///< The list of interrupts scheduled
-                                        ///< to occur in the future.
+    PendingQueue *pending;  ///< The interrupts scheduled to occur in the
+                            ///< future.
     bool inHandler;  ///< True if we are running an interrupt handler.
     bool yieldOnReturn;  ///< True if we are to context switch on return from
                          ///< the interrupt handler.
@@ -163,11 +240,6 @@ private:
     void ChangeLevel(IntStatus old,
                      IntStatus now);
 
-#ifdef DFS_TICKS_FIX
-    /// Restart total ticks and the pending interrupt list.
-    void RestartTicks();
-#endif
-
 };
 
 
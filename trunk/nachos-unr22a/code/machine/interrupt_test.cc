@@ -0,0 +1,115 @@
+/// Performance test for the queue of pending interrupts.
+///
+/// Simulates devices that keep a fixed number of interrupts pending: every
+/// time the earliest one fires, a new one is scheduled some random time
+/// later.  The same workload is run on `PendingQueue` and on the sorted
+/// `List` the queue used to be, and the host time per fired interrupt is
+/// printed for both.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "interrupt.hh"
+#include "lib/list.hh"
+
+#include <stdio.h>
+#include <time.h>
+
+
+/// Interrupts fired on the queue for every number of pending interrupts.
+static const unsigned NUM_EVENTS = 4000000;
+
+/// Interrupts fired on the list; fewer, as it gets slow quickly.
+static const unsigned NUM_LIST_EVENTS = 200000;
+
+/// Numbers of pending interrupts to try.
+static const unsigned PENDING[] = { 4, 16, 64, 256, 1024 };
+
+/// Maximum delay between an interrupt and the one it schedules.
+static const unsigned MAX_DELAY = 1000;
+
+static void
+DoNothing(void *arg)
+{}
+
+/// A small linear congruential generator, so that both runs see the same
+/// delays without disturbing the system's random numbers.
+static unsigned
+NextDelay(unsigned *seed)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return 1 + (*seed >> 16) % MAX_DELAY;
+}
+
+static double
+Seconds(clock_t start)
+{
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+/// Returns the host time per interrupt in nanoseconds.
+static double
+RunQueue(unsigned pending, unsigned events)
+{
+    PendingQueue queue;
+    unsigned seed = 1;
+    unsigned long long now = 0;
+
+    for (unsigned i = 0; i < pending; i++) {
+        queue.Insert(DoNothing, nullptr, now + NextDelay(&seed), TIMER_INT);
+    }
+
+    clock_t start = clock();
+    for (unsigned i = 0; i < events; i++) {
+        PendingInterrupt *pend = queue.Pop();
+        now = pend->when;
+        queue.Release(pend);
+        queue.Insert(DoNothing, nullptr, now + NextDelay(&seed), TIMER_INT);
+    }
+    return Seconds(start) * 1e9 / events;
+}
+
+static double
+RunList(unsigned pending, unsigned events)
+{
+    List<PendingInterrupt *> list;
+    unsigned seed = 1;
+    unsigned long long now = 0;
+
+    for (unsigned i = 0; i < pending; i++) {
+        unsigned long long when = now + NextDelay(&seed);
+        list.SortedInsert(new PendingInterrupt(DoNothing, nullptr,
+                                               when, TIMER_INT), when);
+    }
+
+    clock_t start = clock();
+    for (unsigned i = 0; i < events; i++) {
+        PendingInterrupt *pend = list.SortedPop(nullptr);
+        now = pend->when;
+        delete pend;
+        unsigned long long when = now + NextDelay(&seed);
+        list.SortedInsert(new PendingInterrupt(DoNothing, nullptr,
+                                               when, TIMER_INT), when);
+    }
+    double result = Seconds(start) * 1e9 / events;
+
+    while (!list.IsEmpty()) {
+        delete list.Pop();
+    }
+    return result;
+}
+
+void
+InterruptPerformanceTest()
+{
+    printf("Pending interrupt queue: %u interrupts (%u on the list).\n",
+           NUM_EVENTS, NUM_LIST_EVENTS);
+    printf("%10s %14s %14s\n", "pending", "queue ns/int", "list ns/int");
+    for (unsigned i = 0; i < sizeof PENDING / sizeof *PENDING; i++) {
+        double queue = RunQueue(PENDING[i], NUM_EVENTS);
+        double list  = RunList(PENDING[i], NUM_LIST_EVENTS);
+        printf("%10u %14.1f %14.1f\n", PENDING[i], queue, list);
+    }
+}
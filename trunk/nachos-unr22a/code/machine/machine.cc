@@ -45,7 +45,13 @@ CheckEndian()
 /// * `st` -- pointer to an object that performs single stepping, for
 ///   dropping into it after each user instruction is executed; if null,
 ///   execute normally, without single stepping.
-Machine::Machine(SingleStepper *st)
+/// * `e` -- engine used to execute user instructions.  Single stepping
+///   always goes through the interpreter.
+/// * `numPhysPages` -- size of main memory, in pages.
+/// * `tlbSize` -- number of entries of the TLB, if there is one.
+Machine::Machine(SingleStepper *st, ExecutionEngine e,
+                 unsigned numPhysPages, unsigned tlbSize)
+  : mmu(numPhysPages, tlbSize)
 {
     for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
         registers[i] = 0;
@@ -55,7 +61,12 @@ Machine::Machine(SingleStepper *st)
         handlers[i] = nullptr;
     }
 
-    singleStepper = st;
+    singleStepper  = st;
+    engine         = e;
+    pendingTicks   = 0;
+    codeCache      = nullptr;
+    codeCacheUsed  = 0;
+    codeGeneration = 0;
     CheckEndian();
 }
 
@@ -128,6 +139,7 @@ Machine::RaiseException(ExceptionType et, unsigned badVAddr)
     DEBUG('m', "Exception: %s\n", ExceptionTypeToString(et));
 
     //ASSERT(interrupt->GetStatus() == USER_MODE);
+    ChargeTicks();  // The kernel must see the right time.
     registers[BAD_VADDR_REG] = badVAddr;
     DelayedLoad(0, 0);  // Finish anything in progress.
 
@@ -137,6 +149,15 @@ Machine::RaiseException(ExceptionType et, unsigned badVAddr)
     interrupt->SetStatus(USER_MODE);
 }
 
+void
+Machine::ChargeTicks()
+{
+    if (pendingTicks > 0) {
+        interrupt->AdvanceQuietly(pendingTicks);
+        pendingTicks = 0;
+    }
+}
+
 void
 Machine::SetHandler(ExceptionType et, ExceptionHandler handler)
 {
@@ -49,8 +49,34 @@ enum {
 
 class Instruction;
 
+/// Words overwritten by a sandboxed run of a block, with their old
+/// contents.  A block has at most one store per instruction.
+struct SandboxLog {
+    unsigned count;
+    unsigned addr[PAGE_SIZE / 4];
+    int value[PAGE_SIZE / 4];
+};
+
+/// Ways of executing user instructions; see `Machine::Run`.
+enum ExecutionEngine {
+    INTERPRETER_ENGINE,  ///< Fetch, decode and execute one instruction at a
+                         ///< time.
+    THREADED_ENGINE,     ///< Run pre-translated basic blocks through direct
+                         ///< threading, falling back to the interpreter for
+                         ///< anything it does not translate.
+    JIT_ENGINE,          ///< Like `THREADED_ENGINE`, but compile hot
+                         ///< blocks to host code.
+    CHECKED_ENGINE       ///< Run every block (compiled once hot) and
+                         ///< interpret it again, comparing the register
+                         ///< files; for testing the other engines only.
+};
+
 typedef void (*ExceptionHandler)(ExceptionType);
 
+/// Simulate R2000 multiplication, leaving the double-length result of
+/// `a * b` in `*hiPtr` and `*loPtr`.
+void Mult(int a, int b, bool signedArith, int *hiPtr, int *loPtr);
+
 /// The following class defines the simulated host workstation hardware, as
 /// seen by user programs -- the CPU registers, main memory, etc.
 ///
@@ -62,13 +88,18 @@ typedef void (*ExceptionHandler)(ExceptionType);
 /// If we were to implement more of the UNIX system calls, we ought to be
 /// able to run Nachos on top of Nachos!
 ///
-/// The procedures in this class are defined in `machine.cc` and
-/// `mips_sim.cc`.
+/// The procedures in this class are defined in `machine.cc`, `mips_sim.cc`
+/// and `mips_threaded.cc`.
 class Machine {
 public:
 
     /// Initialize the simulation of the hardware for running user programs.
-    Machine(SingleStepper *st);
+    Machine(SingleStepper *st, ExecutionEngine e = INTERPRETER_ENGINE,
+            unsigned numPhysPages = DEFAULT_NUM_PHYS_PAGES,
+            unsigned tlbSize = DEFAULT_TLB_SIZE);
+
+    /// De-allocate the code cache, if any.
+    ~Machine();
 
     /// Routines callable by the Nachos kernel.
 
@@ -103,7 +134,9 @@ public:
     bool FetchInstruction(Instruction *instr);
 
     /// Run a certain instruction of a user program.
-    void ExecInstruction(const Instruction *instr);
+    ///
+    /// Return false if an exception occurs, true otherwise.
+    bool ExecInstruction(const Instruction *instr);
 
     /// Do a pending delayed load (modifying a reg).
     void DelayedLoad(unsigned nextReg, int nextVal);
@@ -121,6 +154,70 @@ public:
     void SetHandler(ExceptionType et, ExceptionHandler handler);
 
 private:
+
+    /// Account for the ticks of the instructions run since the last
+    /// interrupt check, all at once.
+    void ChargeTicks();
+
+    /// Threaded engine, in `mips_threaded.cc`.
+
+    /// Run the block at the current PC, or a single instruction if there is
+    /// no block to run there.
+    void RunBlock(Instruction *instr);
+
+    /// Translate the instructions starting at physical address `physAddr`.
+    ThreadedBlock *TranslateBlock(unsigned physAddr);
+
+    /// Execute `block` from its first operation.
+    ///
+    /// Stops at the end of the block, when the PC leaves it, or when an
+    /// operation needs to raise an exception; in the last case, the
+    /// exception is returned, the address goes to `badVAddr`, and the
+    /// machine is left exactly as `ExecInstruction` leaves it before
+    /// trapping.  `executed` counts the operations that completed.
+    ///
+    /// In sandbox mode, simulated time is not advanced and the old contents
+    /// of every written word are recorded in `log`, so that the run can be
+    /// undone.
+    template <bool SANDBOX>
+    ExceptionType ExecBlock(ThreadedBlock *block, unsigned *badVAddr,
+                            unsigned *executed, SandboxLog *log);
+
+    /// Run `block` in sandbox mode, undo it, redo it with the interpreter,
+    /// and check that both runs agree.
+    void CheckBlock(ThreadedBlock *block, Instruction *instr);
+
+    /// Compiler to host code, in `mips_jit.cc`.
+
+    /// Compile `block` into the code cache, if the host and the block allow
+    /// it.
+    void CompileBlock(ThreadedBlock *block);
+
+    /// Whether `block` has host code in the current cache generation.
+    bool IsCompiled(const ThreadedBlock *block) const;
+
+    /// Run the host code of `block`, with the same conventions as
+    /// `ExecBlock`, except that simulated time is never advanced: the
+    /// caller accounts for the `executed` instructions.
+    ExceptionType ExecNative(ThreadedBlock *block, unsigned *badVAddr,
+                             unsigned *executed, SandboxLog *log);
+
+    ExecutionEngine engine;
+
+    /// Ticks of instructions already run but not yet accounted for.  Only
+    /// ever non-zero while no interrupt can be due, and always charged
+    /// before trapping into the kernel.
+    unsigned long long pendingTicks;
+
+    /// Executable memory holding the host code of compiled blocks.
+    unsigned char *codeCache;
+
+    /// Bytes of `codeCache` in use.
+    unsigned codeCacheUsed;
+
+    /// Incremented every time the code cache is flushed.
+    unsigned codeGeneration;
+
     SingleStepper *singleStepper;  ///< Drop back into the method of a
                                    ///< provided object (may be a debugger)
                                    ///< after each simulated instruction.
@@ -0,0 +1,883 @@
+/// Compiler from threaded blocks to host code.
+///
+/// Blocks that the threaded engine runs often are compiled to x86-64 code,
+/// one host routine per block.  The generated code works directly on the
+/// simulated register file and calls back into the MMU for every memory
+/// access, so translation, use and dirty bits, and statistics are exactly
+/// those of the interpreter.  Program counters are only materialized when
+/// leaving the routine.
+///
+/// Host code never advances simulated time and never traps: it stops
+/// before an instruction that raises an exception, and leaves raising it,
+/// and the ticks of the instructions it ran, to its caller.  This means no
+/// thread is ever switched out in the middle of host code, so the code
+/// cache can be flushed at any time outside of it; blocks keep a generation
+/// number to tell whether their code survived the last flush.
+///
+/// On hosts other than x86-64 nothing is ever compiled, and the JIT engine
+/// behaves exactly as the threaded one.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "machine.hh"
+#include "threads/system.hh"
+
+#include <stddef.h>
+#include <string.h>
+#ifdef HOST_x86_64
+#include <sys/mman.h>
+#endif
+
+
+/// State shared between the host code of a block and the routines it
+/// calls.  Offsets into it are hardcoded in the generated code through
+/// `offsetof`.
+struct JitContext {
+    int *registers;
+    MMU *mmu;
+    ThreadedBlock *block;
+    SandboxLog *log;           ///< Null unless running in a sandbox.
+    unsigned physAddr;         ///< Address of the block.
+    unsigned fetched;          ///< Instruction fetches accounted for.
+    unsigned fetchTarget;      ///< Fetches up to the current instruction.
+    int exception;             ///< Exception to raise when leaving.
+    unsigned badVAddr;
+    int loaded;                ///< Result of the last load.
+    unsigned char leave;       ///< Set when a store drops the block.
+};
+
+typedef unsigned (*NativeCode)(JitContext *ctx);
+
+/// Size of the code cache.
+static const unsigned CODE_CACHE_SIZE = 1 << 20;
+
+/// Upper bound for the code of a single block.  A block has at most
+/// `PAGE_SIZE / 4` instructions, none of which takes more than 128 bytes,
+/// plus at most one exit path (64 bytes) and one overflow path (32 bytes)
+/// for each.
+static const unsigned MAX_NATIVE_SIZE = (PAGE_SIZE / 4 + 1) * 256;
+
+#ifdef HOST_x86_64
+/// Make the code cache writable while a block is being emitted into it,
+/// or executable otherwise; it is never both at once.
+static void
+ProtectCodeCache(unsigned char *cache, bool writable)
+{
+    int rv = mprotect(cache, CODE_CACHE_SIZE,
+                      writable ? PROT_READ | PROT_WRITE
+                               : PROT_READ | PROT_EXEC);
+    ASSERT(rv == 0);
+}
+#endif
+
+/// The code cache itself is only allocated once some block gets compiled.
+Machine::~Machine()
+{
+#ifdef HOST_x86_64
+    if (codeCache != nullptr) {
+        munmap(codeCache, CODE_CACHE_SIZE);
+    }
+#endif
+}
+
+bool
+Machine::IsCompiled(const ThreadedBlock *block) const
+{
+    return block->native != nullptr
+           && block->nativeGeneration == codeGeneration;
+}
+
+/// Routines called from host code.
+///
+/// They follow the host calling convention, and report an exception by
+/// recording it in the context and returning non-zero.
+
+/// Account for the fetches of the instructions run since the last call.
+static void
+AccountFetches(JitContext *ctx)
+{
+    if (ctx->log == nullptr && ctx->fetchTarget > ctx->fetched) {
+        ctx->mmu->RepeatFetch(ctx->physAddr, ctx->fetchTarget - ctx->fetched);
+    }
+    ctx->fetched = ctx->fetchTarget;
+}
+
+static int
+JitLoad(JitContext *ctx, int addr, unsigned kind)
+{
+    AccountFetches(ctx);
+
+    int value;
+    ExceptionType e;
+    switch (kind) {
+        case TK_LB:
+        case TK_LBU:
+            e = ctx->mmu->ReadMem(addr, 1, &value);
+            if (e != NO_EXCEPTION) {
+                break;
+            }
+            if (value & 0x80 && kind == TK_LB) {
+                value |= 0xFFFFFF00;
+            } else {
+                value &= 0xFF;
+            }
+            break;
+
+        case TK_LH:
+        case TK_LHU:
+            if (addr & 0x1) {
+                e = ADDRESS_ERROR_EXCEPTION;
+                break;
+            }
+            e = ctx->mmu->ReadMem(addr, 2, &value);
+            if (e != NO_EXCEPTION) {
+                break;
+            }
+            if (value & 0x8000 && kind == TK_LH) {
+                value |= 0xFFFF0000;
+            } else {
+                value &= 0xFFFF;
+            }
+            break;
+
+        default:
+            ASSERT(kind == TK_LW);
+            if (addr & 0x3) {
+                e = ADDRESS_ERROR_EXCEPTION;
+                break;
+            }
+            e = ctx->mmu->ReadMem(addr, 4, &value);
+            break;
+    }
+
+    if (e != NO_EXCEPTION) {
+        ctx->exception = e;
+        ctx->badVAddr = addr;
+        return 1;
+    }
+    ctx->loaded = value;
+    return 0;
+}
+
+static int
+JitStore(JitContext *ctx, unsigned addr, int value, unsigned size)
+{
+    AccountFetches(ctx);
+
+    int old = 0;
+    ExceptionType e = NO_EXCEPTION;
+    if (ctx->log != nullptr) {
+        e = ctx->mmu->ReadMem(addr & ~0x3, 4, &old);
+    }
+    if (e == NO_EXCEPTION) {
+        e = ctx->mmu->WriteMem(addr, size, value);
+    }
+    if (e != NO_EXCEPTION) {
+        ctx->exception = e;
+        ctx->badVAddr = addr;
+        return 1;
+    }
+
+    if (ctx->log != nullptr) {
+        SandboxLog *log = ctx->log;
+        log->addr[log->count] = addr & ~0x3;
+        log->value[log->count] = old;
+        log->count++;
+    }
+    if (ctx->block->dead) {  // The block just overwrote itself.
+        ctx->leave = 1;
+    }
+    return 0;
+}
+
+static void
+JitMultiply(JitContext *ctx, unsigned kind, int rs, int rt)
+{
+    int *registers = ctx->registers;
+    int tmp;
+
+    switch (kind) {
+        case TK_MULT:
+            Mult(rs, rt, true, &registers[HI_REG], &registers[LO_REG]);
+            break;
+
+        case TK_MULTU:
+            Mult(rs, rt, false, &registers[HI_REG], &registers[LO_REG]);
+            break;
+
+        case TK_DIV:
+            if (rt == 0) {
+                registers[LO_REG] = 0;
+                registers[HI_REG] = 0;
+            } else {
+                registers[LO_REG] = rs / rt;
+                registers[HI_REG] = rs % rt;
+            }
+            break;
+
+        default:
+            ASSERT(kind == TK_DIVU);
+            if (rt == 0) {
+                registers[LO_REG] = 0;
+                registers[HI_REG] = 0;
+            } else {
+                tmp = (unsigned) rs / (unsigned) rt;
+                registers[LO_REG] = tmp;
+                tmp = (unsigned) rs % (unsigned) rt;
+                registers[HI_REG] = tmp;
+            }
+            break;
+    }
+}
+
+#ifdef HOST_x86_64
+
+/// Host registers.  `rbx` holds the simulated register file, `r12d` the
+/// virtual address of the block, `r13d` the destination of its branch and
+/// `r14` the context; `eax`, `ecx` and `edx` are scratch.
+enum {
+    EAX = 0, ECX = 1, EDX = 2, EBX = 3, ESI = 6, EDI = 7
+};
+
+/// Condition codes, as encoded in `jcc` and `setcc`.
+enum {
+    CC_O = 0x0, CC_B = 0x2, CC_E = 0x4, CC_NE = 0x5,
+    CC_L = 0xC, CC_GE = 0xD, CC_LE = 0xE, CC_G = 0xF
+};
+
+/// Extensions of the `0x81` and shift opcodes.
+enum {
+    ALU_ADD = 0, ALU_OR = 1, ALU_AND = 4, ALU_SUB = 5, ALU_XOR = 6,
+    ALU_CMP = 7, SHIFT_SHL = 4, SHIFT_SAR = 7
+};
+
+/// Opcodes of `op r/m32, r32`.
+enum {
+    OPC_ADD = 0x01, OPC_OR = 0x09, OPC_AND = 0x21, OPC_SUB = 0x29,
+    OPC_XOR = 0x31, OPC_CMP = 0x39
+};
+
+/// Minimal x86-64 assembler, just for what the compiler needs.
+class CodeWriter {
+public:
+    CodeWriter(unsigned char *start)
+    {
+        pos = start;
+    }
+
+    void Byte(unsigned b)
+    {
+        *pos++ = (unsigned char) b;
+    }
+
+    void Word(unsigned w)
+    {
+        memcpy(pos, &w, 4);
+        pos += 4;
+    }
+
+    static unsigned
+    ModRM(unsigned mod, unsigned reg, unsigned rm)
+    {
+        return mod << 6 | (reg & 7) << 3 | (rm & 7);
+    }
+
+    /// `mov host, [rbx + 4 * reg]`.
+    void LoadReg(unsigned host, unsigned reg)
+    {
+        Byte(0x8B); Byte(ModRM(2, host, EBX)); Word(reg * 4);
+    }
+
+    /// `mov [rbx + 4 * reg], host`.
+    void StoreReg(unsigned reg, unsigned host)
+    {
+        Byte(0x89); Byte(ModRM(2, host, EBX)); Word(reg * 4);
+    }
+
+    /// `mov dword [rbx + 4 * reg], imm`.
+    void StoreRegImm(unsigned reg, int imm)
+    {
+        Byte(0xC7); Byte(ModRM(2, 0, EBX)); Word(reg * 4); Word(imm);
+    }
+
+    /// `op dst, src`.
+    void Alu(unsigned opcode, unsigned dst, unsigned src)
+    {
+        Byte(opcode); Byte(ModRM(3, src, dst));
+    }
+
+    /// `op dst, imm`.
+    void AluImm(unsigned ext, unsigned dst, int imm)
+    {
+        Byte(0x81); Byte(ModRM(3, ext, dst)); Word(imm);
+    }
+
+    /// `shl`/`sar dst, count`.
+    void ShiftImm(unsigned ext, unsigned dst, unsigned count)
+    {
+        Byte(0xC1); Byte(ModRM(3, ext, dst)); Byte(count);
+    }
+
+    /// `shl`/`sar dst, cl`.
+    void ShiftCl(unsigned ext, unsigned dst)
+    {
+        Byte(0xD3); Byte(ModRM(3, ext, dst));
+    }
+
+    /// `not dst`.
+    void Not(unsigned dst)
+    {
+        Byte(0xF7); Byte(ModRM(3, 2, dst));
+    }
+
+    /// `setcc al; movzx eax, al`.
+    void SetCC(unsigned cc)
+    {
+        Byte(0x0F); Byte(0x90 | cc); Byte(0xC0);
+        Byte(0x0F); Byte(0xB6); Byte(0xC0);
+    }
+
+    /// `mov dst, src`.
+    void Mov(unsigned dst, unsigned src)
+    {
+        Byte(0x89); Byte(ModRM(3, src, dst));
+    }
+
+    /// `mov dst, imm`.
+    void MovImm(unsigned dst, int imm)
+    {
+        Byte(0xB8 + dst); Word(imm);
+    }
+
+    /// `mov dst, r12d; add dst, offset`: a virtual address in the block.
+    void BlockAddr(unsigned dst, int offset)
+    {
+        Byte(0x44); Byte(0x89); Byte(ModRM(3, 4, dst));
+        if (offset != 0) {
+            AluImm(ALU_ADD, dst, offset);
+        }
+    }
+
+    /// `lea r13d, [r12 + offset]`.
+    void SetTarget(int offset)
+    {
+        Byte(0x45); Byte(0x8D); Byte(0xAC); Byte(0x24); Word(offset);
+    }
+
+    /// `mov r13d, eax`.
+    void SetTargetFromEax()
+    {
+        Byte(0x41); Byte(0x89); Byte(0xC5);
+    }
+
+    /// `mov eax, r13d`.
+    void TargetToEax()
+    {
+        Byte(0x44); Byte(0x89); Byte(0xE8);
+    }
+
+    /// `mov dword [r14 + offset], imm`.
+    void StoreContextImm(unsigned offset, int imm)
+    {
+        Byte(0x41); Byte(0xC7); Byte(ModRM(2, 0, 6)); Word(offset);
+        Word(imm);
+    }
+
+    /// `mov host, [r14 + offset]`.
+    void LoadContext(unsigned host, unsigned offset)
+    {
+        Byte(0x41); Byte(0x8B); Byte(ModRM(2, host, 6)); Word(offset);
+    }
+
+    /// `cmp byte [r14 + offset], 0`.
+    void TestContextByte(unsigned offset)
+    {
+        Byte(0x41); Byte(0x80); Byte(ModRM(2, 7, 6)); Word(offset);
+        Byte(0);
+    }
+
+    /// `mov rdi, r14; mov rax, function; call rax`.
+    void Call(const void *function)
+    {
+        unsigned long address = (unsigned long) function;
+        Byte(0x4C); Byte(0x89); Byte(0xF7);
+        Byte(0x48); Byte(0xB8);
+        Word((unsigned) address); Word((unsigned) (address >> 32));
+        Byte(0xFF); Byte(0xD0);
+    }
+
+    /// `test eax, eax`.
+    void TestEax()
+    {
+        Byte(0x85); Byte(0xC0);
+    }
+
+    /// `jcc rel32`, to be patched; returns where the offset goes.
+    unsigned char *JumpIf(unsigned cc)
+    {
+        Byte(0x0F); Byte(0x80 | cc); Word(0);
+        return pos - 4;
+    }
+
+    /// `jmp rel32`, to be patched.
+    unsigned char *Jump()
+    {
+        Byte(0xE9); Word(0);
+        return pos - 4;
+    }
+
+    /// `jcc` over the next `length` bytes.
+    void SkipIf(unsigned cc, unsigned length)
+    {
+        Byte(0x70 | cc); Byte(length);
+    }
+
+    static void
+    Patch(unsigned char *at, const unsigned char *target)
+    {
+        int offset = (int) (target - (at + 4));
+        memcpy(at, &offset, 4);
+    }
+
+    void Prologue()
+    {
+        Byte(0x53);                             // push rbx
+        Byte(0x41); Byte(0x54);                 // push r12
+        Byte(0x41); Byte(0x55);                 // push r13
+        Byte(0x41); Byte(0x56);                 // push r14
+        Byte(0x41); Byte(0x57);                 // push r15
+        Byte(0x49); Byte(0x89); Byte(0xFE);     // mov r14, rdi
+        Byte(0x49); Byte(0x8B); Byte(ModRM(2, EBX, 6));
+        Word(offsetof(JitContext, registers));  // mov rbx, [r14 + ...]
+        Byte(0x44); Byte(0x8B); Byte(ModRM(2, 4, EBX));
+        Word(PC_REG * 4);                       // mov r12d, [rbx + ...]
+    }
+
+    void Epilogue()
+    {
+        Byte(0x41); Byte(0x5F);                 // pop r15
+        Byte(0x41); Byte(0x5E);                 // pop r14
+        Byte(0x41); Byte(0x5D);                 // pop r13
+        Byte(0x41); Byte(0x5C);                 // pop r12
+        Byte(0x5B);                             // pop rbx
+        Byte(0xC3);                             // ret
+    }
+
+    unsigned char *pos;
+};
+
+/// A jump to an exit of the block, to be patched once exits are emitted.
+struct ExitJump {
+    unsigned char *at;
+    unsigned exit;      ///< Instructions completed when taking it.
+    bool overflow;      ///< Whether it has to record an overflow first.
+};
+
+/// Emit the equivalent of `Machine::DelayedLoad` for operation `op`;
+/// `valueReg` holds the loaded value, if it is a load.
+static void
+EmitDelayedLoad(CodeWriter *w, const ThreadedOp *op, unsigned valueReg)
+{
+    bool load = IsLoad(op->kind);
+
+    if (op->finishLoad) {
+        w->LoadReg(EAX, LOAD_REG);
+        w->LoadReg(ECX, LOAD_VALUE_REG);
+        w->Byte(0x89); w->Byte(0x0C); w->Byte(0x83);  // mov [rbx+rax*4], ecx
+        w->StoreRegImm(0, 0);
+    } else if (!load) {
+        return;  // Nothing pending, nothing new.
+    }
+    w->StoreRegImm(LOAD_REG, load ? op->instr.rt : 0);
+    if (load) {
+        w->StoreReg(LOAD_VALUE_REG, valueReg);
+    } else {
+        w->StoreRegImm(LOAD_VALUE_REG, 0);
+    }
+}
+
+/// Emit operation `op`, the `index`-th of the block.
+///
+/// Returns false if the operation cannot be compiled.
+static bool
+EmitOp(CodeWriter *w, const ThreadedOp *op, unsigned index,
+       ExitJump *exits, unsigned *numExits)
+{
+    const Instruction *in = &op->instr;
+    int offset = index * 4;
+    int imm = in->extra;
+    int branch = (int) ((unsigned) imm << 2);
+    unsigned cc;
+
+    switch (op->kind) {
+        case TK_NOP:
+            break;
+
+        case TK_LI:
+            w->StoreRegImm(in->rt, imm);
+            break;
+
+        case TK_MOVE:
+            w->LoadReg(EAX, in->rs);
+            w->StoreReg(in->rd, EAX);
+            break;
+
+        case TK_ADD:
+        case TK_SUB:
+            w->LoadReg(EAX, in->rs);
+            w->LoadReg(ECX, in->rt);
+            w->Alu(op->kind == TK_ADD ? OPC_ADD : OPC_SUB, EAX, ECX);
+            exits[(*numExits)++] = { w->JumpIf(CC_O), index, true };
+            w->StoreReg(in->rd, EAX);
+            break;
+
+        case TK_ADDI:
+            w->LoadReg(EAX, in->rs);
+            w->AluImm(ALU_ADD, EAX, imm);
+            exits[(*numExits)++] = { w->JumpIf(CC_O), index, true };
+            w->StoreReg(in->rt, EAX);
+            break;
+
+        case TK_ADDIU:
+            w->LoadReg(EAX, in->rs);
+            w->AluImm(ALU_ADD, EAX, imm);
+            w->StoreReg(in->rt, EAX);
+            break;
+
+        case TK_ADDU:
+        case TK_SUBU:
+        case TK_AND:
+        case TK_OR:
+        case TK_XOR:
+        case TK_NOR:
+            w->LoadReg(EAX, in->rs);
+            w->LoadReg(ECX, in->rt);
+            w->Alu(op->kind == TK_ADDU ? OPC_ADD
+                   : op->kind == TK_SUBU ? OPC_SUB
+                   : op->kind == TK_AND ? OPC_AND
+                   : op->kind == TK_XOR ? OPC_XOR : OPC_OR, EAX, ECX);
+            if (op->kind == TK_NOR) {
+                w->Not(EAX);
+            }
+            w->StoreReg(in->rd, EAX);
+            break;
+
+        case TK_ANDI:
+        case TK_ORI:
+        case TK_XORI:
+            w->LoadReg(EAX, in->rs);
+            w->AluImm(op->kind == TK_ANDI ? ALU_AND
+                      : op->kind == TK_ORI ? ALU_OR : ALU_XOR,
+                      EAX, imm & 0xFFFF);
+            w->StoreReg(in->rt, EAX);
+            break;
+
+        case TK_LUI:
+            w->StoreRegImm(in->rt, (int) ((unsigned) imm << 16));
+            break;
+
+        // The simulator shifts right arithmetically even for `srl`; so does
+        // the compiled code.
+        case TK_SLL:
+        case TK_SRA:
+        case TK_SRL:
+            w->LoadReg(EAX, in->rt);
+            w->ShiftImm(op->kind == TK_SLL ? SHIFT_SHL : SHIFT_SAR,
+                        EAX, imm & 0x1F);
+            w->StoreReg(in->rd, EAX);
+            break;
+
+        case TK_SLLV:
+        case TK_SRAV:
+        case TK_SRLV:
+            w->LoadReg(ECX, in->rs);
+            w->LoadReg(EAX, in->rt);
+            w->ShiftCl(op->kind == TK_SLLV ? SHIFT_SHL : SHIFT_SAR, EAX);
+            w->StoreReg(in->rd, EAX);
+            break;
+
+        case TK_SLT:
+        case TK_SLTU:
+            w->LoadReg(EAX, in->rs);
+            w->LoadReg(ECX, in->rt);
+            w->Alu(OPC_CMP, EAX, ECX);
+            w->SetCC(op->kind == TK_SLT ? CC_L : CC_B);
+            w->StoreReg(in->rd, EAX);
+            break;
+
+        case TK_SLTI:
+        case TK_SLTIU:
+            w->LoadReg(EAX, in->rs);
+            w->AluImm(ALU_CMP, EAX, imm);
+            w->SetCC(op->kind == TK_SLTI ? CC_L : CC_B);
+            w->StoreReg(in->rt, EAX);
+            break;
+
+        case TK_MFHI:
+        case TK_MFLO:
+            w->LoadReg(EAX, op->kind == TK_MFHI ? HI_REG : LO_REG);
+            w->StoreReg(in->rd, EAX);
+            break;
+
+        case TK_MTHI:
+        case TK_MTLO:
+            w->LoadReg(EAX, in->rs);
+            w->StoreReg(op->kind == TK_MTHI ? HI_REG : LO_REG, EAX);
+            break;
+
+        case TK_MULT:
+        case TK_MULTU:
+        case TK_DIV:
+        case TK_DIVU:
+            w->MovImm(ESI, op->kind);
+            w->LoadReg(EDX, in->rs);
+            w->LoadReg(ECX, in->rt);
+            w->Call((const void *) JitMultiply);
+            break;
+
+        case TK_BEQ:
+        case TK_BNE:
+        case TK_BLEZ:
+        case TK_BGTZ:
+        case TK_BLTZ:
+        case TK_BGEZ:
+            w->LoadReg(EAX, in->rs);
+            if (op->kind == TK_BEQ || op->kind == TK_BNE) {
+                w->LoadReg(ECX, in->rt);
+                w->Alu(OPC_CMP, EAX, ECX);
+            } else {
+                w->AluImm(ALU_CMP, EAX, 0);
+            }
+            cc = op->kind == TK_BEQ ? CC_E : op->kind == TK_BNE ? CC_NE
+                 : op->kind == TK_BLEZ ? CC_LE : op->kind == TK_BGTZ ? CC_G
+                 : op->kind == TK_BLTZ ? CC_L : CC_GE;
+            w->SetTarget(offset + 8);
+            w->SkipIf(cc ^ 1, 8);  // Over the next `SetTarget`.
+            w->SetTarget(offset + 4 + branch);
+            break;
+
+        case TK_JAL:
+        case TK_J:
+            if (op->kind == TK_JAL) {
+                w->BlockAddr(EAX, offset + 8);
+                w->StoreReg(RET_ADDR_REG, EAX);
+            }
+            w->BlockAddr(EAX, offset + 8);
+            w->AluImm(ALU_AND, EAX, (int) 0xF0000000);
+            w->AluImm(ALU_OR, EAX, branch);
+            w->SetTargetFromEax();
+            break;
+
+        case TK_JALR:
+        case TK_JR:
+            if (op->kind == TK_JALR) {
+                w->BlockAddr(EAX, offset + 8);
+                w->StoreReg(in->rd, EAX);
+            }
+            w->LoadReg(EAX, in->rs);
+            w->SetTargetFromEax();
+            break;
+
+        case TK_LB:
+        case TK_LBU:
+        case TK_LH:
+        case TK_LHU:
+        case TK_LW:
+            w->LoadReg(ESI, in->rs);
+            w->AluImm(ALU_ADD, ESI, imm);
+            w->MovImm(EDX, op->kind);
+            w->StoreContextImm(offsetof(JitContext, fetchTarget), index + 1);
+            w->Call((const void *) JitLoad);
+            w->TestEax();
+            exits[(*numExits)++] = { w->JumpIf(CC_NE), index, false };
+            w->LoadContext(EDX, offsetof(JitContext, loaded));
+            break;
+
+        case TK_SB:
+        case TK_SH:
+        case TK_SW:
+            w->LoadReg(ESI, in->rs);
+            w->AluImm(ALU_ADD, ESI, imm);
+            w->LoadReg(EDX, in->rt);
+            w->MovImm(ECX, op->kind == TK_SB ? 1 : op->kind == TK_SH ? 2 : 4);
+            w->StoreContextImm(offsetof(JitContext, fetchTarget), index + 1);
+            w->Call((const void *) JitStore);
+            w->TestEax();
+            exits[(*numExits)++] = { w->JumpIf(CC_NE), index, false };
+            break;
+
+        default:
+            return false;
+    }
+
+    EmitDelayedLoad(w, op, EDX);
+
+    if (op->kind == TK_SB || op->kind == TK_SH || op->kind == TK_SW) {
+        w->TestContextByte(offsetof(JitContext, leave));
+        exits[(*numExits)++] = { w->JumpIf(CC_NE), index + 1, false };
+    }
+    return true;
+}
+
+/// Emit the way out of a block after `completed` operations: set the
+/// program counters as the interpreter would have left them, and return
+/// `completed`.
+///
+/// * `branch` is the index of the branch of the block, or -1.
+static void
+EmitExit(CodeWriter *w, unsigned completed, int branch)
+{
+    if (completed > 0) {
+        int last = completed - 1;
+        int offset = last * 4;
+        w->BlockAddr(EAX, offset);
+        w->StoreReg(PREV_PC_REG, EAX);
+        if (branch < 0 || last < branch) {
+            w->BlockAddr(EAX, offset + 4);
+            w->StoreReg(PC_REG, EAX);
+            w->BlockAddr(EAX, offset + 8);
+            w->StoreReg(NEXT_PC_REG, EAX);
+        } else if (last == branch) {
+            w->BlockAddr(EAX, offset + 4);
+            w->StoreReg(PC_REG, EAX);
+            w->TargetToEax();
+            w->StoreReg(NEXT_PC_REG, EAX);
+        } else {  // In the delay slot.
+            w->TargetToEax();
+            w->StoreReg(PC_REG, EAX);
+            w->AluImm(ALU_ADD, EAX, 4);
+            w->StoreReg(NEXT_PC_REG, EAX);
+        }
+    }
+    w->MovImm(EAX, completed);
+    w->Epilogue();
+}
+
+#endif
+
+/// Compile `block`, unless it cannot be compiled on this host.
+///
+/// Blocks with a branch in the delay slot of another one are not compiled
+/// either; they are too rare to deserve the extra exit states.
+void
+Machine::CompileBlock(ThreadedBlock *block)
+{
+    ASSERT(block != nullptr && block->length > 0);
+
+#ifdef HOST_x86_64
+    int branch = -1;
+    for (unsigned i = 0; i < block->length; i++) {
+        if (IsTransfer(block->ops[i].kind)) {
+            if (branch >= 0) {
+                return;
+            }
+            branch = i;
+        }
+    }
+
+    if (codeCache == nullptr) {
+        void *area = mmap(nullptr, CODE_CACHE_SIZE, PROT_READ | PROT_EXEC,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (area == MAP_FAILED) {
+            DEBUG('m', "Cannot allocate the code cache; not compiling.\n");
+            engine = engine == JIT_ENGINE ? THREADED_ENGINE : engine;
+            return;
+        }
+        codeCache = (unsigned char *) area;
+    }
+    if (CODE_CACHE_SIZE - codeCacheUsed < MAX_NATIVE_SIZE) {
+        // Everything compiled so far is forgotten; blocks will be compiled
+        // again once they get hot.
+        codeCacheUsed = 0;
+        codeGeneration++;
+    }
+
+    unsigned char *start = codeCache + codeCacheUsed;
+    CodeWriter w(start);
+    ExitJump exits[3 * PAGE_SIZE / 4];
+    unsigned numExits = 0;
+
+    ProtectCodeCache(codeCache, true);
+    w.Prologue();
+    for (unsigned i = 0; i < block->length; i++) {
+        if (!EmitOp(&w, &block->ops[i], i, exits, &numExits)) {
+            ProtectCodeCache(codeCache, false);
+            return;
+        }
+    }
+    EmitExit(&w, block->length, branch);
+
+    // Exits are shared by every jump that needs them.
+    unsigned char *exitCode[PAGE_SIZE / 4 + 1];
+    unsigned char *overflowCode[PAGE_SIZE / 4];
+    for (unsigned i = 0; i <= block->length; i++) {
+        exitCode[i] = nullptr;
+        if (i < block->length) {
+            overflowCode[i] = nullptr;
+        }
+    }
+    for (unsigned i = 0; i < numExits; i++) {
+        unsigned k = exits[i].exit;
+        if (exitCode[k] == nullptr) {
+            exitCode[k] = w.pos;
+            EmitExit(&w, k, branch);
+        }
+    }
+    for (unsigned i = 0; i < numExits; i++) {
+        unsigned k = exits[i].exit;
+        if (!exits[i].overflow) {
+            CodeWriter::Patch(exits[i].at, exitCode[k]);
+            continue;
+        }
+        if (overflowCode[k] == nullptr) {
+            overflowCode[k] = w.pos;
+            w.StoreContextImm(offsetof(JitContext, exception),
+                              OVERFLOW_EXCEPTION);
+            w.StoreContextImm(offsetof(JitContext, badVAddr), 0);
+            CodeWriter::Patch(w.Jump(), exitCode[k]);
+        }
+        CodeWriter::Patch(exits[i].at, overflowCode[k]);
+    }
+
+    ProtectCodeCache(codeCache, false);
+
+    unsigned size = w.pos - start;
+    ASSERT(size <= MAX_NATIVE_SIZE);
+    codeCacheUsed += (size + 15) & ~15;
+    block->native = start;
+    block->nativeGeneration = codeGeneration;
+#endif
+}
+
+ExceptionType
+Machine::ExecNative(ThreadedBlock *block, unsigned *badVAddr,
+                    unsigned *executed, SandboxLog *log)
+{
+    ASSERT(IsCompiled(block));
+    ASSERT(badVAddr != nullptr && executed != nullptr);
+
+    JitContext ctx;
+    ctx.registers   = registers;
+    ctx.mmu         = &mmu;
+    ctx.block       = block;
+    ctx.log         = log;
+    ctx.physAddr    = block->physicalAddr;
+    ctx.fetched     = 1;  // The caller fetched the first instruction.
+    ctx.fetchTarget = 1;
+    ctx.exception   = NO_EXCEPTION;
+    ctx.badVAddr    = 0;
+    ctx.loaded      = 0;
+    ctx.leave       = 0;
+
+    *executed = ((NativeCode) block->native)(&ctx);
+
+    // The fetch of an instruction that traps counts as well.
+    ctx.fetchTarget = *executed + (ctx.exception != NO_EXCEPTION ? 1 : 0);
+    AccountFetches(&ctx);
+
+    *badVAddr = ctx.badVAddr;
+    return (ExceptionType) ctx.exception;
+}
@@ -22,6 +22,18 @@
 ///
 /// Called by the kernel when the program starts up; never returns.
 ///
+/// Unless single stepping or tracing instructions, the machine runs whole
+/// blocks at a time when it was built with the threaded engine (see
+/// `mips_threaded.cc`).  Simulated time advances one tick per instruction
+/// either way.
+///
+/// Checking for due interrupts after every instruction is expensive, and
+/// pointless while the next pending one is far away.  So instructions run
+/// in batches up to the next interrupt deadline, and only the last one of
+/// each batch goes through `Interrupt::OneTick`; the ticks of the rest are
+/// charged all at once, when the batch ends or when an exception traps
+/// into the kernel.  The outcome is the same, tick for tick.
+///
 /// This routine is re-entrant, in that it can be called multiple times
 /// concurrently -- one for each thread executing user code.
 void
@@ -31,15 +43,29 @@ Machine::Run()
       // Storage for decoded instruction.
 
     if (debug.IsEnabled('m')) {
-        printf("Starting to run at time %lu\n", stats->totalTicks);
+        printf("Starting to run at time %llu\n", stats->totalTicks);
     }
     interrupt->SetStatus(USER_MODE);
 
+    if (debug.IsEnabled('m')) {
+        engine = INTERPRETER_ENGINE;  // Trace every single instruction.
+    }
+
+    unsigned long long quiet = 0;  // Ticks left until an interrupt may be due.
     for (;;) {
-        if (FetchInstruction(instr)) {
-            ExecInstruction(instr);
+        if (engine != INTERPRETER_ENGINE && singleStepper == nullptr) {
+            RunBlock(instr);
+            continue;
         }
+        bool ok = FetchInstruction(instr) && ExecInstruction(instr);
+        if (ok && quiet >= USER_TICK && singleStepper == nullptr) {
+            quiet -= USER_TICK;
+            pendingTicks += USER_TICK;
+            continue;
+        }
+        ChargeTicks();
         interrupt->OneTick();
+        quiet = interrupt->QuietTicks();
         if (singleStepper != nullptr && !singleStepper->Step()) {
             singleStepper = nullptr;
         }
@@ -64,12 +90,11 @@ Machine::FetchInstruction(Instruction *instr)
 {
     ASSERT(instr != nullptr);
 
-    int raw;
-    if (!ReadMem(registers[PC_REG], 4, &raw)) {
+    ExceptionType e = mmu.FetchInstruction(registers[PC_REG], instr);
+    if (e != NO_EXCEPTION) {
+        RaiseException(e, registers[PC_REG]);
         return false;  // Exception occurred.
     }
-    instr->value = raw;
-    instr->Decode();
 
     if (debug.IsEnabled('m')) {
         const struct OpString *str = &OP_STRINGS[instr->opCode];
@@ -88,7 +113,7 @@ Machine::FetchInstruction(Instruction *instr)
 ///
 /// The words at `*hiPtr` and `*loPtr` are overwritten with the double-length
 /// result of the multiplication.
-static void
+void
 Mult(int a, int b, bool signedArith, int *hiPtr, int *loPtr)
 {
     ASSERT(hiPtr != nullptr);
@@ -171,7 +196,7 @@ Mult(int a, int b, bool signedArith, int *hiPtr, int *loPtr)
 /// all data back to the machine registers and memory before leaving.  This
 /// allows the Nachos kernel to control our behavior by controlling the
 /// contents of memory, the translation table, and the register set.
-void
+bool
 Machine::ExecInstruction(const Instruction *instr)
 {
     int nextLoadReg = 0;
@@ -192,7 +217,7 @@ Machine::ExecInstruction(const Instruction *instr)
             if (!((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT)
                   && (registers[instr->rs] ^ sum) & SIGN_BIT) {
                 RaiseException(OVERFLOW_EXCEPTION, 0);
-                return;
+                return false;
             }
             registers[instr->rd] = sum;
             break;
@@ -202,7 +227,7 @@ Machine::ExecInstruction(const Instruction *instr)
             if (!((registers[instr->rs] ^ instr->extra) & SIGN_BIT)
                   && (instr->extra ^ sum) & SIGN_BIT) {
                 RaiseException(OVERFLOW_EXCEPTION, 0);
-                return;
+                return false;
             }
             registers[instr->rt] = sum;
             break;
@@ -308,7 +333,7 @@ Machine::ExecInstruction(const Instruction *instr)
         case OP_LBU:
             tmp = registers[instr->rs] + instr->extra;
             if (!ReadMem(tmp, 1, &value)) {
-                return;
+                return false;
             }
 
             if (value & 0x80 && instr->opCode == OP_LB) {
@@ -325,10 +350,10 @@ Machine::ExecInstruction(const Instruction *instr)
             tmp = registers[instr->rs] + instr->extra;
             if (tmp & 0x1) {
                 RaiseException(ADDRESS_ERROR_EXCEPTION, tmp);
-                return;
+                return false;
             }
             if (!ReadMem(tmp, 2, &value)) {
-                return;
+                return false;
             }
 
             if (value & 0x8000 && instr->opCode == OP_LH) {
@@ -349,10 +374,10 @@ Machine::ExecInstruction(const Instruction *instr)
             tmp = registers[instr->rs] + instr->extra;
             if (tmp & 0x3) {
                 RaiseException(ADDRESS_ERROR_EXCEPTION, tmp);
-                return;
+                return false;
             }
             if (!ReadMem(tmp, 4, &value)) {
-                return;
+                return false;
             }
             nextLoadReg = instr->rt;
             nextLoadValue = value;
@@ -367,7 +392,7 @@ Machine::ExecInstruction(const Instruction *instr)
             ASSERT((tmp & 0x3) == 0);
 
             if (!ReadMem(tmp, 4, &value)) {
-                return;
+                return false;
             }
             if (registers[LOAD_REG] == instr->rt) {
                 nextLoadValue = registers[LOAD_VALUE_REG];
@@ -400,7 +425,7 @@ Machine::ExecInstruction(const Instruction *instr)
             ASSERT((tmp & 0x3) == 0);
 
             if (!ReadMem(tmp, 4, &value)) {
-                return;
+                return false;
             }
             if (registers[LOAD_REG] == instr->rt) {
                 nextLoadValue = registers[LOAD_VALUE_REG];
@@ -471,14 +496,14 @@ Machine::ExecInstruction(const Instruction *instr)
         case OP_SB:
             if (!WriteMem((unsigned) (registers[instr->rs] + instr->extra),
                           1, registers[instr->rt])) {
-                return;
+                return false;
             }
             break;
 
         case OP_SH:
             if (!WriteMem((unsigned) (registers[instr->rs] + instr->extra),
                           2, registers[instr->rt])) {
-                return;
+                return false;
             }
             break;
 
@@ -539,7 +564,7 @@ Machine::ExecInstruction(const Instruction *instr)
             if ((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT
                   && (registers[instr->rs] ^ diff) & SIGN_BIT) {
                 RaiseException(OVERFLOW_EXCEPTION, 0);
-                return;
+                return false;
             }
             registers[instr->rd] = diff;
             break;
@@ -552,7 +577,7 @@ Machine::ExecInstruction(const Instruction *instr)
         case OP_SW:
             if (!WriteMem((unsigned) (registers[instr->rs] + instr->extra),
                           4, registers[instr->rt])) {
-                return;
+                return false;
             }
             break;
 
@@ -564,7 +589,7 @@ Machine::ExecInstruction(const Instruction *instr)
             ASSERT((tmp & 0x3) == 0);
 
             if (!ReadMem(tmp & ~0x3, 4, &value)) {
-                return;
+                return false;
             }
             switch (tmp & 0x3) {
                 case 0:
@@ -584,7 +609,7 @@ Machine::ExecInstruction(const Instruction *instr)
                     break;
             }
             if (!WriteMem(tmp & ~0x3, 4, value)) {
-                return;
+                return false;
             }
             break;
 
@@ -596,7 +621,7 @@ Machine::ExecInstruction(const Instruction *instr)
             ASSERT((tmp & 0x3) == 0);
 
             if (!ReadMem(tmp & ~0x3, 4, &value)) {
-                return;
+                return false;
             }
             switch (tmp & 0x3) {
                 case 0:
@@ -615,13 +640,13 @@ Machine::ExecInstruction(const Instruction *instr)
                     break;
             }
             if (!WriteMem(tmp & ~0x3, 4, value)) {
-                return;
+                return false;
             }
             break;
 
         case OP_SYSCALL:
             RaiseException(SYSCALL_EXCEPTION, 0);
-            return;
+            return false;
 
         case OP_XOR:
             registers[instr->rd] = registers[instr->rs]
@@ -636,7 +661,7 @@ Machine::ExecInstruction(const Instruction *instr)
         case OP_RES:
         case OP_UNIMP:
             RaiseException(ILLEGAL_INSTR_EXCEPTION, 0);
-            return;
+            return false;
 
         default:
             ASSERT(false);
@@ -652,4 +677,5 @@ Machine::ExecInstruction(const Instruction *instr)
       // For debugging, in case we are jumping into lala-land.
     registers[PC_REG] = registers[NEXT_PC_REG];
     registers[NEXT_PC_REG] = pcAfter;
+    return true;
 }
@@ -0,0 +1,747 @@
+/// Threaded execution engine for the MIPS simulator.
+///
+/// Instead of fetching, decoding and dispatching every instruction through
+/// the `switch` in `ExecInstruction`, straight-line code is translated once
+/// into a `ThreadedBlock`, and then run by `ExecBlock`, where the code of
+/// each operation ends by jumping directly to the code of the next one.
+///
+/// The engine must be indistinguishable from the interpreter: registers,
+/// memory, delayed loads, exceptions, translation statistics and simulated
+/// time all evolve exactly as if every instruction had gone through
+/// `FetchInstruction` and `ExecInstruction`.  Whatever it does not
+/// translate (system calls, unaligned loads and stores, ...) is left to the
+/// interpreter, one instruction at a time.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "machine.hh"
+#include "threads/system.hh"
+
+#include <stdio.h>
+#include <string.h>
+
+
+/// Kinds for pure computations: writing `r0` makes them no-ops.
+static inline ThreadedKind
+Pure(unsigned dest, ThreadedKind kind)
+{
+    return dest == 0 ? TK_NOP : kind;
+}
+
+/// Kinds for computations that may trap: writing `r0` is too rare to be
+/// worth a special case, so it is left to the interpreter.
+static inline ThreadedKind
+Trapping(unsigned dest, ThreadedKind kind)
+{
+    return dest == 0 ? TK_INTERPRET : kind;
+}
+
+/// Pick the threaded operation implementing `instr`.
+///
+/// Besides the obvious restrictions, no operation other than a load may
+/// leave `r0` modified, so that `ExecBlock` does not need to clear it after
+/// every instruction.
+static ThreadedKind
+Classify(const Instruction *instr)
+{
+    switch (instr->opCode) {
+        case OP_ADD:   return Trapping(instr->rd, TK_ADD);
+        case OP_ADDI:  return Trapping(instr->rt, TK_ADDI);
+        case OP_ADDIU:
+            if (instr->rt != 0 && instr->rs == 0) {
+                return TK_LI;
+            }
+            return Pure(instr->rt, TK_ADDIU);
+        case OP_ADDU:
+            if (instr->rd != 0 && instr->rt == 0) {
+                return TK_MOVE;
+            }
+            return Pure(instr->rd, TK_ADDU);
+        case OP_AND:   return Pure(instr->rd, TK_AND);
+        case OP_ANDI:  return Pure(instr->rt, TK_ANDI);
+        case OP_BEQ:   return TK_BEQ;
+        case OP_BGEZ:  return TK_BGEZ;
+        case OP_BGTZ:  return TK_BGTZ;
+        case OP_BLEZ:  return TK_BLEZ;
+        case OP_BLTZ:  return TK_BLTZ;
+        case OP_BNE:   return TK_BNE;
+        case OP_DIV:   return TK_DIV;
+        case OP_DIVU:  return TK_DIVU;
+        case OP_J:     return TK_J;
+        case OP_JAL:   return TK_JAL;
+        case OP_JALR:  return instr->rd == 0 ? TK_JR : TK_JALR;
+        case OP_JR:    return TK_JR;
+        case OP_LB:    return TK_LB;
+        case OP_LBU:   return TK_LBU;
+        case OP_LH:    return TK_LH;
+        case OP_LHU:   return TK_LHU;
+        case OP_LUI:   return Pure(instr->rt, TK_LUI);
+        case OP_LW:    return TK_LW;
+        case OP_MFHI:  return Pure(instr->rd, TK_MFHI);
+        case OP_MFLO:  return Pure(instr->rd, TK_MFLO);
+        case OP_MTHI:  return TK_MTHI;
+        case OP_MTLO:  return TK_MTLO;
+        case OP_MULT:  return TK_MULT;
+        case OP_MULTU: return TK_MULTU;
+        case OP_NOR:   return Pure(instr->rd, TK_NOR);
+        case OP_OR:
+            if (instr->rd != 0 && instr->rt == 0) {
+                return TK_MOVE;
+            }
+            return Pure(instr->rd, TK_OR);
+        case OP_ORI:   return Pure(instr->rt, TK_ORI);
+        case OP_SB:    return TK_SB;
+        case OP_SH:    return TK_SH;
+        case OP_SLL:   return Pure(instr->rd, TK_SLL);
+        case OP_SLLV:  return Pure(instr->rd, TK_SLLV);
+        case OP_SLT:   return Pure(instr->rd, TK_SLT);
+        case OP_SLTI:  return Pure(instr->rt, TK_SLTI);
+        case OP_SLTIU: return Pure(instr->rt, TK_SLTIU);
+        case OP_SLTU:  return Pure(instr->rd, TK_SLTU);
+        case OP_SRA:   return Pure(instr->rd, TK_SRA);
+        case OP_SRAV:  return Pure(instr->rd, TK_SRAV);
+        case OP_SRL:   return Pure(instr->rd, TK_SRL);
+        case OP_SRLV:  return Pure(instr->rd, TK_SRLV);
+        case OP_SUB:   return Trapping(instr->rd, TK_SUB);
+        case OP_SUBU:  return Pure(instr->rd, TK_SUBU);
+        case OP_SW:    return TK_SW;
+        case OP_XOR:   return Pure(instr->rd, TK_XOR);
+        case OP_XORI:  return Pure(instr->rt, TK_XORI);
+        default:       return TK_INTERPRET;
+    }
+}
+
+/// Apply a pending delayed load to a copy of the register file, so that two
+/// copies can be compared regardless of when the load was finished (an
+/// interrupt finishes it early, for example).
+static void
+FinishLoad(int *regs)
+{
+    regs[regs[LOAD_REG]] = regs[LOAD_VALUE_REG];
+    regs[LOAD_REG] = 0;
+    regs[LOAD_VALUE_REG] = 0;
+    regs[0] = 0;
+}
+
+/// Number of times a block has to be entered before it is compiled to host
+/// code.
+static const unsigned JIT_THRESHOLD = 64;
+
+/// Execute user code starting at the current PC, a whole block at a time.
+///
+/// A block is only entered at its first instruction and never in the middle
+/// of a branch delay slot; in any other situation, or when the instruction
+/// at the PC cannot be translated, a single instruction is interpreted.
+///
+/// With the JIT engine, blocks entered often enough are compiled, and their
+/// host code is used whenever no interrupt can become due before the last
+/// instruction of the block, so that ticks can be accounted for once the
+/// block is over.
+/// * `instr` is scratch storage for the interpreter.
+void
+Machine::RunBlock(Instruction *instr)
+{
+    ASSERT(instr != nullptr);
+
+    if ((unsigned) registers[NEXT_PC_REG]
+          != (unsigned) registers[PC_REG] + 4) {
+        if (FetchInstruction(instr)) {
+            ExecInstruction(instr);
+        }
+        interrupt->OneTick();
+        return;
+    }
+
+    unsigned physAddr;
+    ExceptionType e = mmu.TranslateFetch(registers[PC_REG], &physAddr);
+    if (e != NO_EXCEPTION) {
+        RaiseException(e, registers[PC_REG]);
+        interrupt->OneTick();
+        return;
+    }
+
+    ThreadedBlock *block = mmu.FindBlock(physAddr);
+    if (block == nullptr) {
+        block = TranslateBlock(physAddr);
+        mmu.AddBlock(block);
+    }
+
+    if (block->length == 0) {
+        *instr = *mmu.Decoded(physAddr);
+        ExecInstruction(instr);
+        interrupt->OneTick();
+        return;
+    }
+
+    if (engine != THREADED_ENGINE && !IsCompiled(block)
+          && ++block->heat == JIT_THRESHOLD) {
+        block->heat = 0;  // Try again later if it could not be compiled.
+        CompileBlock(block);
+    }
+
+    if (engine == CHECKED_ENGINE) {
+        CheckBlock(block, instr);
+        return;
+    }
+
+    unsigned badVAddr, executed;
+    block->users++;
+    if (IsCompiled(block)
+          && (block->length - 1) * USER_TICK <= interrupt->QuietTicks()) {
+        e = ExecNative(block, &badVAddr, &executed, nullptr);
+        if (e == NO_EXCEPTION) {
+            interrupt->AdvanceQuietly((executed - 1) * USER_TICK);
+            interrupt->OneTick();
+        } else {
+            interrupt->AdvanceQuietly(executed * USER_TICK);
+        }
+    } else {
+        e = ExecBlock<false>(block, &badVAddr, &executed, nullptr);
+    }
+    if (--block->users == 0 && block->dead) {
+        delete block;
+    }
+
+    // Trap only now that the block has been released: the handler may well
+    // never return (the thread may be finished, for example).
+    if (e != NO_EXCEPTION) {
+        RaiseException(e, badVAddr);
+        interrupt->OneTick();
+    }
+}
+
+/// Build the block starting at physical address `physAddr`.
+///
+/// The block extends up to the end of the page, the first instruction that
+/// cannot be translated, or the delay slot of the first branch, whichever
+/// comes first.
+ThreadedBlock *
+Machine::TranslateBlock(unsigned physAddr)
+{
+    ThreadedOp ops[PAGE_SIZE / 4];
+    unsigned pageEnd = (physAddr / PAGE_SIZE + 1) * PAGE_SIZE;
+    unsigned n = 0;
+    bool delaySlot = false;
+
+    for (unsigned addr = physAddr; addr < pageEnd; addr += 4) {
+        const Instruction *instr = mmu.Decoded(addr);
+        ThreadedKind kind = Classify(instr);
+        if (kind == TK_INTERPRET) {
+            break;
+        }
+        ops[n].handler    = nullptr;
+        ops[n].instr      = *instr;
+        ops[n].kind       = kind;
+        ops[n].finishLoad = n == 0 || IsLoad(ops[n - 1].kind);
+        n++;
+        if (delaySlot) {
+            break;
+        }
+        delaySlot = IsTransfer(kind);
+    }
+
+    ThreadedBlock *block = new ThreadedBlock(physAddr, n);
+    for (unsigned i = 0; i < n; i++) {
+        block->ops[i] = ops[i];
+    }
+    return block;
+}
+
+template <bool SANDBOX>
+ExceptionType
+Machine::ExecBlock(ThreadedBlock *block, unsigned *badVAddr,
+                   unsigned *executed, SandboxLog *log)
+{
+    ASSERT(block != nullptr && block->length > 0);
+    ASSERT(badVAddr != nullptr && executed != nullptr);
+    ASSERT(!SANDBOX || log != nullptr);
+
+    // Code for each `ThreadedKind`, in the same order.
+    static const void *const LABELS[NUM_THREADED_KINDS] = {
+        &&DO_NOP, &&DO_LI, &&DO_MOVE,
+        &&DO_ADD, &&DO_ADDI, &&DO_ADDIU, &&DO_ADDU, &&DO_AND, &&DO_ANDI,
+        &&DO_BEQ, &&DO_BGEZ, &&DO_BGTZ, &&DO_BLEZ, &&DO_BLTZ, &&DO_BNE,
+        &&DO_DIV, &&DO_DIVU, &&DO_J, &&DO_JAL, &&DO_JALR, &&DO_JR,
+        &&DO_LB, &&DO_LBU, &&DO_LH, &&DO_LHU, &&DO_LUI, &&DO_LW,
+        &&DO_MFHI, &&DO_MFLO, &&DO_MTHI, &&DO_MTLO, &&DO_MULT, &&DO_MULTU,
+        &&DO_NOR, &&DO_OR, &&DO_ORI, &&DO_SB, &&DO_SH,
+        &&DO_SLL, &&DO_SLLV, &&DO_SLT, &&DO_SLTI, &&DO_SLTIU, &&DO_SLTU,
+        &&DO_SRA, &&DO_SRAV, &&DO_SRL, &&DO_SRLV, &&DO_SUB, &&DO_SUBU,
+        &&DO_SW, &&DO_XOR, &&DO_XORI
+    };
+
+    // Label addresses only exist inside this function, so blocks are
+    // linked lazily.  The sandbox goes through `LABELS` instead, as its
+    // labels are not the same.
+    if (!SANDBOX && !block->linked) {
+        for (unsigned i = 0; i < block->length; i++) {
+            block->ops[i].handler = LABELS[block->ops[i].kind];
+        }
+        block->linked = true;
+    }
+
+#define DISPATCH()  goto *(SANDBOX ? LABELS[op->kind] : op->handler)
+#define TRAP(et, addr)  \
+    do { exception = (et); *badVAddr = (addr); goto leave; } while (0)
+#define RS   registers[op->instr.rs]
+#define RT   registers[op->instr.rt]
+#define RD   registers[op->instr.rd]
+#define IMM  (op->instr.extra)
+
+    const ThreadedOp *op = block->ops;
+    const ThreadedOp *const end = block->ops + block->length;
+    unsigned physAddr = block->physicalAddr;
+    int expectedPC = registers[PC_REG];
+    unsigned done = 0;
+    ExceptionType exception = NO_EXCEPTION;
+    ExceptionType e;
+    int nextLoadReg, nextLoadValue, pcAfter;
+    int sum, diff, tmp, value, old;
+    unsigned rs, rt, imm, storeAddr, storeSize;
+    unsigned long long ticks;
+    unsigned long long quiet = SANDBOX ? 0 : interrupt->QuietTicks();
+
+    DISPATCH();
+
+DO_NOP:
+    goto next;
+
+DO_LI:
+    RT = IMM;
+    goto next;
+
+DO_MOVE:
+    RD = RS;
+    goto next;
+
+DO_ADD:
+    sum = RS + RT;
+    if (!((RS ^ RT) & SIGN_BIT) && (RS ^ sum) & SIGN_BIT) {
+        TRAP(OVERFLOW_EXCEPTION, 0);
+    }
+    RD = sum;
+    goto next;
+
+DO_ADDI:
+    sum = RS + IMM;
+    if (!((RS ^ IMM) & SIGN_BIT) && (IMM ^ sum) & SIGN_BIT) {
+        TRAP(OVERFLOW_EXCEPTION, 0);
+    }
+    RT = sum;
+    goto next;
+
+DO_ADDIU:
+    RT = RS + IMM;
+    goto next;
+
+DO_ADDU:
+    RD = RS + RT;
+    goto next;
+
+DO_AND:
+    RD = RS & RT;
+    goto next;
+
+DO_ANDI:
+    RT = RS & (IMM & 0xFFFF);
+    goto next;
+
+DO_BEQ:
+    if (RS == RT) {
+        goto branch;
+    }
+    goto next;
+
+DO_BGEZ:
+    if (!(RS & SIGN_BIT)) {
+        goto branch;
+    }
+    goto next;
+
+DO_BGTZ:
+    if (RS > 0) {
+        goto branch;
+    }
+    goto next;
+
+DO_BLEZ:
+    if (RS <= 0) {
+        goto branch;
+    }
+    goto next;
+
+DO_BLTZ:
+    if (RS & SIGN_BIT) {
+        goto branch;
+    }
+    goto next;
+
+DO_BNE:
+    if (RS != RT) {
+        goto branch;
+    }
+    goto next;
+
+DO_DIV:
+    if (RT == 0) {
+        registers[LO_REG] = 0;
+        registers[HI_REG] = 0;
+    } else {
+        registers[LO_REG] = RS / RT;
+        registers[HI_REG] = RS % RT;
+    }
+    goto next;
+
+DO_DIVU:
+    rs = (unsigned) RS;
+    rt = (unsigned) RT;
+    if (rt == 0) {
+        registers[LO_REG] = 0;
+        registers[HI_REG] = 0;
+    } else {
+        tmp = rs / rt;
+        registers[LO_REG] = (int) tmp;
+        tmp = rs % rt;
+        registers[HI_REG] = (int) tmp;
+    }
+    goto next;
+
+DO_JAL:
+    registers[RET_ADDR_REG] = registers[NEXT_PC_REG] + 4;
+DO_J:
+    pcAfter = ((registers[NEXT_PC_REG] + 4) & 0xF0000000)
+              | IndexToAddr(IMM);
+    goto next_to;
+
+DO_JALR:
+    RD = registers[NEXT_PC_REG] + 4;
+DO_JR:
+    pcAfter = RS;
+    goto next_to;
+
+DO_LB:
+DO_LBU:
+    tmp = RS + IMM;
+    e = mmu.ReadMem(tmp, 1, &value);
+    if (e != NO_EXCEPTION) {
+        TRAP(e, tmp);
+    }
+    if (value & 0x80 && op->kind == TK_LB) {
+        value |= 0xFFFFFF00;
+    } else {
+        value &= 0xFF;
+    }
+    goto load;
+
+DO_LH:
+DO_LHU:
+    tmp = RS + IMM;
+    if (tmp & 0x1) {
+        TRAP(ADDRESS_ERROR_EXCEPTION, tmp);
+    }
+    e = mmu.ReadMem(tmp, 2, &value);
+    if (e != NO_EXCEPTION) {
+        TRAP(e, tmp);
+    }
+    if (value & 0x8000 && op->kind == TK_LH) {
+        value |= 0xFFFF0000;
+    } else {
+        value &= 0xFFFF;
+    }
+    goto load;
+
+DO_LUI:
+    RT = IMM << 16;
+    goto next;
+
+DO_LW:
+    tmp = RS + IMM;
+    if (tmp & 0x3) {
+        TRAP(ADDRESS_ERROR_EXCEPTION, tmp);
+    }
+    e = mmu.ReadMem(tmp, 4, &value);
+    if (e != NO_EXCEPTION) {
+        TRAP(e, tmp);
+    }
+    goto load;
+
+DO_MFHI:
+    RD = registers[HI_REG];
+    goto next;
+
+DO_MFLO:
+    RD = registers[LO_REG];
+    goto next;
+
+DO_MTHI:
+    registers[HI_REG] = RS;
+    goto next;
+
+DO_MTLO:
+    registers[LO_REG] = RS;
+    goto next;
+
+DO_MULT:
+    Mult(RS, RT, true, &registers[HI_REG], &registers[LO_REG]);
+    goto next;
+
+DO_MULTU:
+    Mult(RS, RT, false, &registers[HI_REG], &registers[LO_REG]);
+    goto next;
+
+DO_NOR:
+    RD = ~(RS | RT);
+    goto next;
+
+DO_OR:
+    RD = RS | RT;
+    goto next;
+
+DO_ORI:
+    RT = RS | (IMM & 0xFFFF);
+    goto next;
+
+DO_SB:
+    storeSize = 1;
+    goto store;
+
+DO_SH:
+    storeSize = 2;
+    goto store;
+
+DO_SW:
+    storeSize = 4;
+    goto store;
+
+DO_SLL:
+    RD = RT << IMM;
+    goto next;
+
+DO_SLLV:
+    RD = RT << (RS & 0x1F);
+    goto next;
+
+DO_SLT:
+    RD = (RS < RT) ? 1 : 0;
+    goto next;
+
+DO_SLTI:
+    RT = (RS < IMM) ? 1 : 0;
+    goto next;
+
+DO_SLTIU:
+    rs = RS;
+    imm = IMM;
+    RT = (rs < imm) ? 1 : 0;
+    goto next;
+
+DO_SLTU:
+    rs = RS;
+    rt = RT;
+    RD = (rs < rt) ? 1 : 0;
+    goto next;
+
+DO_SRA:
+    RD = RT >> IMM;
+    goto next;
+
+DO_SRAV:
+    RD = RT >> (RS & 0x1F);
+    goto next;
+
+DO_SRL:
+    tmp = RT;
+    tmp >>= IMM;
+    RD = tmp;
+    goto next;
+
+DO_SRLV:
+    tmp = RT;
+    tmp >>= RS & 0x1F;
+    RD = tmp;
+    goto next;
+
+DO_SUB:
+    diff = RS - RT;
+    if ((RS ^ RT) & SIGN_BIT && (RS ^ diff) & SIGN_BIT) {
+        TRAP(OVERFLOW_EXCEPTION, 0);
+    }
+    RD = diff;
+    goto next;
+
+DO_SUBU:
+    RD = RS - RT;
+    goto next;
+
+DO_XOR:
+    RD = RS ^ RT;
+    goto next;
+
+DO_XORI:
+    RT = RS ^ (IMM & 0xFFFF);
+    goto next;
+
+store:
+    storeAddr = (unsigned) (RS + IMM);
+    if (SANDBOX) {
+        e = mmu.ReadMem(storeAddr & ~0x3, 4, &old);
+        if (e != NO_EXCEPTION) {
+            TRAP(e, storeAddr);
+        }
+    }
+    e = mmu.WriteMem(storeAddr, storeSize, RT);
+    if (e != NO_EXCEPTION) {
+        TRAP(e, storeAddr);
+    }
+    if (SANDBOX) {
+        log->addr[log->count] = storeAddr & ~0x3;
+        log->value[log->count] = old;
+        log->count++;
+    }
+    goto next;
+
+branch:
+    pcAfter = registers[NEXT_PC_REG] + IndexToAddr(IMM);
+    goto next_to;
+
+load:
+    nextLoadReg = op->instr.rt;
+    nextLoadValue = value;
+    pcAfter = registers[NEXT_PC_REG] + 4;
+    DelayedLoad(nextLoadReg, nextLoadValue);
+    goto retire;
+
+next:
+    pcAfter = registers[NEXT_PC_REG] + 4;
+next_to:
+    // Without a load right before, there is nothing pending to finish.
+    if (op->finishLoad) {
+        DelayedLoad(0, 0);
+    }
+
+retire:
+    registers[PREV_PC_REG] = registers[PC_REG];
+    registers[PC_REG] = registers[NEXT_PC_REG];
+    registers[NEXT_PC_REG] = pcAfter;
+    done++;
+
+    if (!SANDBOX) {
+        if (quiet >= USER_TICK) {
+            quiet -= USER_TICK;
+            pendingTicks += USER_TICK;
+        } else {
+            // If time jumps, other threads ran, and the page holding the
+            // block may no longer be mapped at the same address.
+            ChargeTicks();
+            ticks = stats->totalTicks;
+            interrupt->OneTick();
+            if (stats->totalTicks != ticks + USER_TICK) {
+                goto leave;
+            }
+            quiet = interrupt->QuietTicks();
+        }
+    }
+
+    op++;
+    expectedPC += 4;
+    physAddr += 4;
+    if (op == end || block->dead || registers[PC_REG] != expectedPC) {
+        goto leave;
+    }
+    if (!SANDBOX) {
+        mmu.RepeatFetch(physAddr);
+    }
+    DISPATCH();
+
+leave:
+    if (!SANDBOX) {
+        ChargeTicks();
+    }
+    *executed = done;
+    return exception;
+
+#undef DISPATCH
+#undef TRAP
+#undef RS
+#undef RT
+#undef RD
+#undef IMM
+}
+
+/// Check the threaded engine, or the host code once the block is compiled,
+/// against the interpreter on `block`.
+///
+/// The block is first run in a sandbox; then memory and registers are put
+/// back, and the interpreter executes the same number of instructions for
+/// real.  Any difference in the resulting registers (other than the ones
+/// that do not survive an exception) stops Nachos.
+///
+/// Statistics and page traces are not meaningful in this mode, as every
+/// access of the sandboxed run is translated twice.
+void
+Machine::CheckBlock(ThreadedBlock *block, Instruction *instr)
+{
+    ASSERT(block != nullptr);
+    ASSERT(instr != nullptr);
+
+    int before[NUM_TOTAL_REGS];
+    int threaded[NUM_TOTAL_REGS];
+    SandboxLog log;
+    unsigned badVAddr, executed;
+
+    memcpy(before, registers, sizeof before);
+    log.count = 0;
+    block->users++;
+    if (IsCompiled(block)) {
+        ExecNative(block, &badVAddr, &executed, &log);
+    } else {
+        ExecBlock<true>(block, &badVAddr, &executed, &log);
+    }
+    memcpy(threaded, registers, sizeof threaded);
+
+    for (unsigned i = log.count; i-- > 0;) {
+        mmu.WriteMem(log.addr[i], 4, log.value[i]);
+    }
+    memcpy(registers, before, sizeof registers);
+
+    // Run at least one instruction, even when the very first operation of
+    // the block traps.
+    unsigned completed = 0;
+    do {
+        if (FetchInstruction(instr) && ExecInstruction(instr)) {
+            completed++;
+        }
+        interrupt->OneTick();
+    } while (completed < executed);
+
+    if (executed > 0) {
+        int interpreted[NUM_TOTAL_REGS];
+        memcpy(interpreted, registers, sizeof interpreted);
+        FinishLoad(threaded);
+        FinishLoad(interpreted);
+
+        bool same = true;
+        for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
+            if (i != BAD_VADDR_REG && threaded[i] != interpreted[i]) {
+                if (same) {
+                    fprintf(stderr, "Engines disagree after %u instructions"
+                                    " of the %s block at 0x%X:\n",
+                            executed,
+                            IsCompiled(block) ? "compiled" : "threaded",
+                            block->physicalAddr);
+                    same = false;
+                }
+                fprintf(stderr, "\tr%u: threaded 0x%X, interpreter 0x%X\n",
+                        i, threaded[i], interpreted[i]);
+            }
+        }
+        ASSERT(same);
+    }
+
+    if (--block->users == 0 && block->dead) {
+        delete block;
+    }
+}
@@ -35,19 +35,46 @@
 #include <stdio.h>
 
 
-MMU::MMU()
+MMU::MMU(unsigned physPages, unsigned tlbEntries)
 {
-    mainMemory = new char [MEMORY_SIZE];
-    for (unsigned i = 0; i < MEMORY_SIZE; i++) {
+    ASSERT(physPages > 0);
+
+    numPhysPages = physPages;
+    tlbSize = tlbEntries;
+    mainMemory = new char [GetMemorySize()];
+    for (unsigned i = 0; i < GetMemorySize(); i++) {
         mainMemory[i] = 0;
     }
 
+    decoded = new Instruction [GetMemorySize() / 4];
+    decodedValid = new bool [GetMemorySize() / 4];
+    for (unsigned i = 0; i < GetMemorySize() / 4; i++) {
+        decodedValid[i] = false;
+    }
+    frameDecoded = new bool [numPhysPages];
+    for (unsigned i = 0; i < numPhysPages; i++) {
+        frameDecoded[i] = false;
+    }
+
+    blocks = new ThreadedBlock * [GetMemorySize() / 4];
+    for (unsigned i = 0; i < GetMemorySize() / 4; i++) {
+        blocks[i] = nullptr;
+    }
+    frameBlocks = new ThreadedBlock * [numPhysPages];
+    for (unsigned i = 0; i < numPhysPages; i++) {
+        frameBlocks[i] = nullptr;
+    }
+
+    ForgetTranslations();
+
 #ifdef USE_TLB
-    tlb = new TranslationEntry[TLB_SIZE];
-    for (unsigned i = 0; i < TLB_SIZE; i++) {
+    ASSERT(tlbSize > 0);
+    tlb = new TranslationEntry[tlbSize];
+    for (unsigned i = 0; i < tlbSize; i++) {
         tlb[i].valid = false;
     }
     pageTable = nullptr;
+    currentAsid = 0;
 #else  // Use linear page table.
     tlb = nullptr;
     pageTable = nullptr;
@@ -57,6 +84,14 @@ MMU::MMU()
 MMU::~MMU()
 {
     delete [] mainMemory;
+    delete [] decoded;
+    delete [] decodedValid;
+    delete [] frameDecoded;
+    for (unsigned i = 0; i < numPhysPages; i++) {
+        DropBlocks(i, -1);
+    }
+    delete [] blocks;
+    delete [] frameBlocks;
     if (tlb != nullptr) {
         delete [] tlb;
     }
@@ -66,11 +101,12 @@ void
 MMU::PrintTLB() const
 {
 #ifdef USE_TLB
-    printf("TLB content (%u entries):\n", TLB_SIZE);
-    for (unsigned i = 0; i < TLB_SIZE; i++) {
+    printf("TLB content (%u entries):\n", tlbSize);
+    for (unsigned i = 0; i < tlbSize; i++) {
         const TranslationEntry *e = &tlb[i];
-        printf("(%u) valid: %d, virt: %d, frame: %d, flags: %s%s%s\n",
-               i, e->valid, e->virtualPage, e->physicalPage,
+        printf("(%u) valid: %d, asid: %u, virt: %d, frame: %d, "
+               "flags: %s%s%s\n",
+               i, e->valid, e->asid, e->virtualPage, e->physicalPage,
                (e->readOnly) ? "readonly " : "",
                (e->use)      ? "use " : "",
                (e->dirty)    ? "dirty" : "");
@@ -97,7 +133,8 @@ MMU::ReadMem(unsigned addr, unsigned size, int *value)
     DEBUG('a', "Reading VA 0x%X, size %u\n", addr, size);
 
     unsigned physicalAddress;
-    ExceptionType e = Translate(addr, &physicalAddress, size, false);
+    ExceptionType e = Translate(addr, &physicalAddress, size, false,
+                                &dataCache);
     if (e != NO_EXCEPTION) {
         return e;
     }
@@ -142,7 +179,8 @@ MMU::WriteMem(unsigned addr, unsigned size, int value)
     DEBUG('a', "Writing VA 0x%X, size %u, value 0x%X\n", addr, size, value);
 
     unsigned physicalAddress;
-    ExceptionType e = Translate(addr, &physicalAddress, size, true);
+    ExceptionType e = Translate(addr, &physicalAddress, size, true,
+                                &dataCache);
     if (e != NO_EXCEPTION) {
         return e;
     }
@@ -167,9 +205,147 @@ MMU::WriteMem(unsigned addr, unsigned size, int value)
             ASSERT(false);
     }
 
+    // Self-modifying code: drop the stale decoding of the written word, and
+    // any block that was built from it.
+    unsigned frame = physicalAddress / PAGE_SIZE;
+    if (frameDecoded[frame]) {
+        decodedValid[physicalAddress / 4] = false;
+        if (frameBlocks[frame] != nullptr) {
+            DropBlocks(frame, physicalAddress & ~0x3);
+        }
+    }
+
+    return NO_EXCEPTION;
+}
+
+/// Fetch the instruction at `addr` and leave its decoded form in `instr`.
+///
+/// Returns the exception raised by the translation, if any.
+///
+/// * `addr` is the virtual address of the instruction.
+/// * `instr` is the place to write the decoded instruction.
+ExceptionType
+MMU::FetchInstruction(unsigned addr, Instruction *instr)
+{
+    ASSERT(instr != nullptr);
+
+    DEBUG('a', "Fetching VA 0x%X\n", addr);
+
+    unsigned physicalAddress;
+    ExceptionType e = Translate(addr, &physicalAddress, 4, false,
+                                &fetchCache);
+    if (e != NO_EXCEPTION) {
+        return e;
+    }
+
+    *instr = *Decoded(physicalAddress);
     return NO_EXCEPTION;
 }
 
+ExceptionType
+MMU::TranslateFetch(unsigned addr, unsigned *physAddr)
+{
+    DEBUG('a', "Fetching VA 0x%X\n", addr);
+
+    return Translate(addr, physAddr, 4, false, &fetchCache);
+}
+
+void
+MMU::RepeatFetch(unsigned physAddr, unsigned count)
+{
+    if (tlb != nullptr) {
+        stats->numPageHits += count;
+        TlbUsed(fetchCache.entry, false, count);
+    }
+#ifdef SWAP
+    coreMap->Touch(physAddr / PAGE_SIZE);
+#endif
+    if (pageTrace != nullptr) {
+        pageTrace->Reference(fetchCache.vpn, PAGE_TRACE_FETCH, count);
+    }
+}
+
+const Instruction *
+MMU::Decoded(unsigned physAddr)
+{
+    ASSERT(physAddr < GetMemorySize() && (physAddr & 0x3) == 0);
+
+    unsigned slot = physAddr / 4;
+    if (!decodedValid[slot]) {
+        Instruction *fresh = &decoded[slot];
+        fresh->value = WordToHost(*(unsigned *) &mainMemory[physAddr]);
+        fresh->Decode();
+        decodedValid[slot] = true;
+        frameDecoded[physAddr / PAGE_SIZE] = true;
+    }
+    return &decoded[slot];
+}
+
+ThreadedBlock *
+MMU::FindBlock(unsigned physAddr) const
+{
+    return blocks[physAddr / 4];
+}
+
+void
+MMU::AddBlock(ThreadedBlock *block)
+{
+    ASSERT(block != nullptr);
+
+    unsigned frame = block->physicalAddr / PAGE_SIZE;
+    ASSERT(blocks[block->physicalAddr / 4] == nullptr);
+    ASSERT(frameDecoded[frame]);
+
+    blocks[block->physicalAddr / 4] = block;
+    block->nextInFrame = frameBlocks[frame];
+    frameBlocks[frame] = block;
+}
+
+void
+MMU::DropBlocks(unsigned frame, int physAddr)
+{
+    ThreadedBlock **link = &frameBlocks[frame];
+    while (*link != nullptr) {
+        ThreadedBlock *b = *link;
+        if (physAddr >= 0 && !b->Covers(physAddr)) {
+            link = &b->nextInFrame;
+            continue;
+        }
+        *link = b->nextInFrame;
+        blocks[b->physicalAddr / 4] = nullptr;
+        DEBUG('m', "Dropping block at 0x%X, %u instructions\n",
+              b->physicalAddr, b->length);
+        if (b->users == 0) {
+            delete b;
+        } else {
+            b->dead = true;  // The engine deletes it when it leaves.
+        }
+    }
+}
+
+void
+MMU::InvalidateDecoded(unsigned frame)
+{
+    ASSERT(frame < numPhysPages);
+
+    if (!frameDecoded[frame]) {
+        return;
+    }
+    const unsigned first = frame * PAGE_SIZE / 4;
+    for (unsigned i = first; i < first + PAGE_SIZE / 4; i++) {
+        decodedValid[i] = false;
+    }
+    frameDecoded[frame] = false;
+    DropBlocks(frame, -1);
+}
+
+void
+MMU::ForgetTranslations()
+{
+    fetchCache.entry = nullptr;
+    dataCache.entry  = nullptr;
+}
+
 ExceptionType
 MMU::RetrievePageEntry(unsigned vpn, TranslationEntry **entry) const
 {
@@ -178,28 +354,29 @@ MMU::RetrievePageEntry(unsigned vpn, TranslationEntry **entry) const
     if (tlb == nullptr) {
         // Use a page table; `vpn` is an index in the table.
 
-        if (vpn >= pageTableSize) {
+        if (vpn >= pageTable->GetSize()) {
             DEBUG_CONT('a', "virtual page # %u too large for"
                             " page table size %u!\n",
-                       vpn, pageTableSize);
+                       vpn, pageTable->GetSize());
             return ADDRESS_ERROR_EXCEPTION;
-        } else if (!pageTable[vpn].valid) {
-            DEBUG_CONT('a', "virtual page # %u too large for"
-                            " page table size %u!\n",
-                       vpn, pageTableSize);
+        }
+        TranslationEntry *e = pageTable->Find(vpn);
+        if (e == nullptr || !e->valid) {
+            DEBUG_CONT('a', "virtual page # %u not mapped!\n", vpn);
             return PAGE_FAULT_EXCEPTION;
         }
 
-        *entry = &pageTable[vpn];
+        *entry = e;
         return NO_EXCEPTION;
 
     } else {
         // Use the TLB.
 
         unsigned i;
-        for (i = 0; i < TLB_SIZE; i++) {
+        for (i = 0; i < tlbSize; i++) {
             TranslationEntry *e = &tlb[i];
-            if (e->valid && e->virtualPage == vpn) {
+            if (e->valid && e->virtualPage == vpn
+                  && e->asid == currentAsid) {
                 *entry = e;  // FOUND!
                 stats->numPageHits++;
                 return NO_EXCEPTION;
@@ -227,11 +404,49 @@ MMU::RetrievePageEntry(unsigned vpn, TranslationEntry **entry) const
 /// * `physAddr" is the place to store the physical address.
 /// * `size" is the amount of memory being read or written.
 /// * `writing` -- if true, check the “read-only” bit in the TLB.
+/// * `cache` is the last translation used for this kind of access.
+///
+/// When the entry in `cache` still maps the same virtual page, it is used
+/// directly, with exactly the same effects as finding it again: the hit is
+/// counted and the use and dirty bits are set.  Anything unusual (a bad
+/// alignment, a write to a read-only page, or tracing with the `a` debug
+/// flag) goes the long way.  The kernel never loads two TLB entries for the
+/// same page of one address space, so the cached entry, if tagged with the
+/// current ASID, is the one a search would find.
 ExceptionType
 MMU::Translate(unsigned virtAddr, unsigned *physAddr,
-               unsigned size, bool writing)
+               unsigned size, bool writing, TranslationCache *cache)
 {
     ASSERT(physAddr != nullptr);
+    ASSERT(cache != nullptr);
+
+    unsigned vpn = virtAddr / PAGE_SIZE;
+    TranslationEntry *cached = cache->entry;
+    if (cached != nullptr && cache->vpn == vpn
+          && (tlb != nullptr ? cached->asid == currentAsid
+                             : vpn < pageTable->GetSize())
+          && cached->valid && cached->virtualPage == vpn
+          && !(writing && cached->readOnly)
+          && cached->physicalPage < numPhysPages
+          && (virtAddr & (size - 1)) == 0 && !debug.IsEnabled('a')) {
+        if (tlb != nullptr) {
+            stats->numPageHits++;
+            TlbUsed(cached, writing);
+        }
+        cached->use = true;
+        if (writing) {
+            cached->dirty = true;
+        }
+        *physAddr = cached->physicalPage * PAGE_SIZE + virtAddr % PAGE_SIZE;
+#ifdef SWAP
+        coreMap->Touch(cached->physicalPage, writing);
+#endif
+        if (pageTrace != nullptr) {
+            TraceReference(vpn, writing, cache);
+        }
+        return NO_EXCEPTION;
+    }
+
     // We must have either a TLB or a page table, but not both!
     ASSERT((tlb == nullptr) != (pageTable == nullptr));
 
@@ -244,9 +459,7 @@ MMU::Translate(unsigned virtAddr, unsigned *physAddr,
         return ADDRESS_ERROR_EXCEPTION;
     }
 
-    // Calculate the virtual page number, and offset within the page,
-    // from the virtual address.
-    unsigned vpn    = (unsigned) virtAddr / PAGE_SIZE;
+    // Calculate the offset within the page from the virtual address.
     unsigned offset = (unsigned) virtAddr % PAGE_SIZE;
 
     TranslationEntry *entry;
@@ -265,8 +478,8 @@ MMU::Translate(unsigned virtAddr, unsigned *physAddr,
 
     // If the `pageFrame` is too big, there is something really wrong!  An
     // invalid translation was loaded into the page table or TLB.
-    if (pageFrame >= NUM_PHYS_PAGES) {
-        DEBUG_CONT('a', "frame %u > %u!\n", pageFrame, NUM_PHYS_PAGES);
+    if (pageFrame >= numPhysPages) {
+        DEBUG_CONT('a', "frame %u > %u!\n", pageFrame, numPhysPages);
         return BUS_ERROR_EXCEPTION;
     }
 
@@ -278,12 +491,43 @@ MMU::Translate(unsigned virtAddr, unsigned *physAddr,
     }
 
     *physAddr = pageFrame * PAGE_SIZE + offset;
-    ASSERT(*physAddr >= 0 && *physAddr + size <= MEMORY_SIZE);
+    ASSERT(*physAddr >= 0 && *physAddr + size <= GetMemorySize());
     DEBUG_CONT('a', "physical address 0x%X\n", *physAddr);
 
-#ifdef USE_LRU
-    coreMap->UpdateTimers(pageFrame);
+    cache->vpn   = vpn;
+    cache->entry = entry;
+
+    if (tlb != nullptr) {
+        TlbUsed(entry, writing);
+    }
+#ifdef SWAP
+    coreMap->Touch(pageFrame, writing);
 #endif
+    if (pageTrace != nullptr) {
+        TraceReference(vpn, writing, cache);
+    }
 
     return NO_EXCEPTION;
 }
+
+void
+MMU::TraceReference(unsigned vpn, bool writing,
+                    const TranslationCache *cache) const
+{
+    unsigned kind = cache == &fetchCache ? PAGE_TRACE_FETCH
+                  : writing              ? PAGE_TRACE_WRITE
+                                         : PAGE_TRACE_READ;
+    pageTrace->Reference(vpn, kind);
+}
+
+void
+MMU::TlbUsed(const TranslationEntry *entry, bool writing,
+             unsigned count) const
+{
+#ifdef USE_TLB
+    tlbPolicy->Touch(entry - tlb);
+    if (tlbSweep != nullptr) {
+        tlbSweep->Access(currentAsid, entry->virtualPage, writing, count);
+    }
+#endif
+}
@@ -10,6 +10,8 @@
 
 #include "exception_type.hh"
 #include "disk.hh"
+#include "instruction.hh"
+#include "threaded_block.hh"
 #include "translation_entry.hh"
 
 /// Definitions related to the size, and format of user memory.
@@ -17,20 +19,38 @@
 const unsigned PAGE_SIZE = SECTOR_SIZE;  ///< Set the page size equal to the
                                          ///< disk sector size, for
                                          ///< simplicity.
-const unsigned NUM_PHYS_PAGES = 8;
-const unsigned MEMORY_SIZE = NUM_PHYS_PAGES * PAGE_SIZE;
 
-/// Number of entries in the TLB, if one is present.
+/// Number of physical pages, unless given on the command line.
+const unsigned DEFAULT_NUM_PHYS_PAGES = 8;
+
+/// Number of entries in the TLB, if one is present, unless given on the
+/// command line.
 ///
 /// If there is a TLB, it will be small compared to page tables.
-const unsigned TLB_SIZE = 4;
+const unsigned DEFAULT_TLB_SIZE = 4;
+
+/// Number of address space identifiers that TLB entries can be tagged with.
+const unsigned NUM_ASIDS = 64;
+
+/// The last translation used by the MMU for one kind of access.
+///
+/// This is host-side state, invisible to the simulated machine: it only
+/// remembers which entry of the TLB or page table matched last.  The entry
+/// itself is read again on every access, so whatever the kernel writes to
+/// the TLB or to the page table is seen right away; but the kernel must
+/// call `MMU::ForgetTranslations` before it switches or frees a page table.
+struct TranslationCache {
+    unsigned vpn;
+    TranslationEntry *entry;  ///< Null if nothing is cached.
+};
 
 /// This class simulates an MMU (memory management unit) that can use either
 /// page tables or a TLB.
 class MMU {
 public:
-    // Initialize the MMU subsystem.
-    MMU();
+    /// Initialize the MMU subsystem, with `numPhysPages` pages of memory
+    /// and, if there is a TLB, `tlbSize` entries in it.
+    MMU(unsigned numPhysPages, unsigned tlbSize);
 
     // Deallocate data structures.
     ~MMU();
@@ -42,8 +62,66 @@ public:
 
     ExceptionType WriteMem(unsigned addr, unsigned size, int value);
 
+    /// Fetch and decode the instruction at virtual address `addr`.
+    ///
+    /// The address is translated exactly as `ReadMem` would do it, but the
+    /// decoding is cached per physical word, so that a loop body is only
+    /// decoded the first time it runs.
+    ExceptionType FetchInstruction(unsigned addr, Instruction *instr);
+
+    /// Forget every decoded instruction cached for physical page `frame`.
+    ///
+    /// Writes done through `WriteMem` are tracked automatically, but the
+    /// kernel must call this whenever it fills a frame directly through
+    /// `mainMemory` (loading a page from the executable or from swap).
+    void InvalidateDecoded(unsigned frame);
+
+    /// Forget the last translations used, as they may point into the page
+    /// table.  The kernel must call this whenever it changes `pageTable`,
+    /// and before it deletes a page table.
+    void ForgetTranslations();
+
+    /// Routines used by the threaded execution engine.
+
+    /// Translate the address of an instruction fetch, with the same side
+    /// effects as `FetchInstruction`, but without decoding anything.
+    ExceptionType TranslateFetch(unsigned addr, unsigned *physAddr);
+
+    /// Account for `count` more fetches from the same page as the last
+    /// `TranslateFetch`, which is known to still be mapped.
+    ///
+    /// Keeps hit counts and replacement state identical to what fetching
+    /// every instruction separately would produce.
+    void RepeatFetch(unsigned physAddr, unsigned count = 1);
+
+    /// Return the decoded form of the word at physical address `physAddr`.
+    const Instruction *Decoded(unsigned physAddr);
+
+    /// Return the block starting at physical address `physAddr`, or null.
+    ThreadedBlock *FindBlock(unsigned physAddr) const;
+
+    /// Take ownership of `block`, indexing it by its first address.
+    void AddBlock(ThreadedBlock *block);
+
     void PrintTLB() const;
 
+    unsigned GetNumPhysPages() const
+    {
+        return numPhysPages;
+    }
+
+    /// Size of `mainMemory`, in bytes.
+    unsigned GetMemorySize() const
+    {
+        return numPhysPages * PAGE_SIZE;
+    }
+
+    /// Number of entries of `tlb`.
+    unsigned GetTlbSize() const
+    {
+        return tlbSize;
+    }
+
     /// Data structures -- all of these are accessible to Nachos kernel code.
     /// “Public” for convenience.
     ///
@@ -57,11 +135,11 @@ public:
     /// NOTE: the hardware translation of virtual addresses in the user
     /// program to physical addresses (relative to the beginning of
     /// `mainMemory`) can be controlled by one of:
-    /// * a traditional linear page table;
+    /// * a two-level page table, walked by the hardware;
     /// * a software-loaded translation lookaside buffer (tlb) -- a cache of
     ///   mappings of virtual page #'s to physical page #'s.
     ///
-    /// If `tlb` is null, the linear page table is used.
+    /// If `tlb` is null, the page table is used.
     /// If `tlb` is non-null, the Nachos kernel is responsible for managing
     /// the contents of the TLB.  But the kernel can use any data structure
     /// it wants (eg, segmented paging) for handling TLB cache misses.
@@ -76,11 +154,17 @@ public:
     TranslationEntry *tlb;  ///< This pointer should be considered
                             ///< “read-only” to Nachos kernel code.
 
-    TranslationEntry *pageTable;
-    unsigned pageTableSize;
+    PageTable *pageTable;
+
+    /// Identifier of the running address space: only TLB entries tagged
+    /// with it are used.  Set by the kernel on every context switch.
+    unsigned currentAsid;
 
 private:
 
+    unsigned numPhysPages;
+    unsigned tlbSize;
+
     /// Retrieve a page entry either from a page table or the TLB.
     ExceptionType RetrievePageEntry(unsigned vpn,
                                     TranslationEntry **entry) const;
@@ -90,8 +174,46 @@ private:
     /// Set the use and dirty bits in the translation entry appropriately,
     /// and return an exception code if the translation could not be
     /// completed.
+    ///
+    /// `cache` remembers the last entry used, so that accesses to the same
+    /// page skip the lookup.
     ExceptionType Translate(unsigned virtAddr, unsigned *physAddr,
-                            unsigned size, bool writing);
+                            unsigned size, bool writing,
+                            TranslationCache *cache);
+
+    /// Tell the TLB replacement policy, and the TLB sweep if there is one,
+    /// that TLB entry `entry` was used `count` times.
+    void TlbUsed(const TranslationEntry *entry, bool writing,
+                 unsigned count = 1) const;
+
+    /// Record a reference to page `vpn` in the page trace, of the kind that
+    /// `cache` is kept for.
+    void TraceReference(unsigned vpn, bool writing,
+                        const TranslationCache *cache) const;
+
+    /// Last translations, for instruction fetches and for data accesses.
+    TranslationCache fetchCache;
+    TranslationCache dataCache;
+
+    /// Decoded instruction cache, one slot per word of `mainMemory`.
+    Instruction *decoded;
+
+    /// Whether each slot of `decoded` holds the current word.
+    bool *decodedValid;
+
+    /// Whether a frame has any valid slot, so that writes to pages that
+    /// were never executed do not need to touch `decodedValid`.
+    bool *frameDecoded;
+
+    /// Drop the blocks of `frame` built from the word at `physAddr`, or
+    /// every block of the frame if `physAddr` is negative.
+    void DropBlocks(unsigned frame, int physAddr);
+
+    /// Translated blocks, indexed by the word where they start.
+    ThreadedBlock **blocks;
+
+    /// List of blocks of each frame, linked through `nextInFrame`.
+    ThreadedBlock **frameBlocks;
 };
 
 #endif
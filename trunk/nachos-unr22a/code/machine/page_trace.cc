@@ -0,0 +1,80 @@
+/// Copyright (c) 2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "page_trace.hh"
+#include "endianness.hh"
+#include "mmu.hh"
+#include "lib/assert.hh"
+
+
+PageTrace::PageTrace(const char *name)
+{
+    ASSERT(name != nullptr);
+
+    file = fopen(name, "wb");
+    if (file == nullptr) {
+        fprintf(stderr, "ERROR: file `%s` could not be opened.\n", name);
+        ASSERT(false);
+    }
+    fileName = name;
+
+    pageTraceHeader header;
+    header.magic    = WordToMachine(PAGE_TRACE_MAGIC);
+    header.version  = WordToMachine(PAGE_TRACE_VERSION);
+    header.pageSize = WordToMachine(PAGE_SIZE);
+    size_t written = fwrite(&header, sizeof header, 1, file);
+    ASSERT(written == 1);
+
+    numBuffered = 0;
+    last = nullptr;
+    current = 0;
+    numReferences = 0;
+    numRecords = 0;
+}
+
+PageTrace::~PageTrace()
+{
+    Flush();
+    fclose(file);
+}
+
+void
+PageTrace::Print() const
+{
+    printf("Page trace: %lu references in %lu records, written to `%s`\n",
+           numReferences, numRecords, fileName);
+}
+
+void
+PageTrace::Append(unsigned space, unsigned vpn, unsigned kind,
+                  unsigned count)
+{
+    if (numBuffered == BUFFER_SIZE) {
+        Flush();
+    }
+    last = &buffer[numBuffered++];
+    last->space = space;
+    last->vpn = vpn;
+    last->countAndKind = count << PAGE_TRACE_KIND_BITS | kind;
+    numRecords++;
+    if (kind == PAGE_TRACE_END) {
+        last = nullptr;
+    }
+}
+
+void
+PageTrace::Flush()
+{
+    // Records are kept in host order while they may still grow.
+    for (unsigned i = 0; i < numBuffered; i++) {
+        buffer[i].space        = WordToMachine(buffer[i].space);
+        buffer[i].vpn          = WordToMachine(buffer[i].vpn);
+        buffer[i].countAndKind = WordToMachine(buffer[i].countAndKind);
+    }
+    size_t written = fwrite(buffer, sizeof *buffer, numBuffered, file);
+    ASSERT(written == numBuffered);
+    numBuffered = 0;
+    last = nullptr;
+}
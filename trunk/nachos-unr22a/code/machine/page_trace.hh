@@ -0,0 +1,89 @@
+/// A trace of the pages referenced by user programs.
+///
+/// Every translation done by the MMU is recorded, with the process that
+/// made it, the virtual page and whether it was an instruction fetch, a
+/// load or a store.  The trace is written to a host file in the format of
+/// `bin/page_trace.h`, and can be replayed by `bin/pagesim` against other
+/// replacement policies and memory sizes without running Nachos again.
+///
+/// Consecutive references of one kind to one page are merged into a single
+/// record, and records are written in batches, so tracing costs a compare
+/// per reference most of the time.
+///
+/// Copyright (c) 2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_MACHINE_PAGETRACE__HH
+#define NACHOS_MACHINE_PAGETRACE__HH
+
+
+#include "bin/page_trace.h"
+
+#include <stdio.h>
+
+
+class PageTrace {
+public:
+
+    /// Start a trace in the host file `name`.
+    PageTrace(const char *name);
+
+    /// Write what is left of the trace and close the file.
+    ~PageTrace();
+
+    /// References from now on are made by the process `space`.
+    void SetSpace(unsigned space)
+    {
+        current = space;
+    }
+
+    /// Page `vpn` was referenced `count` times in a row, in the way given
+    /// by `kind`.
+    void Reference(unsigned vpn, unsigned kind, unsigned count = 1)
+    {
+        if (last != nullptr && last->vpn == vpn && last->space == current
+              && last->countAndKind % (1 << PAGE_TRACE_KIND_BITS) == kind
+              && last->countAndKind >> PAGE_TRACE_KIND_BITS
+                   <= PAGE_TRACE_MAX_COUNT - count) {
+            last->countAndKind += count << PAGE_TRACE_KIND_BITS;
+        } else {
+            Append(current, vpn, kind, count);
+        }
+        numReferences += count;
+    }
+
+    /// The process `space` has ended.
+    void EndSpace(unsigned space)
+    {
+        Append(space, 0, PAGE_TRACE_END, 0);
+    }
+
+    /// Print how much was traced.
+    void Print() const;
+
+private:
+
+    /// Start a new record.
+    void Append(unsigned space, unsigned vpn, unsigned kind, unsigned count);
+
+    /// Write the records in the buffer to the file.
+    void Flush();
+
+    static const unsigned BUFFER_SIZE = 4096;
+
+    FILE *file;
+    const char *fileName;
+    pageTraceRecord buffer[BUFFER_SIZE];
+    unsigned numBuffered;
+
+    /// Record that new references may be merged into, if any.
+    pageTraceRecord *last;
+
+    unsigned current;
+    unsigned long numReferences;
+    unsigned long numRecords;
+};
+
+
+#endif
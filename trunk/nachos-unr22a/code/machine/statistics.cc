@@ -21,10 +21,27 @@ Statistics::Statistics()
     numDiskReads = numDiskWrites = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPageHits = numPacketsSent = numPacketsRecvd = 0;
-#ifdef DFS_TICKS_FIX
-    tickResets = 0;
-#endif
-
+    numPageIns = numEvictions = numPrecleanedFaults = 0;
+    replacementPolicy = nullptr;
+    minFrameQuota = maxFrameQuota = 0;
+    numLocalReplacements = numQuotaGrowths = numQuotaShrinks = 0;
+    numTrimmedFrames = 0;
+    loadControl = false;
+    numSuspensions = 0;
+    suspendedTicks = 0;
+    faultAroundWindow = readAheadWindow = 0;
+    numFaultAroundPages = numReadAheadPages = 0;
+    numSharedTextHits = numTextDrops = 0;
+    numForks = numCowShares = numCowCopies = 0;
+    numZeroPageMaps = numZeroPageCopies = 0;
+    swapPoolBudget = 0;
+    numSwapPoolStores = numSwapPoolRejects = numSwapPoolWritebacks = 0;
+    swapPoolBytesIn = swapPoolBytesOut = 0;
+    numSwapPoolHits = numSwapPoolMisses = 0;
+    numExecutableCacheHits = numExecutableCacheMisses = 0;
+    numAsidRecycles = 0;
+    tlbPolicy = nullptr;
+    numTlbEvictions = 0;
 }
 
 /// Print performance metrics, when we have finished everything at system
@@ -32,18 +49,75 @@ Statistics::Statistics()
 void
 Statistics::Print()
 {
-#ifdef DFS_TICKS_FIX
-    if (tickResets != 0) {
-        printf("WARNING: the tick counter was reset %lu times; the following"
-               " statistics may be invalid.\n\n", tickResets);
-    }
-#endif
-    printf("Ticks: total %lu, idle %lu, system %lu, user %lu\n",
+    printf("Ticks: total %llu, idle %llu, system %llu, user %llu\n",
            totalTicks, idleTicks, systemTicks, userTicks);
     printf("Disk I/O: reads %lu, writes %lu\n", numDiskReads, numDiskWrites);
     printf("Console I/O: reads %lu, writes %lu\n",
            numConsoleCharsRead, numConsoleCharsWritten);
     printf("Paging: faults %lu, \"hits\": %lu, real hits: %lu, hit ratio: %.3f%%\n", numPageFaults, numPageHits, numPageHits-numPageFaults, ((double)(numPageHits-numPageFaults) / (numPageHits)) * 100);
+    for (const ProcessPaging &p : processPaging) {
+        printf("  process %d: faults %lu, \"hits\": %lu, hit ratio: "
+               "%.3f%%\n", p.spaceId, p.faults, p.hits,
+               p.hits > 0 ? (double) (p.hits - p.faults) / p.hits * 100
+                          : 0.0);
+    }
+    if (!processPaging.empty()) {
+        printf("  ASIDs recycled %lu\n", numAsidRecycles);
+    }
+    if (tlbPolicy != nullptr) {
+        printf("TLB: policy %s, misses %lu, evictions %lu\n",
+               tlbPolicy, numPageFaults, numTlbEvictions);
+    }
+    if (replacementPolicy != nullptr) {
+        printf("Replacement: policy %s, page-ins %lu, evictions %lu, "
+               "pre-cleaned %lu\n", replacementPolicy, numPageIns,
+               numEvictions, numPrecleanedFaults);
+        printf("Prefetch: fault-around %u, %lu pages; read-ahead %u, "
+               "%lu pages\n", faultAroundWindow, numFaultAroundPages,
+               readAheadWindow, numReadAheadPages);
+    }
+    if (maxFrameQuota > 0) {
+        printf("Quotas: frames %u to %u, local replacements %lu, PFF "
+               "raised %lu, lowered %lu, frames trimmed %lu\n",
+               minFrameQuota, maxFrameQuota, numLocalReplacements,
+               numQuotaGrowths, numQuotaShrinks, numTrimmedFrames);
+    }
+    if (loadControl) {
+        printf("Load control: suspensions %lu, ticks suspended %llu\n",
+               numSuspensions, suspendedTicks);
+    }
+    if (numSharedTextHits + numTextDrops > 0) {
+        printf("Shared text: hits %lu, drops %lu\n",
+               numSharedTextHits, numTextDrops);
+    }
+    if (numForks > 0) {
+        printf("Fork: forks %lu, pages shared %lu, copied on write %lu\n",
+               numForks, numCowShares, numCowCopies);
+    }
+    if (numZeroPageMaps > 0) {
+        printf("Zero page: mapped %lu, copied on write %lu, zero fills "
+               "avoided %lu\n", numZeroPageMaps, numZeroPageCopies,
+               numZeroPageMaps - numZeroPageCopies);
+    }
+    if (swapPoolBudget > 0) {
+        printf("Swap pool: budget %u bytes, stored %lu, rejected %lu, "
+               "written back %lu\n", swapPoolBudget, numSwapPoolStores,
+               numSwapPoolRejects, numSwapPoolWritebacks);
+        printf("  compression: %llu bytes to %llu, ratio %.2f\n",
+               swapPoolBytesIn, swapPoolBytesOut,
+               swapPoolBytesOut > 0
+                 ? (double) swapPoolBytesIn / swapPoolBytesOut : 0.0);
+        printf("  reads: hits %lu, misses %lu, hit ratio %.3f%%\n",
+               numSwapPoolHits, numSwapPoolMisses,
+               numSwapPoolHits + numSwapPoolMisses > 0
+                 ? (double) numSwapPoolHits
+                     / (numSwapPoolHits + numSwapPoolMisses) * 100
+                 : 0.0);
+    }
+    if (numExecutableCacheHits + numExecutableCacheMisses > 0) {
+        printf("Executable cache: hits %lu, misses %lu\n",
+               numExecutableCacheHits, numExecutableCacheMisses);
+    }
     printf("Network I/O: packets received %lu, sent %lu\n",
            numPacketsRecvd, numPacketsSent);
 }
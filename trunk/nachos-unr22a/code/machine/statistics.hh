@@ -11,6 +11,8 @@
 #define NACHOS_MACHINE_STATS__HH
 
 
+#include <vector>
+
 /// The following class defines the statistics that are to be kept about
 /// Nachos behavior -- how much time (ticks) elapsed, how many user
 /// instructions executed, etc.
@@ -20,17 +22,20 @@ class Statistics {
 public:
 
     /// Total time running Nachos.
-    unsigned long totalTicks;
+    ///
+    /// Time is kept in 64 bits everywhere, so it never wraps around in
+    /// practice.
+    unsigned long long totalTicks;
 
     /// Time spent idle (no threads to run).
-    unsigned long idleTicks;
+    unsigned long long idleTicks;
 
     /// Time spent executing system code.
-    unsigned long systemTicks;
+    unsigned long long systemTicks;
 
     /// Time spent executing user code (this is also equal to # of user
     /// instructions executed).
-    unsigned long userTicks;
+    unsigned long long userTicks;
 
     /// Number of disk read requests.
     unsigned long numDiskReads;
@@ -50,17 +55,104 @@ public:
     /// Number of virtual memory page "hits".
     unsigned long numPageHits;
 
+    /// Page "hits" and faults of one process, counted while it ran.
+    struct ProcessPaging {
+        int spaceId;
+        unsigned long hits;
+        unsigned long faults;
+    };
+
+    /// Every process that ran with a TLB, in the order they finished.
+    std::vector<ProcessPaging> processPaging;
+
+    /// Number of times a TLB address space identifier was taken away from
+    /// a space to give it to another one.
+    unsigned long numAsidRecycles;
+
+    /// Name of the TLB replacement policy, or null if there is no TLB, and
+    /// number of valid entries it replaced.
+    const char *tlbPolicy;
+    unsigned long numTlbEvictions;
+
+    /// Number of faults that had to bring a page into memory, and how many
+    /// of them evicted another page to make room.
+    unsigned long numPageIns;
+    unsigned long numEvictions;
+
+    /// Number of page-ins that found a frame freed by the page cleaner.
+    unsigned long numPrecleanedFaults;
+
+    /// Largest number of pages loaded around a fault from the executable,
+    /// and read ahead of a fault from swap, and how many pages were loaded
+    /// each way.
+    unsigned faultAroundWindow;
+    unsigned readAheadWindow;
+    unsigned long numFaultAroundPages;
+    unsigned long numReadAheadPages;
+
+    /// Name of the page replacement policy in use, or null if pages are
+    /// never replaced.
+    const char *replacementPolicy;
+
+    /// Frame quotas, or zero if replacement is global; page-ins that
+    /// replaced a page of their own space; quotas raised and lowered by
+    /// page-fault frequency; and frames taken back from spaces over their
+    /// quota or suspended.
+    unsigned minFrameQuota;
+    unsigned maxFrameQuota;
+    unsigned long numLocalReplacements;
+    unsigned long numQuotaGrowths;
+    unsigned long numQuotaShrinks;
+    unsigned long numTrimmedFrames;
+
+    /// Whether load control is on, processes it suspended, and ticks they
+    /// spent suspended.
+    bool loadControl;
+    unsigned long numSuspensions;
+    unsigned long long suspendedTicks;
+
+    /// Faults on shared code that found the page loaded by another process,
+    /// and shared code pages dropped to free their frame.
+    unsigned long numSharedTextHits;
+    unsigned long numTextDrops;
+
+    /// Number of processes forked, pages they started out sharing with
+    /// their parent, and pages copied when either wrote them.
+    unsigned long numForks;
+    unsigned long numCowShares;
+    unsigned long numCowCopies;
+
+    /// Faults on pages of zeroes that mapped the shared zero frame, and
+    /// how many of those pages were written later and got a frame of their
+    /// own.  The rest never had to be zero filled.
+    unsigned long numZeroPageMaps;
+    unsigned long numZeroPageCopies;
+
+    /// Bytes the pool of compressed swapped pages may take, or 0 if there
+    /// is none; pages stored in it, pages that went to disk instead because
+    /// they did not compress or fit, and pages written back to disk to make
+    /// room; and the bytes stored, before and after compression.
+    unsigned swapPoolBudget;
+    unsigned long numSwapPoolStores;
+    unsigned long numSwapPoolRejects;
+    unsigned long numSwapPoolWritebacks;
+    unsigned long long swapPoolBytesIn;
+    unsigned long long swapPoolBytesOut;
+
+    /// Pages read from swap that were found in the pool, and on disk.
+    unsigned long numSwapPoolHits;
+    unsigned long numSwapPoolMisses;
+
+    /// Number of programs run whose executable was cached, and not.
+    unsigned long numExecutableCacheHits;
+    unsigned long numExecutableCacheMisses;
+
     /// Number of packets sent over the network.
     unsigned long numPacketsSent;
 
     /// Number of packets received over the network.
     unsigned long numPacketsRecvd;
 
-#ifdef DFS_TICKS_FIX
-    /// Number of times the tick count gets reset.
-    unsigned long tickResets;
-#endif
-
     /// Initialize everything to zero.
     Statistics();
 
@@ -34,6 +34,7 @@ extern "C" {
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/file.h>
+#include <sys/stat.h>
 #include <sys/un.h>
 #include <sys/mman.h>
 #ifdef HOST_i386
@@ -191,6 +192,18 @@ Close(int fd)
     ASSERT(retVal >= 0);
 }
 
+/// Identify an open file by its inode.
+///
+/// Abort on error.
+unsigned long
+FileId(int fd)
+{
+    struct stat st;
+    int retVal = fstat(fd, &st);
+    ASSERT(retVal >= 0);
+    return st.st_ino;
+}
+
 /// Delete a file.
 bool
 Unlink(const char *name)
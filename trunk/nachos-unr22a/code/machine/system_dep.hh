@@ -41,6 +41,10 @@ namespace SystemDep {
 
     int Tell(int fd);
 
+    /// Number of the inode of an open file, which tells whether two
+    /// descriptors refer to the same file.
+    unsigned long FileId(int fd);
+
     void Close(int fd);
 
     bool Unlink(const char *name);
@@ -0,0 +1,151 @@
+/// Basic blocks translated for the threaded execution engine.
+///
+/// A block is a straight-line run of instructions that lives inside a single
+/// physical page.  Each instruction is stored pre-decoded, together with the
+/// address of the code that implements it inside `Machine::ExecBlock`, so
+/// running a block needs neither decoding nor a `switch`: every operation
+/// jumps straight into the next one (direct threading, through GCC's
+/// computed `goto`).
+///
+/// Blocks are indexed by the physical address of their first instruction and
+/// owned by the MMU, which drops them whenever the words they were built from
+/// change.
+///
+/// Blocks that run often enough are also compiled to host code (see
+/// `mips_jit.cc`); the host code lives in a separate cache, and is simply
+/// forgotten together with its block.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_MACHINE_THREADEDBLOCK__HH
+#define NACHOS_MACHINE_THREADEDBLOCK__HH
+
+
+#include "instruction.hh"
+
+
+/// Operations understood by the threaded engine.
+///
+/// Most of them map one to one to an opcode; the first few are special
+/// cases that the translator picks when the operands allow it.  Anything not
+/// listed here ends the block, and is executed by `ExecInstruction`.
+enum ThreadedKind {
+    TK_NOP,    ///< Any pure computation whose destination is `r0`.
+    TK_LI,     ///< `addiu rt, r0, imm`.
+    TK_MOVE,   ///< `addu rd, rs, r0` and `or rd, rs, r0`.
+    TK_ADD, TK_ADDI, TK_ADDIU, TK_ADDU, TK_AND, TK_ANDI,
+    TK_BEQ, TK_BGEZ, TK_BGTZ, TK_BLEZ, TK_BLTZ, TK_BNE,
+    TK_DIV, TK_DIVU, TK_J, TK_JAL, TK_JALR, TK_JR,
+    TK_LB, TK_LBU, TK_LH, TK_LHU, TK_LUI, TK_LW,
+    TK_MFHI, TK_MFLO, TK_MTHI, TK_MTLO, TK_MULT, TK_MULTU,
+    TK_NOR, TK_OR, TK_ORI, TK_SB, TK_SH,
+    TK_SLL, TK_SLLV, TK_SLT, TK_SLTI, TK_SLTIU, TK_SLTU,
+    TK_SRA, TK_SRAV, TK_SRL, TK_SRLV, TK_SUB, TK_SUBU, TK_SW,
+    TK_XOR, TK_XORI,
+    NUM_THREADED_KINDS,
+    TK_INTERPRET = NUM_THREADED_KINDS  ///< Not translated.
+};
+
+static inline bool
+IsLoad(ThreadedKind kind)
+{
+    return kind == TK_LB || kind == TK_LBU || kind == TK_LH
+           || kind == TK_LHU || kind == TK_LW;
+}
+
+static inline bool
+IsTransfer(ThreadedKind kind)
+{
+    return kind == TK_BEQ || kind == TK_BGEZ || kind == TK_BGTZ
+           || kind == TK_BLEZ || kind == TK_BLTZ || kind == TK_BNE
+           || kind == TK_J || kind == TK_JAL || kind == TK_JALR
+           || kind == TK_JR;
+}
+
+/// One translated instruction.
+struct ThreadedOp {
+    /// Label implementing the operation; filled in the first time the block
+    /// runs, since label addresses are only known inside the executor.
+    const void *handler;
+
+    /// Decoded instruction (registers and immediate).
+    Instruction instr;
+
+    ThreadedKind kind;
+
+    /// Whether a delayed load may still be pending when this operation
+    /// runs.  False when the previous operation of the block is known not to
+    /// be a load, which lets the executor skip `DelayedLoad`.
+    bool finishLoad;
+};
+
+class ThreadedBlock {
+public:
+
+    /// Allocate room for `numOps` operations starting at `physAddr`.
+    ThreadedBlock(unsigned physAddr, unsigned numOps)
+    {
+        physicalAddr     = physAddr;
+        length           = numOps;
+        ops              = length > 0 ? new ThreadedOp [length] : nullptr;
+        linked           = false;
+        users            = 0;
+        dead             = false;
+        nextInFrame      = nullptr;
+        heat             = 0;
+        native           = nullptr;
+        nativeGeneration = 0;
+    }
+
+    ~ThreadedBlock()
+    {
+        delete [] ops;
+    }
+
+    /// Whether the physical word at `addr` was used to build this block.
+    ///
+    /// An empty block still depends on its first word, which is the one
+    /// that could not be translated.
+    bool Covers(unsigned addr) const
+    {
+        unsigned words = length > 0 ? length : 1;
+        return physicalAddr <= addr && addr < physicalAddr + words * 4;
+    }
+
+    /// Physical address of the first instruction.
+    unsigned physicalAddr;
+
+    /// Number of operations.  Zero means that the first instruction could
+    /// not be translated, so the interpreter has to run it.
+    unsigned length;
+
+    ThreadedOp *ops;
+
+    /// Whether `handler` has been filled in for every operation.
+    bool linked;
+
+    /// Number of threads currently executing the block.  A thread may be
+    /// switched out in the middle of a block (on a timer interrupt), so a
+    /// dropped block is only deleted once nobody is inside it.
+    unsigned users;
+
+    /// The block was dropped by the MMU and must not be entered again.
+    bool dead;
+
+    /// Next block in the same physical frame.
+    ThreadedBlock *nextInFrame;
+
+    /// Number of times the block was entered, until it gets compiled.
+    unsigned heat;
+
+    /// Host code for the block, or null.  Only valid while
+    /// `nativeGeneration` matches the generation of the code cache, which
+    /// changes every time the cache is flushed.
+    void *native;
+    unsigned nativeGeneration;
+};
+
+
+#endif
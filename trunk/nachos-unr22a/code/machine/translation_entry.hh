@@ -18,6 +18,7 @@
 #define NACHOS_MACHINE_TRANSLATIONENTRY__HH
 
 
+#include "lib/sparse_table.hh"
 #include "lib/utility.hh"
 
 
@@ -55,7 +56,20 @@ public:
     bool dirty;
 
     bool isInSwap;
+
+    /// Address space the entry belongs to, in a TLB.  The MMU only matches
+    /// entries tagged with its current ASID, so entries of several spaces
+    /// can be in the TLB at once.  Ignored in page tables.
+    unsigned asid;
 };
 
+/// A page table, indexed by virtual page number.
+///
+/// Page tables have two levels, so that only the regions of an address
+/// space that are in use take memory for their entries: the entries of a
+/// page that was never touched may be missing, and such a page is treated
+/// as invalid.
+typedef SparseTable<TranslationEntry> PageTable;
+
 
 #endif
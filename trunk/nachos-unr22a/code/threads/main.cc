@@ -11,8 +11,15 @@
 /// =====
 ///
 ///     nachos [-d <debugflags>] [-do <debugopts>] [-p]
-///            [-rs <random seed #>] [-z] [-tt]
-///            [-s] [-x <nachos file>] [-tc <consoleIn> <consoleOut>]
+///            [-rs <random seed #>] [-z] [-ti] [-tt]
+///            [-s] [-cpu <engine>] [-rp <policy>] [-wm <low> <high>]
+///            [-fa <pages>] [-ra <pages>] [-tp <policy>] [-ts <sizes>]
+///            [-m <pages>] [-tlb <entries>] [-sw <slots>] [-zp <bytes>]
+///            [-fq <min> <max>] [-pff <ticks>] [-lc <gap> <pause>]
+///            [-tr <trace file>]
+///            [-x <nachos file>]
+///            [-te <nachos file>]
+///            [-tc <consoleIn> <consoleOut>]
 ///            [-f] [-cp <unix file> <nachos file>] [-pr <nachos file>]
 ///            [-rm <nachos file>] [-ls] [-D] [-c] [-tf]
 ///            [-n <network reliability>] [-id <machine id>]
@@ -28,6 +35,7 @@
 /// * `-p`  -- enables preemptive multitasking for kernel threads.
 /// * `-rs` -- causes `Yield` to occur at random (but repeatable) spots.
 /// * `-z`  -- prints version and copyright information, and exits.
+/// * `-ti` -- tests the performance of the queue of pending interrupts.
 ///
 /// *THREADS* options
 /// -----------------
@@ -39,7 +47,50 @@
 /// ----------------------
 ///
 /// * `-s`  -- causes user programs to be executed in single-step mode.
+/// * `-cpu` -- selects how user instructions are executed: `interp` (the
+///            default) interprets them one at a time, `threaded` runs
+///            pre-translated blocks, `jit` also compiles the hottest blocks
+///            to host code, and `check` runs every block both ways and
+///            stops if the results differ.
+/// * `-rp` -- selects the page replacement policy, when pages are swapped:
+///            `fifo`, `lru` or `clock`.  The default is `lru` if the kernel
+///            is built with `USE_LRU` and `fifo` otherwise.
+/// * `-wm` -- sets the watermarks of the page cleaner, which starts
+///            evicting pages ahead of demand once fewer than `low` frames
+///            are free, and stops when `high` are.  `-wm 0 0` turns it off.
+///            The default ones shrink to fit memories of very few frames,
+///            down to the three that swapping needs.
+/// * `-fa` -- sets how many neighbouring pages of the executable are loaded
+///            along with a faulting one.
+/// * `-ra` -- sets how many pages may be read ahead of a run of faults on
+///            consecutive pages in swap.
+/// * `-tp` -- selects the TLB replacement policy: `fifo` (the default),
+///            `random`, `lru` or `nru`.
+/// * `-ts` -- also runs the memory references through simulated TLBs of
+///            every policy and of each of the comma separated sizes, and
+///            prints their misses when Nachos halts.
+/// * `-m`  -- sets the number of pages of main memory (8 by default).
+/// * `-tlb` -- sets the number of entries of the TLB, at least 2 (4 by
+///            default).
+/// * `-sw` -- sets the number of page slots of the swap area, at most (and
+///            by default) the number of sectors of a disk.
+/// * `-zp` -- keeps swapped pages compressed in a pool of up to `bytes`
+///            bytes of memory, and only writes them to the swap disk when
+///            it is full.  There is no pool by default.
+/// * `-fq` -- replaces pages locally, with quotas of `min` to `max` frames
+///            per process, at least 2: a process at its quota replaces its
+///            own pages.  Replacement is global by default.
+/// * `-pff` -- makes quotas follow the page-fault frequency: a page-in less
+///            than `ticks` user ticks of the process after its previous one
+///            raises its quota, and any other lowers it.  Needs `-fq`.
+/// * `-lc` -- turns load control on: when page-ins come fewer than `gap`
+///            user ticks apart, the process that faults is suspended for
+///            `pause` ticks and its frames are released.
+/// * `-tr` -- writes every page referenced by user programs to the host
+///            file `trace file`, to be replayed with `bin/pagesim`.
 /// * `-x`  -- runs a user program.
+/// * `-te` -- times creating address spaces for a user program, as `Exec`
+///            does, with its header and first pages cached and without.
 /// * `-tc` -- tests the console.
 ///
 /// *FILESYS* options
@@ -94,6 +145,8 @@ void PerformanceTest(void);
 void StartProcess(const char *file);
 void ConsoleTest(const char *in, const char *out);
 void MailTest(int networkID);
+void InterruptPerformanceTest();
+void ExecPerformanceTest(const char *file);
 
 static inline void
 PrintVersion()
@@ -132,6 +185,10 @@ main(int argc, char **argv)
             PrintVersion();
             return 0;
         }
+        if (!strcmp(*argv, "-ti")) {         // Test the interrupt queue.
+            InterruptPerformanceTest();
+            interrupt->Halt();
+        }
 #ifdef THREADS
         if (!strcmp(*argv, "-tt")) {         // Test the threading subsystem.
             ThreadTest();
@@ -143,6 +200,10 @@ main(int argc, char **argv)
             ASSERT(argc > 1);
             StartProcess(*(argv + 1));
             argCount = 2;
+        } else if (!strcmp(*argv, "-te")) {  // Test loading a program.
+            ASSERT(argc > 1);
+            ExecPerformanceTest(*(argv + 1));
+            interrupt->Halt();
         } else if (!strcmp(*argv, "-tc")) {  // Test the console.
             if (argc == 1) {
                 ConsoleTest(nullptr, nullptr);
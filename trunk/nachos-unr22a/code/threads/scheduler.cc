@@ -144,6 +144,12 @@ void
 Scheduler::TransferPriority(Thread* thread, unsigned number) {
     ASSERT(number >= 0 && number < QUANTITY_PRIORITY_QUEUES);
     DEBUG('t', "Transfering piority %d to thread \"%s\"", number, thread->GetName());
+    // Only a thread that is ready sits in a queue; one that is blocked, say
+    // waiting for the disk, must stay blocked.
+    if (thread->GetStatus() != READY) {
+        thread->SetPriority(number);
+        return;
+    }
     priorityQueue[thread->GetPriority()]->Remove(thread);
     thread->SetPriority(number);
     priorityQueue[number]->Append(thread);
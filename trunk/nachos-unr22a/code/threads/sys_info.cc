@@ -37,9 +37,6 @@ void SysInfo()
 #endif
 #ifdef FILESYS_NEEDED
       "FILESYS_NEEDED "
-#endif
-#ifdef DFS_TICKS_FIX
-      "DFS_TICKS_FIX "
 #endif
       ;
 
@@ -52,10 +49,11 @@ General:\n\
     printf("\n\
 Memory:\n\
   Page size: %u bytes.\n\
-  Number of pages: %u.\n\
-  Number of TLB entries: %u.\n\
-  Memory size: %u bytes.\n",
-      PAGE_SIZE, NUM_PHYS_PAGES, TLB_SIZE, MEMORY_SIZE);
+  Default number of pages: %u.\n\
+  Default number of TLB entries: %u.\n\
+  Default memory size: %u bytes.\n",
+      PAGE_SIZE, DEFAULT_NUM_PHYS_PAGES, DEFAULT_TLB_SIZE,
+      DEFAULT_NUM_PHYS_PAGES * PAGE_SIZE);
     printf("\n\
 Disk:\n\
   Sector size: %u bytes.\n\
@@ -36,6 +36,23 @@ Timer *timer;                 ///< The hardware timer device, for invoking
 PreemptiveScheduler *preemptiveScheduler = nullptr;
 const long long DEFAULT_TIME_SLICE = 50000;
 
+#ifdef USE_TLB
+/// Most TLB sizes that can be simulated at once.
+const unsigned MAX_SWEEP_SIZES = 16;
+#endif
+
+#ifdef SWAP
+/// Free frames below which the page cleaner wakes up, and that it leaves
+/// free when it is done.
+const unsigned DEFAULT_LOW_WATER = 1;
+const unsigned DEFAULT_HIGH_WATER = 2;
+
+/// Most pages loaded along with a faulting one, from the executable and
+/// from swap.
+const unsigned DEFAULT_FAULT_AROUND = 4;
+const unsigned DEFAULT_READ_AHEAD = 4;
+#endif
+
 const unsigned NUMBER_OF_TRIES = 5;
 
 #ifdef FILESYS_NEEDED
@@ -46,14 +63,26 @@ FileSystem *fileSystem;
 SynchDisk *synchDisk;
 #endif
 
+#ifdef USER_PROGRAM
+ExecutableCache *executableCache;
+#endif
+
 #ifdef USER_PROGRAM  // Requires either *FILESYS* or *FILESYS_STUB*.
 Machine *machine;  ///< User program memory and registers.
 SynchConsole *synchconsole;
 Table<Thread*> *activeThreads;
+PageTrace *pageTrace;
 #ifndef SWAP
 Bitmap *pages;
 #else
 Coremap *coreMap;
+SwapArea *swapArea;
+unsigned faultAroundPages = DEFAULT_FAULT_AROUND;
+unsigned maxReadAheadPages = DEFAULT_READ_AHEAD;
+#endif
+#ifdef USE_TLB
+TlbPolicy *tlbPolicy;
+TlbSweep *tlbSweep;
 #endif
 #endif
 
@@ -147,6 +176,30 @@ Initialize(int argc, char **argv)
 
 #ifdef USER_PROGRAM
     bool debugUserProg = false;  // Single step user program.
+    ExecutionEngine engine = INTERPRETER_ENGINE;
+    unsigned numPhysPages = DEFAULT_NUM_PHYS_PAGES;
+    unsigned tlbSize = DEFAULT_TLB_SIZE;
+    const char *traceName = nullptr;  // Page references are not traced.
+#endif
+#ifdef SWAP
+#ifdef USE_LRU
+    ReplacementPolicy replacement = LRU_REPLACEMENT;
+#else
+    ReplacementPolicy replacement = FIFO_REPLACEMENT;
+#endif
+    unsigned lowWater = DEFAULT_LOW_WATER;    // Page cleaner watermarks.
+    unsigned highWater = DEFAULT_HIGH_WATER;
+    bool watermarksGiven = false;
+    unsigned swapSlots = NUM_SECTORS;
+    unsigned swapPoolBudget = 0;              // Compressed pool is off.
+    unsigned minQuota = 0, maxQuota = 0;      // Replacement is global.
+    unsigned pffInterval = 0;
+    unsigned loadGap = 0, loadPause = 0;      // No load control.
+#endif
+#ifdef USE_TLB
+    TlbReplacement tlbReplacement = FIFO_TLB;
+    unsigned sweepSizes[MAX_SWEEP_SIZES];  // TLB sizes to simulate.
+    unsigned numSweepSizes = 0;
 #endif
 #ifdef FILESYS_NEEDED
     bool format = false;  // Format disk.
@@ -190,6 +243,127 @@ Initialize(int argc, char **argv)
 #ifdef USER_PROGRAM
         if (!strcmp(*argv, "-s")) {
             debugUserProg = true;
+        } else if (!strcmp(*argv, "-cpu")) {
+            ASSERT(argc > 1);
+            const char *name = *(argv + 1);
+            if (!strcmp(name, "interp")) {
+                engine = INTERPRETER_ENGINE;
+            } else if (!strcmp(name, "threaded")) {
+                engine = THREADED_ENGINE;
+            } else if (!strcmp(name, "jit")) {
+                engine = JIT_ENGINE;
+            } else if (!strcmp(name, "check")) {
+                engine = CHECKED_ENGINE;
+            } else {
+                ASSERT(false);
+            }
+            argCount = 2;
+        } else if (!strcmp(*argv, "-m")) {
+            ASSERT(argc > 1);
+            numPhysPages = atoi(*(argv + 1));
+            ASSERT(numPhysPages > 0);
+            argCount = 2;
+        } else if (!strcmp(*argv, "-tlb")) {
+            ASSERT(argc > 1);
+            tlbSize = atoi(*(argv + 1));
+            // An instruction may need both its own page and the one it
+            // loads from or stores to.
+            ASSERT(tlbSize >= 2);
+            argCount = 2;
+        } else if (!strcmp(*argv, "-tr")) {
+            ASSERT(argc > 1);
+            traceName = *(argv + 1);
+            argCount = 2;
+        }
+#endif
+#ifdef SWAP
+        if (!strcmp(*argv, "-rp")) {
+            ASSERT(argc > 1);
+            const char *name = *(argv + 1);
+            if (!strcmp(name, "fifo")) {
+                replacement = FIFO_REPLACEMENT;
+            } else if (!strcmp(name, "lru")) {
+                replacement = LRU_REPLACEMENT;
+            } else if (!strcmp(name, "clock")) {
+                replacement = CLOCK_REPLACEMENT;
+            } else {
+                ASSERT(false);
+            }
+            argCount = 2;
+        } else if (!strcmp(*argv, "-wm")) {
+            ASSERT(argc > 2);
+            lowWater = atoi(*(argv + 1));
+            highWater = atoi(*(argv + 2));
+            watermarksGiven = true;
+            argCount = 3;
+        } else if (!strcmp(*argv, "-fa")) {
+            ASSERT(argc > 1);
+            faultAroundPages = atoi(*(argv + 1));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-ra")) {
+            ASSERT(argc > 1);
+            maxReadAheadPages = atoi(*(argv + 1));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-sw")) {
+            ASSERT(argc > 1);
+            swapSlots = atoi(*(argv + 1));
+            ASSERT(swapSlots > 0 && swapSlots <= NUM_SECTORS);
+            argCount = 2;
+        } else if (!strcmp(*argv, "-zp")) {
+            ASSERT(argc > 1);
+            swapPoolBudget = atoi(*(argv + 1));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-fq")) {
+            ASSERT(argc > 2);
+            minQuota = atoi(*(argv + 1));
+            maxQuota = atoi(*(argv + 2));
+            // Like the TLB, a process needs room for an instruction and the
+            // data it accesses.
+            ASSERT(minQuota >= 2 && minQuota <= maxQuota);
+            argCount = 3;
+        } else if (!strcmp(*argv, "-pff")) {
+            ASSERT(argc > 1);
+            pffInterval = atoi(*(argv + 1));
+            ASSERT(pffInterval > 0);
+            argCount = 2;
+        } else if (!strcmp(*argv, "-lc")) {
+            ASSERT(argc > 2);
+            loadGap = atoi(*(argv + 1));
+            loadPause = atoi(*(argv + 2));
+            ASSERT(loadGap > 0);
+            argCount = 3;
+        }
+#endif
+#ifdef USE_TLB
+        if (!strcmp(*argv, "-tp")) {
+            ASSERT(argc > 1);
+            const char *name = *(argv + 1);
+            if (!strcmp(name, "fifo")) {
+                tlbReplacement = FIFO_TLB;
+            } else if (!strcmp(name, "random")) {
+                tlbReplacement = RANDOM_TLB;
+            } else if (!strcmp(name, "lru")) {
+                tlbReplacement = LRU_TLB;
+            } else if (!strcmp(name, "nru")) {
+                tlbReplacement = NRU_TLB;
+            } else {
+                ASSERT(false);
+            }
+            argCount = 2;
+        } else if (!strcmp(*argv, "-ts")) {
+            ASSERT(argc > 1);
+            char *save_p;
+            for (char *s = *(argv + 1); ; s = nullptr) {
+                char *token = strtok_r(s, ",", &save_p);
+                if (token == nullptr) {
+                    break;
+                }
+                ASSERT(numSweepSizes < MAX_SWEEP_SIZES);
+                sweepSizes[numSweepSizes] = atoi(token);
+                ASSERT(sweepSizes[numSweepSizes] > 0);
+                numSweepSizes++;
+            }
+            argCount = 2;
         }
 #endif
 #ifdef FILESYS_NEEDED
@@ -240,22 +414,62 @@ Initialize(int argc, char **argv)
 
 #ifdef USER_PROGRAM
     Debugger *d = debugUserProg ? new Debugger : nullptr;
-    machine = new Machine(d);  // This must come first.
+    // This must come first.
+    machine = new Machine(d, engine, numPhysPages, tlbSize);
     synchconsole = new SynchConsole("SynchConsole");
+    pageTrace = traceName != nullptr ? new PageTrace(traceName) : nullptr;
 #ifndef SWAP
-    pages = new Bitmap(NUM_PHYS_PAGES);
+    pages = new Bitmap(numPhysPages);
 #endif
     SetExceptionHandlers();
 #endif
 
 #ifdef SWAP
-    coreMap = new Coremap(NUM_PHYS_PAGES);
+    coreMap = new Coremap(numPhysPages, replacement);
+    stats->replacementPolicy = ReplacementPolicyName(replacement);
+    swapArea = new SwapArea("SWAP", swapSlots, swapPoolBudget);
+    stats->swapPoolBudget = swapPoolBudget;
+    if (maxQuota > 0) {
+        coreMap->SetQuotas(minQuota, maxQuota, pffInterval);
+        stats->minFrameQuota = minQuota;
+        stats->maxFrameQuota = maxQuota;
+    } else {
+        ASSERT(pffInterval == 0);  // Page-fault frequency adjusts quotas.
+    }
+    if (loadGap > 0) {
+        coreMap->SetLoadControl(loadGap, loadPause);
+        stats->loadControl = true;
+    }
+    // The zero page takes a frame, and an instruction may touch two pages
+    // that must be resident at once.
+    ASSERT(numPhysPages >= 3);
+    if (!watermarksGiven && highWater + 3 > numPhysPages) {
+        // Small memories: the cleaner must not evict those two pages.
+        highWater = numPhysPages - 3;
+        lowWater = lowWater < highWater ? lowWater : highWater;
+    }
+    coreMap->StartCleaner(lowWater, highWater);
+    stats->faultAroundWindow = faultAroundPages;
+    stats->readAheadWindow = maxReadAheadPages;
+#endif
+
+#ifdef USE_TLB
+    tlbPolicy = TlbPolicy::Create(tlbReplacement, tlbSize);
+    stats->tlbPolicy = TlbReplacementName(tlbReplacement);
+    tlbSweep = nullptr;
+    if (numSweepSizes > 0) {
+        tlbSweep = new TlbSweep(sweepSizes, numSweepSizes);
+    }
 #endif
 
 #ifdef FILESYS
     synchDisk = new SynchDisk("DISK");
 #endif
 
+#ifdef USER_PROGRAM
+    executableCache = new ExecutableCache;
+#endif
+
 #ifdef FILESYS_NEEDED
     fileSystem = new FileSystem(format);
 #endif
@@ -286,10 +500,23 @@ Cleanup()
     delete machine;
     delete synchconsole;
     delete activeThreads;
+    if (pageTrace != nullptr) {
+        pageTrace->Print();
+        delete pageTrace;
+    }
 #endif
 
 #ifdef SWAP
     delete coreMap;
+    delete swapArea;
+#endif
+
+#ifdef USE_TLB
+    if (tlbSweep != nullptr) {
+        tlbSweep->Print();
+        delete tlbSweep;
+    }
+    delete tlbPolicy;
 #endif
 
 #ifdef FILESYS_NEEDED
@@ -300,6 +527,10 @@ Cleanup()
     delete synchDisk;
 #endif
 
+#ifdef USER_PROGRAM
+    delete executableCache;
+#endif
+
     delete timer;
     delete scheduler;
     delete interrupt;
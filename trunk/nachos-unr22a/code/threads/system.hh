@@ -42,12 +42,23 @@ extern Machine *machine;  // User program memory and registers.
 extern SynchConsole *synchconsole;
 #include "lib/table.hh"
 extern Table<Thread *> *activeThreads;
+#include "machine/page_trace.hh"
+extern PageTrace *pageTrace;  // Null unless tracing page references.
 #ifndef SWAP
 #include "lib/bitmap.hh"
 extern Bitmap *pages;
 #else
 #include "lib/coremap.hh"
 extern Coremap *coreMap;
+#include "vmem/swap_area.hh"
+extern SwapArea *swapArea;
+extern unsigned faultAroundPages;   // Prefetch windows.
+extern unsigned maxReadAheadPages;
+#endif
+#ifdef USE_TLB
+#include "vmem/tlb_policy.hh"
+extern TlbPolicy *tlbPolicy;
+extern TlbSweep *tlbSweep;  // Null unless sweeping TLB sizes.
 #endif
 #endif
 
@@ -61,6 +72,11 @@ extern FileSystem *fileSystem;
 extern SynchDisk *synchDisk;
 #endif
 
+#ifdef USER_PROGRAM
+#include "userprog/executable_cache.hh"
+extern ExecutableCache *executableCache;
+#endif
+
 #ifdef NETWORK
 #include "network/post.hh"
 extern PostOffice *postOffice;
@@ -0,0 +1,96 @@
+/// Test program for `Fork` and copy on write.
+///
+/// Parent and child share every page after `Fork`, until either one writes
+/// it.  Both fill some of the pages with values of their own, and check
+/// that they still see theirs and, in the pages they did not write, the
+/// ones from before the fork: the data segment, the heap and the stack.
+/// The child reports through its exit status.
+
+
+#include "syscall.h"
+#include "lib.c"
+
+
+#define DIM        1024
+#define PAGE_INTS  32    // Integers in a page of memory.
+
+static int data[DIM];
+
+/// Fill every other page worth of `a` with `base` plus the index, starting
+/// with the first page if `first` is set and with the second one if not.
+static void
+Fill(int *a, int n, int first, int base)
+{
+    int i;
+    for (i = 0; i < n; i++) {
+        if (((i / PAGE_INTS) % 2 == 0) == first) {
+            a[i] = base + i;
+        }
+    }
+}
+
+/// Check that the pages that `Fill` writes with `first` hold `base` plus
+/// the index, and the others hold `original` plus the index.
+static int
+Check(const int *a, int n, int first, int base, int original)
+{
+    int i;
+    for (i = 0; i < n; i++) {
+        int expected = ((i / PAGE_INTS) % 2 == 0) == first ? base : original;
+        if (a[i] != expected + i) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int
+main(void)
+{
+    int stack[DIM / 4];
+    int *heap = malloc(DIM * sizeof *heap);
+    int i;
+
+    if (heap == 0) {
+        puts2("forktest: cannot allocate the heap array\n");
+        Exit(1);
+    }
+    for (i = 0; i < DIM; i++) {
+        data[i] = i;
+        heap[i] = i;
+    }
+    for (i = 0; i < DIM / 4; i++) {
+        stack[i] = i;
+    }
+
+    SpaceId child = Fork(1);
+    if (child < 0) {
+        puts2("forktest: cannot fork\n");
+        Exit(1);
+    }
+    if (child == 0) {
+        // The parent may write its pages before or after these run.
+        Fill(data, DIM, 1, 10000);
+        Fill(heap, DIM, 1, 20000);
+        Fill(stack, DIM / 4, 1, 30000);
+        Yield();
+        Exit(!Check(data, DIM, 1, 10000, 0)
+             || !Check(heap, DIM, 1, 20000, 0)
+             || !Check(stack, DIM / 4, 1, 30000, 0));
+    }
+
+    Fill(data, DIM, 0, 40000);
+    Fill(heap, DIM, 0, 50000);
+    Fill(stack, DIM / 4, 0, 60000);
+    int status = Join(child);
+
+    if (status == 0 && Check(data, DIM, 0, 40000, 0)
+          && Check(heap, DIM, 0, 50000, 0)
+          && Check(stack, DIM / 4, 0, 60000, 0)) {
+        puts2("forktest: ok\n");
+    } else {
+        puts2("forktest: parent and child see each other's writes\n");
+    }
+    Halt();
+    return 0;
+}
@@ -35,3 +35,100 @@ void itoa(int n, char *str) {
     str[i] = '\0';
     reverse(str);
 }
+
+/// A simple heap on top of `Sbrk`.
+///
+/// Blocks are kept in a list ordered by address, each preceded by a header.
+/// `malloc` takes the first free block that is large enough, splitting off
+/// what it does not need, and grows the heap when there is none; `free`
+/// merges a block with its free neighbours.
+
+#define HEAP_ALIGN  8
+#define HEAP_CHUNK  1024
+
+typedef struct heapBlock {
+    unsigned size;            // Bytes after the header.
+    int free;
+    struct heapBlock *next;   // Next block by address.
+    int unused;               // Keeps the data aligned.
+} heapBlock;
+
+static heapBlock *heapFirst;
+static heapBlock *heapLast;
+
+// Absorb the block after `b`, both being free.
+static void heapMerge(heapBlock *b) {
+    heapBlock *n = b->next;
+    b->size += sizeof (heapBlock) + n->size;
+    b->next = n->next;
+    if (heapLast == n)
+        heapLast = b;
+}
+
+void *malloc(unsigned size) {
+    heapBlock *b;
+
+    if (size == 0)
+        return 0;
+    size = (size + HEAP_ALIGN - 1) & ~(HEAP_ALIGN - 1);
+
+    for (b = heapFirst; b != 0; b = b->next)
+        if (b->free && b->size >= size)
+            break;
+
+    if (b == 0) {
+        // Grow the heap, by whole chunks to save system calls.  The new
+        // memory comes right after the last block.
+        unsigned grow = sizeof (heapBlock) + size;
+        if (heapLast != 0 && heapLast->free)
+            grow -= sizeof (heapBlock) + heapLast->size;
+        grow = (grow + HEAP_CHUNK - 1) & ~(HEAP_CHUNK - 1);
+
+        b = Sbrk(grow);
+        if (b == (void *) -1)
+            return 0;
+        b->size = grow - sizeof (heapBlock);
+        b->free = 1;
+        b->next = 0;
+        if (heapLast == 0) {
+            heapFirst = b;
+        } else {
+            heapLast->next = b;
+        }
+        if (heapLast != 0 && heapLast->free) {
+            b = heapLast;
+            heapMerge(b);
+        } else {
+            heapLast = b;
+        }
+    }
+
+    if (b->size >= size + sizeof (heapBlock) + HEAP_ALIGN) {
+        heapBlock *rest = (heapBlock *) ((char *) (b + 1) + size);
+        rest->size = b->size - size - sizeof (heapBlock);
+        rest->free = 1;
+        rest->next = b->next;
+        b->next = rest;
+        b->size = size;
+        if (heapLast == b)
+            heapLast = rest;
+    }
+    b->free = 0;
+    return b + 1;
+}
+
+void free(void *p) {
+    heapBlock *b, *prev;
+
+    if (p == 0)
+        return;
+    b = (heapBlock *) p - 1;
+    b->free = 1;
+
+    if (b->next != 0 && b->next->free)
+        heapMerge(b);
+    for (prev = heapFirst; prev != 0 && prev->next != b; prev = prev->next)
+        ;
+    if (prev != 0 && prev->free)
+        heapMerge(prev);
+}
@@ -0,0 +1,69 @@
+/// Test program to do matrix multiplication on arrays allocated from the
+/// heap.
+///
+/// Like `matmult`, but the size of the matrices is given as an argument
+/// (100 by default), so the memory the program uses can be changed without
+/// recompiling it.
+
+
+#include "syscall.h"
+#include "lib.c"
+
+
+#define DEFAULT_DIM  100
+
+static int
+ParseDim(const char *s)
+{
+    int n = 0;
+    for (; *s >= '0' && *s <= '9'; s++) {
+        n = 10 * n + *s - '0';
+    }
+    return n;
+}
+
+int
+main(int argc, char *argv[])
+{
+    int dim = argc > 1 ? ParseDim(argv[1]) : DEFAULT_DIM;
+    int i, j, k;
+
+    int *A = malloc(dim * dim * sizeof *A);
+    int *B = malloc(dim * dim * sizeof *B);
+    int *C = malloc(dim * dim * sizeof *C);
+    if (dim <= 0 || A == 0 || B == 0 || C == 0) {
+        puts2("matmult_heap: cannot allocate the matrices\n");
+        Exit(1);
+    }
+
+    // First initialize the matrices.
+    for (i = 0; i < dim; i++) {
+        for (j = 0; j < dim; j++) {
+            A[i * dim + j] = i;
+            B[i * dim + j] = j;
+            C[i * dim + j] = 0;
+        }
+    }
+
+    // Then multiply them together.
+    for (i = 0; i < dim; i++) {
+        for (j = 0; j < dim; j++) {
+            for (k = 0; k < dim; k++) {
+                C[i * dim + j] += A[i * dim + k] * B[k * dim + j];
+            }
+        }
+    }
+
+    char res[12];
+    itoa(C[(dim - 1) * dim + dim - 1], res);
+    puts2(res);
+    puts2("\n");
+
+    free(C);
+    free(B);
+    free(A);
+
+    // Halt, to see the statistics of the run.
+    Halt();
+    return 0;
+}
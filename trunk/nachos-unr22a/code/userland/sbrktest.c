@@ -0,0 +1,102 @@
+/// Test program for `Sbrk`.
+///
+/// Checks that the break only moves when it can: not below the start of
+/// the heap, not into the stack and not beyond the room left in swap.  A
+/// failed call must return -1 and leave the break where it was.  Memory
+/// given back by shrinking the heap must read as zeroes once the heap
+/// grows over it again, and touching it before then kills the process.
+
+
+#include "syscall.h"
+#include "lib.c"
+
+
+#define PAGE_SIZE  128
+#define FAILED     ((char *) -1)
+
+static void
+Fail(const char *what)
+{
+    puts2("sbrktest: ");
+    puts2(what);
+    puts2("\n");
+    Halt();
+}
+
+int
+main(void)
+{
+    char *start = Sbrk(0);
+
+    // The heap cannot shrink below its start, nor grow into the stack:
+    // the whole space is a megabyte.
+    if (Sbrk(-1) != FAILED) {
+        Fail("shrinking an empty heap did not fail");
+    }
+    if (Sbrk(1 << 20) != FAILED) {
+        Fail("growing the heap into the stack did not fail");
+    }
+
+    // Half a megabyte is below the stack, but is more than the swap area
+    // holds.
+    if (Sbrk(1 << 19) != FAILED) {
+        Fail("growing the heap beyond the swap area did not fail");
+    }
+    if (Sbrk(0) != start) {
+        Fail("a failed call moved the break");
+    }
+
+    // Growing memory reads as zeroes, and keeps what is written to it.
+    char *p = Sbrk(4 * PAGE_SIZE);
+    if (p != start) {
+        Fail("growing the heap did not return the old break");
+    }
+    int i;
+    for (i = 0; i < 4 * PAGE_SIZE; i++) {
+        if (p[i] != 0) {
+            Fail("new heap memory does not read as zeroes");
+        }
+        p[i] = 1;
+    }
+
+    // Memory given back is dropped.
+    if (Sbrk(-2 * PAGE_SIZE) != start + 4 * PAGE_SIZE) {
+        Fail("shrinking the heap did not return the old break");
+    }
+    if (Sbrk(2 * PAGE_SIZE) != start + 2 * PAGE_SIZE) {
+        Fail("growing the heap again did not return the old break");
+    }
+    for (i = 0; i < 4 * PAGE_SIZE; i++) {
+        if (p[i] != (i < 2 * PAGE_SIZE)) {
+            Fail("memory given back was not dropped");
+        }
+    }
+
+    // Memory past the break is not part of the space any more.
+    SpaceId child = Fork(1);
+    if (child == 0) {
+        Sbrk(-2 * PAGE_SIZE);
+        p[3 * PAGE_SIZE] = 1;
+        Exit(0);
+    }
+    if (child < 0 || Join(child) == 0) {
+        Fail("touching memory past the break did not kill the process");
+    }
+
+    // Growing a page at a time stops, without harm, once swap is full.
+    int pages = 0;
+    while (Sbrk(PAGE_SIZE) != FAILED) {
+        pages++;
+    }
+    if (pages == 0 || Sbrk(-pages * PAGE_SIZE) == FAILED
+          || Sbrk(0) != start + 4 * PAGE_SIZE) {
+        Fail("the heap could not be grown to the size of swap and back");
+    }
+    if (malloc(1 << 19) != 0) {
+        Fail("malloc did not return 0 with no room left in swap");
+    }
+
+    puts2("sbrktest: ok\n");
+    Halt();
+    return 0;
+}
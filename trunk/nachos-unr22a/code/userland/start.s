@@ -85,6 +85,14 @@ Yield:
         j       $31
         .end    Yield
 
+        .globl  Sbrk
+        .ent    Sbrk
+Sbrk:
+        addiu   $2, $0, SC_SBRK
+        syscall
+        j       $31
+        .end    Sbrk
+
         .globl  Create
         .ent    Create
 Create:
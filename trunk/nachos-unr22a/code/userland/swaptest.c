@@ -0,0 +1,67 @@
+/// Test program for running out of swap.
+///
+/// The address space is much larger than the swap area, and the stack can
+/// grow down through all of it.  A forked child recurses until its stack
+/// takes more room than there is left in swap, and must be killed then,
+/// instead of bringing the kernel down.  The parent then checks that the
+/// room the child held is given back, by growing its heap and writing a few
+/// pages of it.
+
+
+#include "syscall.h"
+#include "lib.c"
+
+
+#define PAGE_SIZE     128
+#define FRAME_PAGES   4
+#define PARENT_PAGES  40
+
+/// Take `FRAME_PAGES` more pages of stack, writing every one, forever.
+static void
+Deepen(void)
+{
+    volatile char frame[FRAME_PAGES * PAGE_SIZE];
+    int i;
+    for (i = 0; i < FRAME_PAGES * PAGE_SIZE; i += PAGE_SIZE) {
+        frame[i] = 1;
+    }
+    Deepen();
+}
+
+int
+main(void)
+{
+    SpaceId child = Fork(1);
+    if (child < 0) {
+        puts2("swaptest: cannot fork\n");
+        Exit(1);
+    }
+    if (child == 0) {
+        Deepen();
+        Exit(0);  // Not reached: the space is larger than the swap area.
+    }
+
+    int status = Join(child);
+    char *heap = Sbrk(PARENT_PAGES * PAGE_SIZE);
+    char *p;
+    if (heap == (char *) -1) {
+        puts2("swaptest: the room held by the child was not given back\n");
+        Halt();
+    }
+    for (p = heap; p < heap + PARENT_PAGES * PAGE_SIZE; p += PAGE_SIZE) {
+        *p = 2;
+    }
+    for (p = heap; p < heap + PARENT_PAGES * PAGE_SIZE; p += PAGE_SIZE) {
+        if (*p != 2) {
+            puts2("swaptest: the parent lost a page\n");
+            Halt();
+        }
+    }
+    if (status != 0) {
+        puts2("swaptest: ok, the child was killed\n");
+    } else {
+        puts2("swaptest: the child was not killed\n");
+    }
+    Halt();
+    return 0;
+}
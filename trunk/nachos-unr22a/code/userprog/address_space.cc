@@ -15,11 +15,48 @@
 #include <limits.h>
 #include <stdio.h>
 
+
+#ifdef USE_TLB
+/// Space holding each address space identifier, or null if it is free.
+static AddressSpace *asidOwner[NUM_ASIDS];
+
+/// Where the search for an identifier to give out starts.
+static unsigned nextAsid;
+#endif
+
+/// Set up the page table entry of page `vpn`, unmapped, when its part of
+/// the table is first touched.
+static void
+InitEntry(TranslationEntry *entry, unsigned vpn)
+{
+    entry->virtualPage  = vpn;
+    entry->physicalPage = UINT_MAX;
+    entry->valid        = false;
+    entry->isInSwap     = false;
+    entry->use          = false;
+    entry->dirty        = false;
+    entry->readOnly     = false;
+}
+
+#ifdef SWAP
+static void
+InitSlot(unsigned *slot, unsigned vpn)
+{
+    *slot = SwapArea::NO_SLOT;
+}
+
+static void
+InitReserved(bool *reserved, unsigned vpn)
+{
+    *reserved = false;
+}
+#endif
+
 unsigned int AddressSpace::Translate(unsigned int virtualAddr)
 {
   uint32_t page = virtualAddr / PAGE_SIZE;
   uint32_t offset = virtualAddr % PAGE_SIZE;
-  uint32_t physicalPage = pageTable[page].physicalPage;
+  uint32_t physicalPage = pageTable->At(page).physicalPage;
   return physicalPage * PAGE_SIZE + offset;
 }
 
@@ -30,11 +67,31 @@ AddressSpace::AddressSpace(OpenFile *executable_file, int spaceId)
     Executable exe (executable_file);
     ASSERT(exe.CheckMagic());
     executableFile = executable_file;
+    executable = new Executable(exe);
+    executableCache->Add(executable->GetFileId(), executable);
+    firstFrame = Coremap::NO_FRAME;
+    residentFrames = 0;
+    id = spaceId;
+#ifdef USE_TLB
+    asid = NO_ASID;
+    tlbHits = tlbFaults = 0;
+    userTicks = 0;
+    running = false;
+#endif
 
     // How big is address space?
 
     unsigned size = exe.GetSize() + USER_STACK_SIZE;
       // We need to increase the size to leave room for the stack.
+#ifdef DEMAND_LOADING
+    // The stack goes at the top of a much larger space, and the pages in
+    // between are left for the heap and the stack to grow into.  None of
+    // them takes any memory until it is touched.
+    if (size < USER_SPACE_SIZE) {
+        size = USER_SPACE_SIZE;
+    }
+    heapStart = brk = DivRoundUp(exe.GetSize(), PAGE_SIZE) * PAGE_SIZE;
+#endif
     numPages = DivRoundUp(size, PAGE_SIZE);
     size = numPages * PAGE_SIZE;
 
@@ -47,92 +104,217 @@ AddressSpace::AddressSpace(OpenFile *executable_file, int spaceId)
     DEBUG('a', "Initializing address space, num pages %u, size %u\n",
           numPages, size);
 
-    // First, set up the translation.
+    // First, set up the translation.  With demand loading, entries are
+    // only filled in as pages are touched.
 
-    pageTable = new TranslationEntry[numPages];
+    pageTable = new PageTable(numPages, InitEntry);
+#ifndef DEMAND_LOADING
     for (unsigned i = 0; i < numPages; i++) {
-        pageTable[i].virtualPage  = i;
-#ifdef DEMAND_LOADING
-        pageTable[i].physicalPage = UINT_MAX;
-        pageTable[i].valid        = false;
-        pageTable[i].isInSwap     = false;
-#else
-        pageTable[i].physicalPage = pages->Find();
-        pageTable[i].valid        = true;
-#endif
-        pageTable[i].use          = false;
-        pageTable[i].dirty        = false;
-        pageTable[i].readOnly     = false;
-          // If the code segment was entirely on a separate page, we could
-          // set its pages to be read-only.
+        pageTable->At(i).physicalPage = pages->Find();
+        pageTable->At(i).valid        = true;
     }
+#endif
 
 #ifdef SWAP
     shouldSync = true;
-    swapFileName = new char[10];
-    sprintf(swapFileName, "/SWAP.%d", spaceId);
-    DEBUG('v', "Creating swap file %s\n", swapFileName);
-    fileSystem->Create(swapFileName, size);
-    swapFile = fileSystem->Open(swapFileName);
+    nextSwapIn = numPages;
+    readAheadWindow = 0;
+    swapSlots = new SparseTable<unsigned>(numPages, InitSlot);
+    swapReserved = new SparseTable<bool>(numPages, InitReserved);
+    numReservedSwap = 0;
+
+    // Pages that hold only code are the same in every process running the
+    // program, so they are shared, and read-only.
+    textPages = 0;
+    while (textPages < numPages
+             && executable->IsTextOnly(textPages * PAGE_SIZE, PAGE_SIZE)) {
+        pageTable->At(textPages++).readOnly = true;
+    }
+    coreMap->AddSpace(this);
+    text = nullptr;
+    if (textPages > 0) {
+        text = coreMap->AttachText(this, executable->GetFileId(), textPages);
+    }
+    family = nullptr;
 #endif
 #ifndef DEMAND_LOADING
     char *mainMemory = machine->GetMMU()->mainMemory;
 
-    // Zero out the entire address space, to zero the unitialized data
-    // segment and the stack segment.
-    // memset(mainMemory, 0, size);
-
+    // Fill every page straight from the executable: whatever the code and
+    // initialized data segments hold there, and zeroes for the uninitialized
+    // data and the stack.  Each page is translated once and takes one read
+    // per segment it overlaps.
+    DEBUG('a', "Initializing code segment, at 0x%X, size %u\n",
+          exe.GetCodeAddr(), exe.GetCodeSize());
+    DEBUG('a', "Initializing data segment, at 0x%X, size %u\n",
+          exe.GetInitDataAddr(), exe.GetInitDataSize());
     for (unsigned i = 0; i < numPages; i++) {
-        memset(&mainMemory[pageTable[i].physicalPage * PAGE_SIZE], 0, PAGE_SIZE);
-    }
-
-    // Then, copy in the code and data segments into memory.
-    uint32_t codeSize = exe.GetCodeSize();
-    uint32_t initDataSize = exe.GetInitDataSize();
-    if (codeSize > 0) {
-        unsigned i = 0;
-        uint32_t virtualAddr = exe.GetCodeAddr();
-        DEBUG('a', "Initializing code segment, at 0x%X, size %u\n", virtualAddr, codeSize);
-        while (i < codeSize) {
-            uint32_t addr = Translate(virtualAddr + i);
-            exe.ReadCodeBlock(&mainMemory[addr], 1, i);
-            i++;
-        }
+        unsigned frame = pageTable->At(i).physicalPage;
+        executable->ReadImage(&mainMemory[frame * PAGE_SIZE],
+                              i * PAGE_SIZE, PAGE_SIZE);
+        machine->GetMMU()->InvalidateDecoded(frame);
     }
-    if (initDataSize > 0) {
-        unsigned i = 0;
-        uint32_t virtualAddr = exe.GetInitDataAddr();
-        DEBUG('a', "Initializing data segment, at 0x%X, size %u\n", virtualAddr, initDataSize);
-        while (i < initDataSize) {
-            uint32_t addr = Translate(virtualAddr + i);
-            exe.ReadDataBlock(&mainMemory[addr], 1, i);
-            i++;
+#endif
+}
+
+#ifdef SWAP
+AddressSpace::AddressSpace(AddressSpace *parent, int spaceId)
+{
+    ASSERT(parent != nullptr && parent == currentThread->space);
+
+    // The executable file is never closed while pages are demand loaded
+    // from it, so both spaces can read from the same one.
+    executableFile = parent->executableFile;
+    executable = new Executable(*parent->executable);
+    firstFrame = Coremap::NO_FRAME;
+    residentFrames = 0;
+    numPages = parent->numPages;
+#ifdef DEMAND_LOADING
+    heapStart = parent->heapStart;
+    brk = parent->brk;
+#endif
+    shouldSync = true;
+    nextSwapIn = numPages;
+    readAheadWindow = 0;
+    textPages = parent->textPages;
+    id = spaceId;
+#ifdef USE_TLB
+    asid = NO_ASID;
+    tlbHits = tlbFaults = 0;
+    userTicks = 0;
+    running = false;
+
+    // Bring the `use` and `dirty` bits of the parent up to date, and drop
+    // its TLB entries, as its pages are about to be write protected.
+    parent->FlushTlb();
+#endif
+
+    DEBUG('a', "Forking address space, num pages %u\n", numPages);
+    coreMap->AddSpace(this);
+    pageTable = new PageTable(*parent->pageTable);
+    swapSlots = new SparseTable<unsigned>(*parent->swapSlots);
+    for (unsigned i = swapSlots->Next(0); i < numPages;
+           i = swapSlots->Next(i + 1)) {
+        if (swapSlots->At(i) != SwapArea::NO_SLOT) {
+            swapArea->ShareSlot(swapSlots->At(i));
         }
     }
-#endif
+    swapReserved = new SparseTable<bool>(*parent->swapReserved);
+    numReservedSwap = parent->numReservedSwap;
+    coreMap->ShareSpace(parent, this);
 }
+#endif
 
 /// Deallocate an address space.
 AddressSpace::~AddressSpace()
 {
+    if (pageTrace != nullptr) {
+        pageTrace->EndSpace(id);
+    }
+#ifdef USE_TLB
+    RecordStats();
+    if (asid != NO_ASID) {
+        FlushTlb();
+        asidOwner[asid] = nullptr;
+        asid = NO_ASID;
+    }
+#else
+    // The last translations may point into the table about to be freed.
+    if (machine->GetMMU()->pageTable == pageTable) {
+        machine->GetMMU()->pageTable = nullptr;
+    }
+    machine->GetMMU()->ForgetTranslations();
+#endif
 #ifndef SWAP
     shouldSync = false;
-    for (unsigned i = 0; i < numPages; i++)
-        pages->Clear(pageTable[i].physicalPage);
-#endif
-    delete [] pageTable;
-#ifndef DEMAND_LOADING
-    delete executableFile;
+    for (unsigned i = pageTable->Next(0); i < numPages;
+           i = pageTable->Next(i + 1)) {
+        if (pageTable->At(i).valid) {
+            pages->Clear(pageTable->At(i).physicalPage);
+        }
+    }
 #endif
+    delete executable;
 #ifdef SWAP
+    // Releasing shared frames looks up the page table.
     coreMap->Clear(this);
-    DEBUG('f', "Deleting swap file %s\n", swapFileName);
-    delete swapFile;
-    fileSystem->Remove(swapFileName);
-    delete[] swapFileName;
+    for (unsigned i = swapSlots->Next(0); i < numPages;
+           i = swapSlots->Next(i + 1)) {
+        if (swapSlots->At(i) != SwapArea::NO_SLOT) {
+            swapArea->FreeSlot(swapSlots->At(i));
+        }
+    }
+    delete swapSlots;
+    swapArea->Unreserve(numReservedSwap);
+    delete swapReserved;
 #endif
+    DEBUG('a', "Deleting address space, %u of %u page table leaves used\n",
+          pageTable->CountLeaves(),
+          DivRoundUp(numPages, PageTable::LEAF_SIZE));
+    delete pageTable;
 }
 
+#ifdef DEMAND_LOADING
+int
+AddressSpace::Sbrk(int increment, unsigned stackPointer)
+{
+    unsigned limit = stackPointer > USER_STACK_SIZE
+                       ? stackPointer - USER_STACK_SIZE : 0;
+    if (increment < 0 ? (unsigned) -increment > brk - heapStart
+                      : limit < brk || (unsigned) increment > limit - brk) {
+        DEBUG('a', "Cannot move the break at 0x%X by %d bytes\n",
+              brk, increment);
+        return -1;
+    }
+
+#ifdef SWAP
+    unsigned oldTop = DivRoundUp(brk, PAGE_SIZE);
+    unsigned newTop = DivRoundUp(brk + increment, PAGE_SIZE);
+    if (increment > 0) {
+        // Each page the heap grows over must find room in swap when it is
+        // written out, so the room is taken now, or the heap does not grow.
+        unsigned missing = 0;
+        for (unsigned vpn = oldTop; vpn < newTop; vpn++) {
+            const bool *reserved = swapReserved->Find(vpn);
+            if (reserved == nullptr || !*reserved) {
+                missing++;
+            }
+        }
+        if (!swapArea->Reserve(missing)) {
+            DEBUG('a', "No room left in swap for %u more heap pages\n",
+                  missing);
+            return -1;
+        }
+        for (unsigned vpn = oldTop; vpn < newTop; vpn++) {
+            swapReserved->At(vpn) = true;
+        }
+        numReservedSwap += missing;
+    } else {
+        for (unsigned vpn = newTop; vpn < oldTop; vpn++) {
+            ReleasePage(vpn);
+        }
+    }
+#endif
+
+    unsigned old = brk;
+    brk += increment;
+    DEBUG('a', "Break moved from 0x%X to 0x%X\n", old, brk);
+    return old;
+}
+
+bool
+AddressSpace::IsInUse(unsigned vpn, unsigned stackPointer) const
+{
+    if (vpn >= numPages) {
+        return false;
+    }
+    unsigned limit = stackPointer > USER_STACK_SIZE
+                       ? stackPointer - USER_STACK_SIZE : 0;
+    return vpn < DivRoundUp(brk, PAGE_SIZE)
+           || (vpn + 1) * PAGE_SIZE > limit;
+}
+#endif
+
 /// Set the initial values for the user-level register set.
 ///
 /// We write these directly into the “machine” registers, so that we can
@@ -164,90 +346,192 @@ AddressSpace::InitRegisters()
 /// On a context switch, save any machine state, specific to this address
 /// space, that needs saving.
 ///
-/// For now, nothing!
+/// TLB entries are tagged with the space they belong to, so they are left
+/// in the TLB for the next time the space runs; only the page "hits" and
+/// faults of this run are added up.
 void
-AddressSpace::SaveState() {
-#ifdef SWAP
-    for (unsigned i=0; i<TLB_SIZE; ++i)
-        SyncTlbEntry(i);
+AddressSpace::SaveState()
+{
+#ifdef USE_TLB
+    tlbHits   += stats->numPageHits   - hitsMark;
+    tlbFaults += stats->numPageFaults - faultsMark;
+    userTicks += stats->userTicks     - ticksMark;
+    running = false;
 #endif
 }
 
 #ifdef USE_TLB
 void
-invalidateTLB() {
-    for (unsigned i = 0; i<TLB_SIZE;++i)
-        machine->GetMMU()->tlb[i].valid = false;
+AddressSpace::RecordStats()
+{
+    if (running) {
+        SaveState();
+    }
+    stats->processPaging.push_back({id, tlbHits, tlbFaults});
+}
+
+unsigned long long
+AddressSpace::GetUserTicks() const
+{
+    return running ? userTicks + stats->userTicks - ticksMark : userTicks;
+}
+
+void
+AddressSpace::AcquireAsid()
+{
+    ASSERT(asid == NO_ASID);
+
+    unsigned i = 0;
+    while (i < NUM_ASIDS && asidOwner[(nextAsid + i) % NUM_ASIDS] != nullptr) {
+        i++;
+    }
+    if (i == NUM_ASIDS) {
+        i = 0;
+    }
+    asid = (nextAsid + i) % NUM_ASIDS;
+    nextAsid = (asid + 1) % NUM_ASIDS;
+
+    AddressSpace *victim = asidOwner[asid];
+    if (victim != nullptr) {
+        DEBUG('v', "Recycling ASID %u\n", asid);
+        victim->FlushTlb();
+        victim->asid = NO_ASID;
+        stats->numAsidRecycles++;
+    }
+    asidOwner[asid] = this;
+}
+
+void
+AddressSpace::FlushTlb()
+{
+    TranslationEntry *tlb = machine->GetMMU()->tlb;
+    for (unsigned i = 0; i < machine->GetMMU()->GetTlbSize(); i++) {
+        if (tlb[i].valid && tlb[i].asid == asid) {
+            SyncTlbEntry(i);
+        }
+    }
 }
 #endif
 
 /// On a context switch, restore the machine state so that this address space
 /// can run.
+///
+/// With a TLB, this only takes an address space identifier, the first time
+/// the space runs or if it was given to another space meanwhile; there is
+/// no need to invalidate anything.
 void
 AddressSpace::RestoreState()
 {
+    if (pageTrace != nullptr) {
+        pageTrace->SetSpace(id);
+    }
 #ifdef USE_TLB
-    invalidateTLB();
+    if (asid == NO_ASID) {
+        AcquireAsid();
+    }
+    machine->GetMMU()->currentAsid = asid;
+    if (!running) {
+        hitsMark   = stats->numPageHits;
+        faultsMark = stats->numPageFaults;
+        ticksMark  = stats->userTicks;
+        running = true;
+    }
 #else
-    machine->GetMMU()->pageTable     = pageTable;
-    machine->GetMMU()->pageTableSize = numPages;
+    // The last translations may belong to the table of another space.
+    machine->GetMMU()->pageTable = pageTable;
+    machine->GetMMU()->ForgetTranslations();
 #endif
 }
 
 TranslationEntry
 AddressSpace::GetPageTableEntry(unsigned vpn) {
-    return pageTable[vpn];
+    return pageTable->At(vpn);
 }
 
-TranslationEntry
-AddressSpace::LoadPage(unsigned vpnadd, unsigned frame) {
-    unsigned vpn = vpnadd * PAGE_SIZE;
-    ASSERT(vpn >= 0);
-    Executable exe (executableFile);
-    uint32_t physicalAddressToWrite = frame * PAGE_SIZE;
-    DEBUG('v', "Loading Page Frame %lu from file\n", frame);
-
-    char *mainMemory = machine->GetMMU()->mainMemory;
-    memset(&mainMemory[physicalAddressToWrite], 0, PAGE_SIZE);
-
-    unsigned readed = 0;
-
-    uint32_t codeSize = exe.GetCodeSize();
-    uint32_t initDataSize = exe.GetInitDataSize();
-    uint32_t virtualDataAddr = exe.GetInitDataAddr();
-
-    if (codeSize > 0 && vpn < codeSize) {
-        uint32_t toRead = (codeSize - vpn) < PAGE_SIZE ? (codeSize - vpn) : PAGE_SIZE;
-
-        exe.ReadCodeBlock(&mainMemory[physicalAddressToWrite], toRead, vpn);
+void
+AddressSpace::MapPage(unsigned vpn, unsigned frame)
+{
+    TranslationEntry &entry = pageTable->At(vpn);
+    entry.valid = true;
+    entry.isInSwap = false;
+    entry.dirty = false;
+    entry.use = false;
+    entry.physicalPage = frame;
+}
 
-        readed += toRead; 
+#ifdef SWAP
+bool
+AddressSpace::CanFaultAround(unsigned vpn)
+{
+    if (vpn >= numPages) {
+        return false;
     }
+    const TranslationEntry *entry = pageTable->Find(vpn);
+    return (entry == nullptr || (!entry->valid && !entry->isInSwap))
+           && !IsSharedText(vpn)
+           && executable->IsInFile(vpn * PAGE_SIZE, PAGE_SIZE);
+}
+#endif
 
-    if (initDataSize > 0 && vpn + readed < virtualDataAddr + initDataSize &&
-        readed != PAGE_SIZE) {
-
-        uint32_t toRead = (virtualDataAddr + initDataSize - vpn) < PAGE_SIZE ?
-                                (virtualDataAddr + initDataSize) - (vpn + readed)
-                            :
-                                PAGE_SIZE - readed;
-
-        readed ? 
-            exe.ReadDataBlock(&mainMemory[physicalAddressToWrite + readed], toRead,  0)
-        :
-            exe.ReadDataBlock(&mainMemory[physicalAddressToWrite], toRead, vpn - codeSize);
+TranslationEntry
+AddressSpace::LoadPage(unsigned vpn, unsigned frame)
+{
+    DEBUG('v', "Loading Page Frame %lu from file\n", frame);
+    unsigned first = vpn, last = vpn;
 
-        readed += toRead; 
+#ifdef SWAP
+    // Fault around: bring in the neighbouring pages that come from the
+    // file too, so that they all take a single read.  Only spare frames are
+    // used, nothing is evicted for them, and each takes room in swap like
+    // any loaded page.  Pages after `vpn` go first, as code tends to run
+    // forward.
+    if (executable->IsInFile(vpn * PAGE_SIZE, PAGE_SIZE)) {
+        unsigned budget = faultAroundPages;
+        for (; budget > 0 && CanFaultAround(last + 1)
+               && ReserveSwap(last + 1); budget--) {
+            unsigned f = coreMap->TakeSpareFrame(this, last + 1);
+            if (f == Coremap::NO_FRAME) {
+                break;
+            }
+            pageTable->At(++last).physicalPage = f;
+        }
+        for (; budget > 0 && first > 0 && CanFaultAround(first - 1)
+               && ReserveSwap(first - 1); budget--) {
+            unsigned f = coreMap->TakeSpareFrame(this, first - 1);
+            if (f == Coremap::NO_FRAME) {
+                break;
+            }
+            pageTable->At(--first).physicalPage = f;
+        }
+        pageTable->At(vpn).physicalPage = frame;
     }
+#endif
 
-    if (vpn > codeSize + initDataSize) 
-        readed = PAGE_SIZE;
-    pageTable[vpnadd].valid = true;
-    pageTable[vpnadd].isInSwap = false;
-    pageTable[vpnadd].dirty = false;
-    pageTable[vpnadd].use = false;
-    pageTable[vpnadd].physicalPage = frame;
-    return pageTable[vpnadd];
+    char *mainMemory = machine->GetMMU()->mainMemory;
+    unsigned count = last - first + 1;
+    char *buffer = count == 1 ? &mainMemory[frame * PAGE_SIZE]
+                              : new char [count * PAGE_SIZE];
+    executable->ReadImage(buffer, first * PAGE_SIZE, count * PAGE_SIZE);
+
+    for (unsigned page = first; page <= last; page++) {
+        unsigned f = page == vpn ? frame : pageTable->At(page).physicalPage;
+        if (count > 1) {
+            memcpy(&mainMemory[f * PAGE_SIZE],
+                   &buffer[(page - first) * PAGE_SIZE], PAGE_SIZE);
+        }
+        machine->GetMMU()->InvalidateDecoded(f);
+        MapPage(page, f);
+#ifdef SWAP
+        if (page != vpn) {
+            coreMap->Unpin(f);
+        }
+#endif
+    }
+    if (count > 1) {
+        delete [] buffer;
+        stats->numFaultAroundPages += count - 1;
+    }
+    return pageTable->At(vpn);
 }
 
 #ifdef SWAP
@@ -257,55 +541,313 @@ AddressSpace::LoadFromSwap(unsigned vpn, unsigned physIndex)
 {
     DEBUG('v', "Loading from the swap \n");
     char *mainMemory = machine->GetMMU()->mainMemory;
-    swapFile->ReadAt(&mainMemory[physIndex * PAGE_SIZE], PAGE_SIZE, PAGE_SIZE * vpn);
+    swapArea->ReadSlot(swapSlots->At(vpn),
+                       &mainMemory[physIndex * PAGE_SIZE]);
+    machine->GetMMU()->InvalidateDecoded(physIndex);
+
+    // The slot still holds what is read: the page is clean until written.
+    pageTable->At(vpn).valid = true;
+    pageTable->At(vpn).dirty = false;
+    pageTable->At(vpn).physicalPage = physIndex;
+
+    // Read ahead: a swap-in right after the last one doubles the window of
+    // pages that are read along with it, anything else closes it.
+    if (vpn == nextSwapIn) {
+        readAheadWindow = readAheadWindow == 0 ? 1 : 2 * readAheadWindow;
+        if (readAheadWindow > maxReadAheadPages) {
+            readAheadWindow = maxReadAheadPages;
+        }
+    } else {
+        readAheadWindow = 0;
+    }
+    unsigned page = vpn + 1;
+    for (; page <= vpn + readAheadWindow && page < numPages; page++) {
+        TranslationEntry *entry = pageTable->Find(page);
+        if (entry == nullptr || entry->valid || !entry->isInSwap) {
+            break;
+        }
+        unsigned f = coreMap->TakeSpareFrame(this, page);
+        if (f == Coremap::NO_FRAME) {
+            break;
+        }
+        swapArea->ReadSlot(swapSlots->At(page), &mainMemory[f * PAGE_SIZE]);
+        entry->valid = true;
+        entry->dirty = false;
+        entry->use = false;
+        entry->physicalPage = f;
+        coreMap->Unpin(f);
+        stats->numReadAheadPages++;
+    }
+    nextSwapIn = page;
 
-    pageTable[vpn].valid = true;
-    pageTable[vpn].physicalPage = physIndex;
-    return pageTable[vpn];
+    return pageTable->At(vpn);
 }
 
+#ifdef USE_TLB
 void
 AddressSpace::SyncTlbEntry(unsigned entry)
 {
     DEBUG('v', "Synching from TLB \n");
     TranslationEntry* tlb = machine->GetMMU()->tlb;
-    if (shouldSync && tlb[entry].valid) {
-        pageTable[tlb[entry].virtualPage].dirty = tlb[entry].dirty;
-        pageTable[tlb[entry].virtualPage].use = tlb[entry].use;
+    if (!tlb[entry].valid) {
+        return;
+    }
+
+    AddressSpace *owner = asidOwner[tlb[entry].asid];
+    ASSERT(owner != nullptr);
+    if (owner->shouldSync) {
+        TranslationEntry &e = owner->pageTable->At(tlb[entry].virtualPage);
+        e.dirty = tlb[entry].dirty;
+        // The bit may have been cleared by `ClearTlbUse` since.
+        e.use |= tlb[entry].use;
     }
 
     tlb[entry].valid = false;
 }
 
-unsigned
-AddressSpace::GetPhysicalPageIndex(unsigned victim) {
-    for (unsigned i=0; i < numPages; ++i)
-        if (pageTable[i].physicalPage == victim) return i;
-    ASSERT(false);
-    return 0;
+void
+AddressSpace::ClearTlbUse()
+{
+    TranslationEntry *tlb = machine->GetMMU()->tlb;
+    for (unsigned i = 0; i < machine->GetMMU()->GetTlbSize(); i++) {
+        if (tlb[i].valid && tlb[i].use) {
+            AddressSpace *owner = asidOwner[tlb[i].asid];
+            ASSERT(owner != nullptr);
+            owner->pageTable->At(tlb[i].virtualPage).use = true;
+            tlb[i].use = false;
+        }
+    }
+}
+#endif
+
+bool
+AddressSpace::TestAndClearUse(unsigned vpn)
+{
+    bool used = pageTable->At(vpn).use;
+    pageTable->At(vpn).use = false;
+
+#ifdef USE_TLB
+    TranslationEntry *tlb = machine->GetMMU()->tlb;
+    for (unsigned i = 0; i < machine->GetMMU()->GetTlbSize(); ++i) {
+        if (tlb[i].valid && tlb[i].asid == asid
+              && tlb[i].virtualPage == vpn) {
+            used = used || tlb[i].use;
+            tlb[i].use = false;
+        }
+    }
+#endif
+    return used;
 }
 
 void
-AddressSpace::SwapPage(unsigned vpn) 
+AddressSpace::DropPage(unsigned vpn, unsigned frame)
 {
-    pageTable[vpn].valid = false;
-    coreMap->ClearPageIndex(pageTable[vpn].physicalPage);
-    
-    if (currentThread->space == this) {
-        TranslationEntry *tlb = machine->GetMMU()->tlb;
+    ASSERT(pageTable->At(vpn).physicalPage == frame);
+    pageTable->At(vpn).valid = false;
 
-        for(unsigned i=0; i<TLB_SIZE; ++i)
-            if(tlb[i].valid && tlb[i].physicalPage == pageTable[vpn].physicalPage)
-                SyncTlbEntry(i);
+#ifdef USE_TLB
+    TranslationEntry *tlb = machine->GetMMU()->tlb;
+    for (unsigned i = 0; i < machine->GetMMU()->GetTlbSize(); ++i) {
+        if (tlb[i].valid && tlb[i].asid == asid
+              && tlb[i].physicalPage == frame) {
+            SyncTlbEntry(i);
+        }
     }
-    
-    if (pageTable[vpn].dirty) {
+#endif
+
+    pageTable->At(vpn).physicalPage = UINT_MAX;
+}
+
+bool
+AddressSpace::IsCopyOnWrite(unsigned vpn) const
+{
+    if (vpn >= numPages) {
+        return false;
+    }
+    const TranslationEntry *entry = pageTable->Find(vpn);
+    return entry != nullptr && entry->valid && entry->readOnly
+           && !IsSharedText(vpn)
+           && entry->physicalPage != coreMap->GetZeroFrame();
+}
+
+TranslationEntry
+AddressSpace::CopyOnWrite(unsigned vpn)
+{
+    ASSERT(IsCopyOnWrite(vpn));
+    unsigned frame = coreMap->CopyOnWrite(this, vpn);
+    DEBUG('v', "Page %u copied on write into frame %u\n", vpn, frame);
+
+#ifdef USE_TLB
+    // The TLB still maps the shared frame read-only.
+    TranslationEntry *tlb = machine->GetMMU()->tlb;
+    for (unsigned i = 0; i < machine->GetMMU()->GetTlbSize(); ++i) {
+        if (tlb[i].valid && tlb[i].asid == asid
+              && tlb[i].virtualPage == vpn) {
+            tlb[i].valid = false;
+        }
+    }
+#endif
+    pageTable->At(vpn).physicalPage = frame;
+    pageTable->At(vpn).readOnly = false;
+    coreMap->Unpin(frame);
+    return pageTable->At(vpn);
+}
+
+bool
+AddressSpace::IsZeroFill(unsigned vpn) const
+{
+    if (vpn >= numPages) {
+        return false;
+    }
+    const TranslationEntry *entry = pageTable->Find(vpn);
+    return (entry == nullptr || (!entry->valid && !entry->isInSwap))
+           && !executable->IsInFile(vpn * PAGE_SIZE, PAGE_SIZE);
+}
+
+TranslationEntry
+AddressSpace::MapZeroPage(unsigned vpn)
+{
+    ASSERT(IsZeroFill(vpn));
+    MapPage(vpn, coreMap->GetZeroFrame());
+    pageTable->At(vpn).readOnly = true;
+    stats->numZeroPageMaps++;
+    DEBUG('v', "Page %u mapped to the zero frame\n", vpn);
+    return pageTable->At(vpn);
+}
+
+bool
+AddressSpace::IsZeroPage(unsigned vpn) const
+{
+    if (vpn >= numPages) {
+        return false;
+    }
+    const TranslationEntry *entry = pageTable->Find(vpn);
+    return entry != nullptr && entry->valid
+           && entry->physicalPage == coreMap->GetZeroFrame();
+}
+
+TranslationEntry
+AddressSpace::FillZeroPage(unsigned vpn)
+{
+    ASSERT(IsZeroPage(vpn));
+
+#ifdef USE_TLB
+    // The TLB still maps the zero frame read-only.
+    TranslationEntry *tlb = machine->GetMMU()->tlb;
+    for (unsigned i = 0; i < machine->GetMMU()->GetTlbSize(); ++i) {
+        if (tlb[i].valid && tlb[i].asid == asid
+              && tlb[i].virtualPage == vpn) {
+            tlb[i].valid = false;
+        }
+    }
+#endif
+    // Taking a frame may block; until then the page keeps reading as
+    // zeroes.
+    unsigned frame = coreMap->ReplacePage(this, vpn);
+    char *mainMemory = machine->GetMMU()->mainMemory;
+    memset(&mainMemory[frame * PAGE_SIZE], 0, PAGE_SIZE);
+    MapPage(vpn, frame);
+    pageTable->At(vpn).readOnly = false;
+    coreMap->Unpin(frame);
+    stats->numZeroPageCopies++;
+    DEBUG('v', "Page %u of zeroes copied on write into frame %u\n",
+          vpn, frame);
+    return pageTable->At(vpn);
+}
+
+TranslationEntry
+AddressSpace::LoadTextPage(unsigned vpn)
+{
+    bool load;
+    unsigned frame = coreMap->GetTextFrame(text, vpn, &load);
+    if (load) {
+        DEBUG('v', "Loading shared code page %u into frame %u\n", vpn, frame);
+        char *mainMemory = machine->GetMMU()->mainMemory;
+        executable->ReadImage(&mainMemory[frame * PAGE_SIZE],
+                              vpn * PAGE_SIZE, PAGE_SIZE);
+        machine->GetMMU()->InvalidateDecoded(frame);
+        coreMap->TextLoaded(frame);
+        stats->numPageIns++;
+    } else {
+        stats->numSharedTextHits++;
+    }
+    MapPage(vpn, frame);
+    coreMap->Unpin(frame);
+    return pageTable->At(vpn);
+}
+
+void
+AddressSpace::SwapPage(unsigned vpn, unsigned frame, bool dirty)
+{
+    DropPage(vpn, frame);
+
+    if (dirty) {
+        // A slot shared with a forked space still holds its copy.
+        unsigned &slot = swapSlots->At(vpn);
+        if (slot != SwapArea::NO_SLOT && swapArea->IsShared(slot)) {
+            swapArea->FreeSlot(slot);
+            slot = SwapArea::NO_SLOT;
+        }
+        if (slot == SwapArea::NO_SLOT) {
+            slot = swapArea->AllocateSlot();
+            ASSERT(slot != SwapArea::NO_SLOT);  // The page holds room.
+        }
+        // Mark it first: writing may block, and a fault on the page must
+        // not reload it from the executable meanwhile.  The space may also
+        // be deleted while the page cleaner waits here, so it must not be
+        // touched afterwards.
+        pageTable->At(vpn).isInSwap = true;
         char *mainMemory = machine->GetMMU()->mainMemory;
-        swapFile->WriteAt(&mainMemory[pageTable[vpn].physicalPage * PAGE_SIZE], PAGE_SIZE, PAGE_SIZE * vpn);
-        pageTable[vpn].isInSwap = true;
-        DEBUG('v', "Swap saved %lu \n", pageTable[vpn].physicalPage);
+        swapArea->WriteSlot(slot, &mainMemory[frame * PAGE_SIZE]);
+        DEBUG('v', "Swap saved %lu \n", frame);
+    }
+}
+
+void
+AddressSpace::ReleasePage(unsigned vpn)
+{
+    unsigned frame = UINT_MAX;
+    TranslationEntry *entry = pageTable->Find(vpn);
+    if (entry != nullptr) {
+        if (entry->valid) {
+            frame = entry->physicalPage;
+            DropPage(vpn, frame);
+        }
+        entry->isInSwap = false;
+        entry->readOnly = false;
+    }
+    unsigned *slot = swapSlots->Find(vpn);
+    if (slot != nullptr && *slot != SwapArea::NO_SLOT) {
+        swapArea->FreeSlot(*slot);
+        *slot = SwapArea::NO_SLOT;
+    }
+    bool *reserved = swapReserved->Find(vpn);
+    if (reserved != nullptr && *reserved) {
+        *reserved = false;
+        numReservedSwap--;
+        swapArea->Unreserve(1);
+    }
+
+    // Last, as waking threads that wait for a frame may switch threads.
+    if (frame != UINT_MAX) {
+        coreMap->Release(this, frame);
+    }
+    DEBUG('v', "Page %u released\n", vpn);
+}
+
+bool
+AddressSpace::ReserveSwap(unsigned vpn)
+{
+    bool &reserved = swapReserved->At(vpn);
+    if (!reserved) {
+        if (!swapArea->Reserve(1)) {
+            DEBUG('v', "No room left in swap for page %u\n", vpn);
+            return false;
+        }
+        reserved = true;
+        numReservedSwap++;
     }
-    pageTable[vpn].physicalPage = UINT_MAX;
+    return true;
 }
 
 #endif
\ No newline at end of file
@@ -18,10 +18,26 @@
 #include "machine/translation_entry.hh"
 
 
+class Executable;
+struct SharedText;
+struct ForkFamily;
+
+
 const unsigned USER_STACK_SIZE = 1024;  ///< Increase this as necessary!
 
+#ifdef DEMAND_LOADING
+/// Size of the virtual address space of every process, with the stack at
+/// the top.  Pages only take page table entries, frames and swap slots once
+/// touched, so the space a program can use is bounded by the swap area.
+/// Only the program, the heap and the stack are in use, though: touching
+/// the pages between the break and the stack is an address error, cf.
+/// `AddressSpace::IsInUse`.
+const unsigned USER_SPACE_SIZE = 1 << 20;
+#endif
+
 
 class AddressSpace {
+    friend class Coremap;
 public:
 
     /// Create an address space to run a user program.
@@ -36,6 +52,16 @@ public:
     ///   program; it contains the object code to load into memory.
     AddressSpace(OpenFile *executable_file, int spaceId);
 
+#ifdef SWAP
+    /// Create a copy of `parent`, for a forked process.
+    ///
+    /// Nothing is copied but the page table: both spaces share every frame
+    /// and swap slot, and a frame is only copied once either of them writes
+    /// it.  `parent` must be the running space, and the caller must have
+    /// reserved as much swap as it holds, see `CountReservedSwap`.
+    AddressSpace(AddressSpace *parent, int spaceId);
+#endif
+
     /// De-allocate an address space.
     ~AddressSpace();
 
@@ -49,34 +75,222 @@ public:
 
     TranslationEntry GetPageTableEntry(unsigned vpn);
 
-    TranslationEntry LoadPage(unsigned vpn, unsigned frame);
+    /// Number of pages in the virtual address space.
+    unsigned GetNumPages() const
+    {
+        return numPages;
+    }
+
+#ifdef DEMAND_LOADING
+    /// Move the break, the end of the heap, by `increment` bytes, and
+    /// return where it was; or -1, leaving it, if it would go below the
+    /// start of the heap or within `USER_STACK_SIZE` bytes of
+    /// `stackPointer`, or if swap has no room left for the pages it grows
+    /// over.  Heap pages only take memory once touched, and the pages it
+    /// shrinks off are dropped.
+    int Sbrk(int increment, unsigned stackPointer);
+
+    /// Whether page `vpn` belongs to the program, to the heap below the
+    /// break, or to the stack, which may grow down to `USER_STACK_SIZE`
+    /// bytes below `stackPointer`.  The pages in between are not part of
+    /// the space, and touching them is an address error.
+    bool IsInUse(unsigned vpn, unsigned stackPointer) const;
+#endif
 
-    unsigned GetPhysicalPageIndex(unsigned victim);
+#ifdef USE_TLB
+    /// Marks a space that has no address space identifier.
+    static const unsigned NO_ASID = ~0U;
+
+    /// Identifier that the TLB entries of this space are tagged with.  Only
+    /// guaranteed to be valid while the space is running.
+    unsigned GetAsid() const
+    {
+        return asid;
+    }
+
+    /// Add the page "hits" and faults counted for this space to the
+    /// statistics of finished processes.  Called when it is destroyed, or
+    /// when it halts the machine.
+    void RecordStats();
+
+    /// User ticks the process has run for, its virtual time.
+    unsigned long long GetUserTicks() const;
+
+    /// Copy the `use` and `dirty` bits of TLB entry `entry` back into the
+    /// page table of the space that owns it, and invalidate it.
+    static void SyncTlbEntry(unsigned entry);
+
+    /// Clear the `use` bit of every TLB entry, keeping it in the page table
+    /// of the space that owns the entry.
+    static void ClearTlbUse();
+#endif
+
+    /// Load page `vpn` from the executable into `frame`.  With swapping,
+    /// neighbouring pages of the file are also loaded into spare frames,
+    /// up to `faultAroundPages` of them.
+    TranslationEntry LoadPage(unsigned vpn, unsigned frame);
 
 #ifdef SWAP
-    void SwapPage(unsigned vpn);
+    /// Evict page `vpn`, which is held in `frame`, saving it to swap if
+    /// it is `dirty`.
+    void SwapPage(unsigned vpn, unsigned frame, bool dirty);
+
+    /// Make sure that page `vpn` finds a swap slot whenever it is evicted,
+    /// reserving room for it the first time.  Return false if the swap
+    /// area is full.
+    bool ReserveSwap(unsigned vpn);
+
+    /// Number of pages of the space that hold room in swap.
+    unsigned CountReservedSwap() const
+    {
+        return numReservedSwap;
+    }
 
+    /// Load page `vpn` from swap into `physIndex`.  Runs of faults on
+    /// consecutive pages also read the following pages in swap, up to
+    /// `maxReadAheadPages` of them.
     TranslationEntry LoadFromSwap(unsigned vpn, unsigned physIndex);
 
-    void SyncTlbEntry(unsigned entry);
+    /// Tell whether page `vpn` was referenced since the last call, and
+    /// clear its `use` bit, both in the page table and in the TLB.
+    bool TestAndClearUse(unsigned vpn);
+
+    /// Whether page `vpn` holds only code, shared with every other space
+    /// running the same executable.
+    bool IsSharedText(unsigned vpn) const
+    {
+        return text != nullptr && vpn < textPages;
+    }
+
+    /// Map shared code page `vpn`, reading it in unless some other space
+    /// already did.
+    TranslationEntry LoadTextPage(unsigned vpn);
+
+    /// Whether page `vpn` is mapped to `frame`.
+    bool MapsPage(unsigned vpn, unsigned frame) const
+    {
+        const TranslationEntry *entry = pageTable->Find(vpn);
+        return entry != nullptr && entry->valid
+               && entry->physicalPage == frame;
+    }
+
+    /// Unmap page `vpn` from `frame`, in the page table and in the TLB.
+    void DropPage(unsigned vpn, unsigned frame);
+
+    /// Whether page `vpn` is shared with a forked space until written.
+    bool IsCopyOnWrite(unsigned vpn) const;
+
+    /// Give page `vpn`, which is being written, a frame of its own.
+    TranslationEntry CopyOnWrite(unsigned vpn);
+
+    /// Whether page `vpn`, which is not loaded, starts out as zeroes: it is
+    /// neither in swap nor in the executable.
+    bool IsZeroFill(unsigned vpn) const;
+
+    /// Map page `vpn`, which starts out as zeroes, to the shared zero
+    /// frame, read-only.
+    TranslationEntry MapZeroPage(unsigned vpn);
+
+    /// Whether page `vpn` is mapped to the shared zero frame.
+    bool IsZeroPage(unsigned vpn) const;
+
+    /// Give page `vpn`, mapped to the zero frame and being written, a
+    /// zeroed frame of its own.
+    TranslationEntry FillZeroPage(unsigned vpn);
 #endif
 private:
 
     unsigned int Translate(unsigned int virtualAddr);
 
+    /// Mark page `vpn` as freshly loaded into `frame`.
+    void MapPage(unsigned vpn, unsigned frame);
+
+#ifdef SWAP
+    /// Whether page `vpn` can be loaded along with a neighbour.
+    bool CanFaultAround(unsigned vpn);
+
+    /// Drop page `vpn`, freeing its frame, its swap slot and its room in
+    /// swap, so that it reads as zeroes again.
+    void ReleasePage(unsigned vpn);
+#endif
+
+#ifdef USE_TLB
+    /// Take an address space identifier, recycling the one given out
+    /// longest ago if none is free.
+    void AcquireAsid();
+
+    /// Sync and invalidate every TLB entry of this space.
+    void FlushTlb();
+
+    unsigned asid;
+
+    /// Page "hits", faults and user ticks counted while the space ran, and
+    /// the global counts when it was last switched in, if it is `running`.
+    unsigned long tlbHits;
+    unsigned long tlbFaults;
+    unsigned long long userTicks;
+    unsigned long hitsMark;
+    unsigned long faultsMark;
+    unsigned long long ticksMark;
+    bool running;
+#endif
+
+    /// Identifier of the process running in the space.
+    int id;
+
     bool shouldSync;
 
-    /// Assume linear page table translation for now!
-    TranslationEntry *pageTable;
+    /// Two levels, so that the pages never touched take no memory.
+    PageTable *pageTable;
 
     /// Number of pages in the virtual address space.
     unsigned numPages;
 
+#ifdef DEMAND_LOADING
+    /// Start of the heap, the first page after the program, and the break.
+    unsigned heapStart;
+    unsigned brk;
+#endif
+
     OpenFile *executableFile;
 
-    char* swapFileName;
+    /// Layout of the program, parsed once when the space is created.
+    Executable *executable;
+
+    /// Swap slot of each page, allocated the first time it is written out.
+    SparseTable<unsigned> *swapSlots;
+
+    /// Pages that hold room in the swap area, and how many.
+    SparseTable<bool> *swapReserved;
+    unsigned numReservedSwap;
+
+    /// First of the frames owned by this space, chained by the coremap,
+    /// and how many there are.
+    unsigned firstFrame;
+    unsigned residentFrames;
+
+    /// Frames the space may own before its faults replace its own pages,
+    /// when the coremap keeps quotas, and its virtual time at its last
+    /// page-in, to tell its page-fault frequency.
+    unsigned frameQuota;
+    unsigned long long lastFaultTime;
+
+    /// Page whose swap-in would continue a sequential run, and number of
+    /// pages to read ahead on it.
+    unsigned nextSwapIn;
+    unsigned readAheadWindow;
+
+    /// Code shared with other spaces: its first `textPages` pages, if
+    /// `text` is not null.  Spaces sharing the same code are chained by
+    /// the coremap through `nextTextUser`.
+    SharedText *text;
+    unsigned textPages;
+    AddressSpace *nextTextUser;
 
-    OpenFile *swapFile;
+    /// Spaces forked from this one, or from which it was forked, chained by
+    /// the coremap through `nextInFamily`; null until the first fork.
+    ForkFamily *family;
+    AddressSpace *nextInFamily;
 };
 
 
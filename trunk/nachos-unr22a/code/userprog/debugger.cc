@@ -20,7 +20,7 @@ typedef DebuggerCommandManager DCM;
 static inline void
 PrintPrompt()
 {
-    const char PROMPT[] = "%lu> ";
+    const char PROMPT[] = "%llu> ";
 
     printf(PROMPT, stats->totalTicks);
     fflush(stdout);
@@ -133,8 +133,9 @@ CommandDump(char **args, void *extra)
         return DCM::RUN_RESULT_STAY;
     }
 
-    int rv = fwrite(machine->GetMMU()->mainMemory, 1, MEMORY_SIZE, f);
-    if (rv != MEMORY_SIZE) {
+    unsigned size = machine->GetMMU()->GetMemorySize();
+    unsigned rv = fwrite(machine->GetMMU()->mainMemory, 1, size, f);
+    if (rv != size) {
         fprintf(stderr, "ERROR: write to file `%s` did not succeed.\n",
                 path);
         return DCM::RUN_RESULT_STAY;
@@ -213,7 +214,7 @@ CommandPrint(char **args, void *extra)
             }
 
         } else if (strcmp(end, "@p") == 0) {
-            if (address >= MEMORY_SIZE) {
+            if (address >= machine->GetMMU()->GetMemorySize()) {
                 fprintf(stderr, "ERROR: address %u is too big.\n", address);
                 return DCM::RUN_RESULT_STAY;
             }
@@ -280,7 +281,7 @@ CommandTick(char **args, void *runUntilTime_)
         return DCM::RUN_RESULT_STAY;
     }
 
-    unsigned *runUntilTime = (unsigned *) runUntilTime_;
+    unsigned long long *runUntilTime = (unsigned long long *) runUntilTime_;
     *runUntilTime = stats->totalTicks + num;
     return DCM::RUN_RESULT_STEP;
 }
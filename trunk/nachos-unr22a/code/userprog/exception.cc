@@ -82,6 +82,22 @@ void startProcess(void *args)
     machine->Run(); //Run the program
 }
 
+#ifdef SWAP
+/// Start a forked process from the user registers of its parent, given in
+/// `args`.
+static void
+StartForkedProcess(void *args)
+{
+    int *registers = (int *) args;
+    for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
+        machine->WriteRegister(i, registers[i]);
+    }
+    delete [] registers;
+    currentThread->space->RestoreState();
+    machine->Run();
+}
+#endif
+
 /// Handle a system call exception.
 ///
 /// * `et` is the kind of exception.  The list of possible exceptions is in
@@ -107,6 +123,9 @@ SyscallHandler(ExceptionType _et)
 
         case SC_HALT:
             DEBUG('e', "Shutdown, initiated by user program.\n");
+#ifdef USE_TLB
+            currentThread->space->RecordStats();
+#endif
             interrupt->Halt();
             break;
 
@@ -174,7 +193,7 @@ SyscallHandler(ExceptionType _et)
         case SC_JOIN: {
             SpaceId id = machine->ReadRegister(4);
             DEBUG('e', "Request to join %d.\n", id);
-            Thread *thread = activeThreads->Get(id);
+            Thread *thread = id >= 0 ? activeThreads->Get(id) : nullptr;
             if (!thread) {
                 DEBUG('e', "Thread doesn't exits %d.\n", id);
                 machine->WriteRegister(2, -1);
@@ -186,6 +205,64 @@ SyscallHandler(ExceptionType _et)
             break;
         }
 
+        case SC_FORK: {
+            DEBUG('e', "Fork requested by %s.\n", currentThread->GetName());
+#ifdef SWAP
+            int joinable = machine->ReadRegister(4);
+
+            // The new process may come to write every page that the
+            // parent holds room in swap for.
+            unsigned reserved = currentThread->space->CountReservedSwap();
+            if (!swapArea->Reserve(reserved)) {
+                DEBUG('e', "Error: no room in swap for a copy of %s.\n",
+                      currentThread->GetName());
+                machine->WriteRegister(2, -1);
+                break;
+            }
+            Thread *thread = new Thread(currentThread->GetName(), joinable);
+            thread->space = new AddressSpace(currentThread->space,
+                                             thread->GetSpaceId());
+#ifdef FILESYS
+            thread->SetPath(currentThread->GetPath());
+#endif
+
+            // The new process resumes after the system call, returning 0.
+            int *registers = new int [NUM_TOTAL_REGS];
+            for (unsigned i = 0; i < NUM_TOTAL_REGS; i++) {
+                registers[i] = machine->ReadRegister(i);
+            }
+            registers[2] = 0;
+            registers[PREV_PC_REG] = registers[PC_REG];
+            registers[PC_REG] = registers[NEXT_PC_REG];
+            registers[NEXT_PC_REG] += 4;
+            thread->Fork(StartForkedProcess, registers);
+
+            DEBUG('e', "Forked %s with spaceId %d.\n",
+                  thread->GetName(), thread->GetSpaceId());
+            machine->WriteRegister(2, thread->GetSpaceId());
+#else
+            // Without a coremap frames cannot be shared.
+            DEBUG('e', "Error: fork needs a kernel built with swap.\n");
+            machine->WriteRegister(2, -1);
+#endif
+            break;
+        }
+
+        case SC_SBRK: {
+            int increment = machine->ReadRegister(4);
+            DEBUG('e', "Sbrk of %d bytes requested by %s.\n",
+                  increment, currentThread->GetName());
+#ifdef DEMAND_LOADING
+            machine->WriteRegister(2, currentThread->space->Sbrk(
+                increment, machine->ReadRegister(STACK_REG)));
+#else
+            // Every page is given a frame up front, so the space cannot
+            // grow.
+            machine->WriteRegister(2, -1);
+#endif
+            break;
+        }
+
         case SC_CREATE: {
             int filenameAddr = machine->ReadRegister(4);
             if (filenameAddr == 0) {
@@ -494,23 +571,41 @@ static unsigned
 getVPN(unsigned vaddr) {
     return (unsigned) vaddr/PAGE_SIZE;
 }
-#endif
-unsigned tlbSelection = 0;
 
-#ifdef SWAP
-void ReplaceTlbEntry(unsigned index, AddressSpace* space, TranslationEntry entry)
+/// Pick the TLB entry to load a translation into: a free one if there is
+/// any, and otherwise the one chosen by the replacement policy, which is
+/// synced into the space it belongs to, that may not be the running one.
+static unsigned
+ChooseTlbEntry()
 {
-    TranslationEntry* tlb = machine->GetMMU()->tlb;
-
-    for (unsigned i=0;i<TLB_SIZE;++i) {
+    TranslationEntry *tlb = machine->GetMMU()->tlb;
+    const unsigned tlbSize = machine->GetMMU()->GetTlbSize();
+    for (unsigned i = 0; i < tlbSize; i++) {
         if (!tlb[i].valid) {
-            tlb[i] = entry;
-            return;
+            return i;
         }
     }
 
-    space->SyncTlbEntry(index);
-    tlb[index] = entry;
+    unsigned victim = tlbPolicy->Victim(tlb);
+    ASSERT(victim < tlbSize);
+    if (tlbPolicy->ReadsUseBits() && tlb[victim].use) {
+        // Every entry was used since the bits were last cleared.
+        AddressSpace::ClearTlbUse();
+    }
+    AddressSpace::SyncTlbEntry(victim);
+    stats->numTlbEvictions++;
+    return victim;
+}
+
+static void
+ReplaceTlbEntry(AddressSpace *space, TranslationEntry entry)
+{
+    unsigned index = ChooseTlbEntry();
+    entry.asid = space->GetAsid();
+    machine->GetMMU()->tlb[index] = entry;
+    tlbPolicy->Loaded(index);
+    DEBUG('v', "Virtual page %u is loaded in the tlb entry %u\n",
+          entry.virtualPage, index);
 }
 #endif
 
@@ -520,37 +615,56 @@ PageFaultHandler(ExceptionType et)
 #ifdef USE_TLB
     unsigned vpn = getVPN(machine->ReadRegister(BAD_VADDR_REG));
     AddressSpace* space = currentThread->space;
-    unsigned index = tlbSelection++%TLB_SIZE;
+    if (vpn >= space->GetNumPages()) {
+        DEBUG('e', "Address 0x%X is outside the space of %s.\n",
+              machine->ReadRegister(BAD_VADDR_REG), currentThread->GetName());
+        currentThread->Finish(ADDRESS_ERROR_EXCEPTION);
+    }
 #ifdef DEMAND_LOADING
 #ifdef SWAP
-    if(!space->GetPageTableEntry(vpn).valid) {
-        unsigned frame = coreMap->ReplacePage(space);
+    if (space->IsSharedText(vpn) && !space->GetPageTableEntry(vpn).valid) {
+        ReplaceTlbEntry(space, space->LoadTextPage(vpn));
+    } else if (space->IsZeroFill(vpn)) {
+        if (!space->IsInUse(vpn, machine->ReadRegister(STACK_REG))) {
+            // Past the break and below the stack: a wild pointer.
+            DEBUG('e', "Address 0x%X is not in use by %s.\n",
+                  machine->ReadRegister(BAD_VADDR_REG),
+                  currentThread->GetName());
+            currentThread->Finish(ADDRESS_ERROR_EXCEPTION);
+        }
+        // Only a write gets it a frame, through `ReadOnlyHandler`.
+        ReplaceTlbEntry(space, space->MapZeroPage(vpn));
+    } else if(!space->GetPageTableEntry(vpn).valid) {
+        if (!space->ReserveSwap(vpn)) {
+            // The page could not be evicted later: out of memory.
+            currentThread->Finish(et);
+        }
+        unsigned frame = coreMap->ReplacePage(space, vpn);
+        stats->numPageIns++;
         DEBUG('v', "Loading %lu %lu \n", vpn, frame);
         if(space->GetPageTableEntry(vpn).isInSwap) {
             DEBUG('v', "Swap Loading %lu %lu \n", vpn, frame);
-            ReplaceTlbEntry(index, space, space->LoadFromSwap(vpn, frame));
+            ReplaceTlbEntry(space, space->LoadFromSwap(vpn, frame));
         } else {
-            ReplaceTlbEntry(index, space, space->LoadPage(vpn, frame));
+            ReplaceTlbEntry(space, space->LoadPage(vpn, frame));
         }
+        coreMap->Unpin(frame);
         DEBUG('v', "Loaded page for address %lu \n", vpn);
     } else {
-        ReplaceTlbEntry(index, space, space->GetPageTableEntry(vpn));
+        ReplaceTlbEntry(space, space->GetPageTableEntry(vpn));
     }
 #else
-    TranslationEntry* tableE = machine->GetMMU()->tlb + index;
     if(!space->GetPageTableEntry(vpn).valid) {
         DEBUG('v', "Demand loading for address %lu \n", vpn);
-        *tableE = space->LoadPage(vpn, pages->Find());
+        ReplaceTlbEntry(space, space->LoadPage(vpn, pages->Find()));
         DEBUG('v', "Loaded page for address %lu \n", vpn);
     } else {
-        *tableE = space->GetPageTableEntry(vpn);
+        ReplaceTlbEntry(space, space->GetPageTableEntry(vpn));
     }
 #endif
 #else
-    TranslationEntry* tableE = machine->GetMMU()->tlb + index;
-    *tableE = space->GetPageTableEntry(vpn);
+    ReplaceTlbEntry(space, space->GetPageTableEntry(vpn));
 #endif
-    DEBUG('v', "Virtual page %lu is loaded in the tlb entry %lu\n", vpn, tlbSelection%TLB_SIZE); 
 #else
     DefaultHandler(et);
 #endif
@@ -559,6 +673,24 @@ PageFaultHandler(ExceptionType et)
 static void
 ReadOnlyHandler(ExceptionType et)
 {
+#ifdef SWAP
+    // The first write to a page shared with a forked process copies it,
+    // and the first write to a page of zeroes gives it a frame.
+    unsigned vpn = getVPN(machine->ReadRegister(BAD_VADDR_REG));
+    AddressSpace *space = currentThread->space;
+    if (space->IsZeroPage(vpn)) {
+        if (!space->ReserveSwap(vpn)) {
+            // The page could not be evicted later: out of memory.
+            currentThread->Finish(et);
+        }
+        ReplaceTlbEntry(space, space->FillZeroPage(vpn));
+        return;
+    }
+    if (space->IsCopyOnWrite(vpn)) {
+        ReplaceTlbEntry(space, space->CopyOnWrite(vpn));
+        return;
+    }
+#endif
     #ifdef USE_TLB
     currentThread->Finish(et);
     #else
@@ -0,0 +1,86 @@
+/// Performance test for loading programs into memory.
+///
+/// Creates and deletes address spaces for an executable, as `Exec` does,
+/// and prints the host time each one takes.  Without demand loading, that
+/// is when the whole image is read into memory, one page at a time.  Spaces
+/// are created both with the executable cache emptied first, so that every
+/// page is read from the file, and with the header and first pages already
+/// cached, as when a program is run again.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "address_space.hh"
+#include "executable.hh"
+#include "threads/system.hh"
+
+#include <stdio.h>
+#include <time.h>
+
+
+#ifndef DEMAND_LOADING
+
+/// Times every program is loaded each way.
+static const unsigned NUM_LOADS = 20;
+
+/// Create and delete `NUM_LOADS` address spaces for `file`, emptying the
+/// executable cache before each one if `cold`.  Returns the host time each
+/// one took, in microseconds.
+static double
+TimeLoads(OpenFile *file, unsigned long fileId, bool cold)
+{
+    clock_t start = clock();
+    for (unsigned i = 0; i < NUM_LOADS; i++) {
+        if (cold) {
+            executableCache->Invalidate(fileId);
+        }
+        delete new AddressSpace(file, currentThread->GetSpaceId());
+    }
+    return (double) (clock() - start) / CLOCKS_PER_SEC * 1e6 / NUM_LOADS;
+}
+
+#endif
+
+void
+ExecPerformanceTest(const char *filename)
+{
+    ASSERT(filename != nullptr);
+
+#ifdef DEMAND_LOADING
+    printf("Programs are demand loaded: creating an address space reads "
+           "nothing but the header.\n");
+#else
+    OpenFile *file = fileSystem->Open(filename);
+    if (file == nullptr) {
+        printf("Unable to open file %s\n", filename);
+        return;
+    }
+    Executable exe(file);
+    if (!exe.CheckMagic()) {
+        printf("%s is not a NOFF executable\n", filename);
+        delete file;
+        return;
+    }
+    unsigned numPages = DivRoundUp(exe.GetSize() + USER_STACK_SIZE,
+                                   PAGE_SIZE);
+    if (numPages > pages->CountClear()) {
+        printf("%s takes %u pages, but only %u are free\n",
+               filename, numPages, pages->CountClear());
+        delete file;
+        return;
+    }
+
+    double coldTime = TimeLoads(file, exe.GetFileId(), true);
+    double cachedTime = TimeLoads(file, exe.GetFileId(), false);
+
+    printf("Exec latency of %s: %u pages, %u loads.\n",
+           filename, numPages, NUM_LOADS);
+    printf("%10s %12s\n", "load", "us/exec");
+    printf("%10s %12.1f\n", "cold", coldTime);
+    printf("%10s %12.1f\n", "cached", cachedTime);
+
+    delete file;
+#endif
+}
@@ -6,6 +6,9 @@
 
 #include "executable.hh"
 #include "machine/endianness.hh"
+#include "threads/system.hh"
+
+#include <string.h>
 
 
 /// Do little endian to big endian conversion on the bytes in the object file
@@ -33,6 +36,16 @@ Executable::Executable(OpenFile *new_file)
     ASSERT(new_file != nullptr);
 
     file = new_file;
+#ifdef FILESYS
+    fileId = file->GetSector();
+#else
+    fileId = file->GetFileId();
+#endif
+
+    // A program that is run again need not have its header read again.
+    if (executableCache->GetHeader(GetFileId(), &header)) {
+        return;
+    }
     file->ReadAt((char *) &header, sizeof header, 0);
 }
 
@@ -46,10 +59,26 @@ Executable::CheckMagic()
     return header.noffMagic == NOFF_MAGIC;
 }
 
+/// End of `seg` in memory, or zero if it is empty.
+static uint32_t
+SegmentEnd(const noffSegment &seg)
+{
+    return seg.size > 0 ? seg.virtualAddr + seg.size : 0;
+}
+
 uint32_t
 Executable::GetSize() const
 {
-    return header.code.size + header.initData.size + header.uninitData.size;
+    // Segments may be padded apart, to start on a page, so this is where
+    // the last one ends rather than the sum of their sizes.
+    uint32_t size = SegmentEnd(header.code);
+    if (SegmentEnd(header.initData) > size) {
+        size = SegmentEnd(header.initData);
+    }
+    if (SegmentEnd(header.uninitData) > size) {
+        size = SegmentEnd(header.uninitData);
+    }
+    return size;
 }
 
 uint32_t
@@ -101,3 +130,54 @@ Executable::ReadDataBlock(char *dest, uint32_t size, uint32_t offset)
 
     return file->ReadAt(dest, size, header.initData.inFileAddr + offset);
 }
+
+/// Read the part of `[addr, addr + size)` that `seg` holds in the file into
+/// `dest`, which corresponds to `addr`.
+static void
+ReadSegment(OpenFile *file, const noffSegment &seg, char *dest,
+            uint32_t addr, uint32_t size)
+{
+    uint32_t lo = addr > seg.virtualAddr ? addr : seg.virtualAddr;
+    uint32_t hi = addr + size < seg.virtualAddr + seg.size
+                  ? addr + size : seg.virtualAddr + seg.size;
+    if (seg.size > 0 && lo < hi) {
+        file->ReadAt(dest + (lo - addr), hi - lo,
+                     seg.inFileAddr + (lo - seg.virtualAddr));
+    }
+}
+
+void
+Executable::ReadImage(char *dest, uint32_t addr, uint32_t size)
+{
+    ASSERT(dest != nullptr);
+    ASSERT(size != 0);
+    if (executableCache->ReadImage(GetFileId(), dest, addr, size)) {
+        return;
+    }
+    memset(dest, 0, size);
+    ReadSegment(file, header.code, dest, addr, size);
+    ReadSegment(file, header.initData, dest, addr, size);
+}
+
+bool
+Executable::Overlaps(const noffSegment &seg, uint32_t addr, uint32_t size)
+{
+    return seg.size > 0 && addr < seg.virtualAddr + seg.size
+           && seg.virtualAddr < addr + size;
+}
+
+bool
+Executable::IsInFile(uint32_t addr, uint32_t size) const
+{
+    return Overlaps(header.code, addr, size)
+           || Overlaps(header.initData, addr, size);
+}
+
+bool
+Executable::IsTextOnly(uint32_t addr, uint32_t size) const
+{
+    return Overlaps(header.code, addr, size)
+           && !Overlaps(header.initData, addr, size)
+           && !Overlaps(header.uninitData, addr, size)
+           && addr + size <= GetSize();
+}
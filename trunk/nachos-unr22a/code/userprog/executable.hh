@@ -62,9 +62,45 @@ public:
     int ReadCodeBlock(char *dest, uint32_t size, uint32_t offset);
     int ReadDataBlock(char *dest, uint32_t size, uint32_t offset);
 
+    /// Read `size` bytes of the memory image of the program, starting at
+    /// virtual address `addr`: whatever the code and initialized data
+    /// segments hold there, and zeroes everywhere else.
+    void ReadImage(char *dest, uint32_t addr, uint32_t size);
+
+    /// Whether some of `size` bytes starting at virtual address `addr` fall
+    /// inside segment `seg`.
+    static bool Overlaps(const noffSegment &seg, uint32_t addr,
+                         uint32_t size);
+
+    /// Whether some of `size` bytes starting at virtual address `addr` are
+    /// held in the file.
+    bool IsInFile(uint32_t addr, uint32_t size) const;
+
+    /// Whether `size` bytes starting at virtual address `addr` hold code
+    /// and nothing the program may write: no data and no part of the stack
+    /// that follows the program.  Such pages are the same in every process
+    /// running it.
+    bool IsTextOnly(uint32_t addr, uint32_t size) const;
+
+    /// Identify the file the program is read from: the same for every
+    /// open of it.
+    unsigned long GetFileId() const
+    {
+        return fileId;
+    }
+
+    /// Parsed header, fixed to host endianness once `CheckMagic` succeeds.
+    const noffHeader &GetHeader() const
+    {
+        return header;
+    }
+
 private:
     OpenFile *file;
     noffHeader header;
+
+    /// Looked up once, as with the stub it takes a UNIX system call.
+    unsigned long fileId;
 };
 
 
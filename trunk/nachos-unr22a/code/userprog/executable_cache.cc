@@ -0,0 +1,140 @@
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "executable_cache.hh"
+#include "machine/mmu.hh"
+#include "threads/system.hh"
+
+#include <string.h>
+
+
+ExecutableCache::ExecutableCache()
+{
+    for (unsigned i = 0; i < NUM_ENTRIES; i++) {
+        entries[i].valid = false;
+        entries[i].image = new char [NUM_PAGES * PAGE_SIZE];
+        entries[i].imageSize = 0;
+        entries[i].complete = false;
+        entries[i].lastUse = 0;
+    }
+    clock = 0;
+    generation = 0;
+}
+
+ExecutableCache::~ExecutableCache()
+{
+    for (unsigned i = 0; i < NUM_ENTRIES; i++) {
+        delete [] entries[i].image;
+    }
+}
+
+ExecutableCache::Entry *
+ExecutableCache::Find(unsigned long fileId)
+{
+    for (unsigned i = 0; i < NUM_ENTRIES; i++) {
+        if (entries[i].valid && entries[i].fileId == fileId) {
+            entries[i].lastUse = ++clock;
+            return &entries[i];
+        }
+    }
+    return nullptr;
+}
+
+bool
+ExecutableCache::GetHeader(unsigned long fileId, noffHeader *header)
+{
+    ASSERT(header != nullptr);
+
+    Entry *entry = Find(fileId);
+    if (entry == nullptr) {
+        return false;
+    }
+    *header = entry->header;
+    return true;
+}
+
+bool
+ExecutableCache::ReadImage(unsigned long fileId, char *dest, unsigned addr,
+                           unsigned size)
+{
+    ASSERT(dest != nullptr);
+
+    Entry *entry = Find(fileId);
+    if (entry == nullptr
+          || (addr + size > entry->imageSize && !entry->complete)) {
+        return false;
+    }
+    unsigned cached = 0;
+    if (addr < entry->imageSize) {
+        cached = entry->imageSize - addr < size ? entry->imageSize - addr
+                                                : size;
+        memcpy(dest, &entry->image[addr], cached);
+    }
+    memset(dest + cached, 0, size - cached);
+    return true;
+}
+
+void
+ExecutableCache::Add(unsigned long fileId, Executable *exe)
+{
+    ASSERT(exe != nullptr);
+
+    if (Find(fileId) != nullptr) {
+        stats->numExecutableCacheHits++;
+        return;
+    }
+    stats->numExecutableCacheMisses++;
+
+    // Keep no more than the image actually takes.
+    const noffHeader &header = exe->GetHeader();
+    unsigned size = header.code.virtualAddr + header.code.size;
+    if (header.initData.size > 0
+          && header.initData.virtualAddr + header.initData.size > size) {
+        size = header.initData.virtualAddr + header.initData.size;
+    }
+    size = DivRoundUp(size, PAGE_SIZE) * PAGE_SIZE;
+    bool complete = size <= NUM_PAGES * PAGE_SIZE;
+    if (!complete) {
+        size = NUM_PAGES * PAGE_SIZE;
+    }
+
+    // Reading may block, so fill a buffer first and only take an entry
+    // if the file did not change meanwhile.
+    unsigned long startGeneration = generation;
+    char *image = new char [NUM_PAGES * PAGE_SIZE];
+    if (size > 0) {
+        exe->ReadImage(image, 0, size);
+    }
+    if (generation != startGeneration || Find(fileId) != nullptr) {
+        delete [] image;
+        return;
+    }
+
+    Entry *victim = &entries[0];
+    for (unsigned i = 1; i < NUM_ENTRIES && victim->valid; i++) {
+        if (!entries[i].valid || entries[i].lastUse < victim->lastUse) {
+            victim = &entries[i];
+        }
+    }
+    delete [] victim->image;
+    victim->valid = true;
+    victim->fileId = fileId;
+    victim->header = header;
+    victim->image = image;
+    victim->imageSize = size;
+    victim->complete = complete;
+    victim->lastUse = ++clock;
+}
+
+void
+ExecutableCache::Invalidate(unsigned long fileId)
+{
+    generation++;
+    for (unsigned i = 0; i < NUM_ENTRIES; i++) {
+        if (entries[i].valid && entries[i].fileId == fileId) {
+            entries[i].valid = false;
+        }
+    }
+}
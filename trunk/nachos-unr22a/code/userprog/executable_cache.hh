@@ -0,0 +1,85 @@
+/// Cache of the programs that were run recently.
+///
+/// Running a program reads its NOFF header and then faults in its first
+/// pages, which for a small program is most of it.  The cache keeps, for a
+/// few executables, the parsed header and the image of those first pages,
+/// so that running the same program again needs no disk access for them.
+///
+/// Entries are keyed by the identifier of the file, cf.
+/// `Executable::GetFileId`: the sector of its file header with the Nachos
+/// file system, which drops them as soon as the file is written to or
+/// removed; and the inode of the UNIX file with the stub, which does not
+/// see changes made to files, just as for shared code.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_USERPROG_EXECUTABLECACHE__HH
+#define NACHOS_USERPROG_EXECUTABLECACHE__HH
+
+
+#include "executable.hh"
+
+
+class ExecutableCache {
+public:
+
+    /// Number of executables kept.
+    static const unsigned NUM_ENTRIES = 8;
+
+    /// Number of pages of the image kept for each one.
+    static const unsigned NUM_PAGES = 8;
+
+    ExecutableCache();
+
+    ~ExecutableCache();
+
+    /// Copy the header of the executable identified by `fileId` into
+    /// `header`, if it is cached.
+    bool GetHeader(unsigned long fileId, noffHeader *header);
+
+    /// Copy `size` bytes of the image of the executable identified by
+    /// `fileId`, starting at virtual address `addr`, into `dest`, if they
+    /// are all known.
+    bool ReadImage(unsigned long fileId, char *dest, unsigned addr,
+                   unsigned size);
+
+    /// Remember `exe`, identified by `fileId`, unless it is already cached.
+    /// The header must have passed `CheckMagic`.
+    void Add(unsigned long fileId, Executable *exe);
+
+    /// Forget the executable identified by `fileId`.
+    void Invalidate(unsigned long fileId);
+
+private:
+
+    struct Entry {
+        bool valid;
+        unsigned long fileId;
+        noffHeader header;
+
+        /// First pages of the image, and how many bytes of it are kept.
+        char *image;
+        unsigned imageSize;
+
+        /// Everything past `imageSize` is zero.
+        bool complete;
+
+        /// Time of the last use, to replace the least recently used.
+        unsigned long lastUse;
+    };
+
+    Entry *Find(unsigned long fileId);
+
+    Entry entries[NUM_ENTRIES];
+
+    unsigned long clock;
+
+    /// Incremented by every invalidation, so that an entry being filled
+    /// while its file changes is not added.
+    unsigned long generation;
+};
+
+
+#endif
@@ -25,6 +25,7 @@
 #define SC_JOIN     3
 #define SC_FORK     4
 #define SC_YIELD    5
+#define SC_SBRK     6
 #define SC_CREATE  10
 #define SC_REMOVE  11
 #define SC_OPEN    12
@@ -70,17 +71,42 @@ SpaceId Exec(char *name, char **args, int joinable);
 int Join(SpaceId id);
 
 
-/// User-level thread operations: `Fork` and `Yield`.  To allow multiple
-/// threads to run within a user program.
+/// Process and thread operations: `Fork` and `Yield`.
 
-/// Fork a thread to run a procedure (`func`) in the *same* address space as
-/// the current thread.
-int Fork(void (*func)(void));
+/// Create a copy of the current process, that resumes from this call too.
+///
+/// Return the address space identifier of the new process to the caller,
+/// and 0 to the new process, or -1 on failure.  Memory is not copied until
+/// either process writes it.  As with `Exec`, `joinable` tells whether the
+/// new process can be waited for with `Join`.
+///
+/// Processes can only share frames when the kernel keeps a coremap, that
+/// is, when it is built with swap; other kernels always return -1.
+///
+/// This replaces the old `int Fork(void (*func)(void))`, which started a
+/// thread in the same space at `func`.  Programs still calling it that way
+/// pass the function address as `joinable`, and get a copy of themselves
+/// instead.
+SpaceId Fork(int joinable);
 
 /// Yield the CPU to another runnable thread, whether in this address space
 /// or not.
 void Yield();
 
+/// Move the end of the heap of the process by `increment` bytes, which may
+/// be negative.
+///
+/// Return the previous end, so that growing the heap returns the start of
+/// the new memory, which reads as zeroes until written.  Return -1, and
+/// leave the heap as it was, if it would shrink below its start, reach the
+/// stack, or take more memory than the swap area has room left for.
+///
+/// Memory past the end of the heap, short of the stack, is not part of the
+/// process, and touching it kills the process with an address error.
+/// Whole pages given back by shrinking the heap are dropped, and read as
+/// zeroes again once the heap grows over them.
+void *Sbrk(int increment);
+
 
 /// File system operations: `Create`, `Open`, `Read`, `Write`, `Close`.
 ///
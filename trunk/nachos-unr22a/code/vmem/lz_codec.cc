@@ -0,0 +1,192 @@
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "lz_codec.hh"
+#include "lib/assert.hh"
+
+#include <stdint.h>
+#include <string.h>
+
+
+static const unsigned HASH_BITS = 8;
+static const unsigned HASH_SIZE = 1 << HASH_BITS;
+static const unsigned NO_POSITION = ~0U;
+static const unsigned MAX_DISTANCE = 0xFFFF;
+
+/// Largest value held in a field of the token.
+static const unsigned TOKEN_FIELD_MAX = 15;
+
+static inline unsigned
+Hash(const unsigned char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof v);
+    return (v * 2654435761U) >> (32 - HASH_BITS);
+}
+
+/// Append the continuation of a token field holding `value` to `out`.
+static bool
+PutLength(unsigned char *out, unsigned *o, unsigned capacity, unsigned value)
+{
+    if (value < TOKEN_FIELD_MAX) {
+        return true;
+    }
+    for (value -= TOKEN_FIELD_MAX; ; value -= 255) {
+        if (*o == capacity) {
+            return false;
+        }
+        out[(*o)++] = value < 255 ? value : 255;
+        if (value < 255) {
+            return true;
+        }
+    }
+}
+
+/// Append a record of `numLiterals` bytes from `literals` followed, if
+/// `matchLength` is not 0, by a match of that length at `distance`.
+static bool
+PutRecord(unsigned char *out, unsigned *o, unsigned capacity,
+          const unsigned char *literals, unsigned numLiterals,
+          unsigned distance, unsigned matchLength)
+{
+    unsigned lengthField = matchLength > 0 ? matchLength - LZ_MIN_MATCH : 0;
+    if (*o == capacity) {
+        return false;
+    }
+    out[(*o)++] = (numLiterals < TOKEN_FIELD_MAX
+                     ? numLiterals : TOKEN_FIELD_MAX) << 4
+                  | (lengthField < TOKEN_FIELD_MAX
+                       ? lengthField : TOKEN_FIELD_MAX);
+    if (!PutLength(out, o, capacity, numLiterals)
+          || numLiterals > capacity - *o) {
+        return false;
+    }
+    memcpy(&out[*o], literals, numLiterals);
+    *o += numLiterals;
+
+    if (matchLength == 0) {
+        return true;
+    }
+    if (capacity - *o < 2) {
+        return false;
+    }
+    out[(*o)++] = distance & 0xFF;
+    out[(*o)++] = distance >> 8;
+    return PutLength(out, o, capacity, lengthField);
+}
+
+unsigned
+LzCompress(const char *data, unsigned size, char *buffer, unsigned capacity)
+{
+    ASSERT(data != nullptr);
+    ASSERT(buffer != nullptr);
+
+    const unsigned char *in = (const unsigned char *) data;
+    unsigned char *out = (unsigned char *) buffer;
+    unsigned table[HASH_SIZE];
+    for (unsigned h = 0; h < HASH_SIZE; h++) {
+        table[h] = NO_POSITION;
+    }
+
+    unsigned o = 0;
+    unsigned anchor = 0;  // Start of the literals not yet written.
+    unsigned i = 0;
+    while (i + LZ_MIN_MATCH <= size) {
+        unsigned h = Hash(&in[i]);
+        unsigned candidate = table[h];
+        table[h] = i;
+        if (candidate == NO_POSITION || i - candidate > MAX_DISTANCE
+              || memcmp(&in[candidate], &in[i], LZ_MIN_MATCH) != 0) {
+            i++;
+            continue;
+        }
+
+        // The match may run into the bytes it copies, which repeats them.
+        unsigned length = LZ_MIN_MATCH;
+        while (i + length < size && in[candidate + length] == in[i + length]) {
+            length++;
+        }
+        if (!PutRecord(out, &o, capacity, &in[anchor], i - anchor,
+                       i - candidate, length)) {
+            return 0;
+        }
+        i += length;
+        anchor = i;
+    }
+
+    if (anchor < size
+          && !PutRecord(out, &o, capacity, &in[anchor], size - anchor, 0, 0)) {
+        return 0;
+    }
+    return o;
+}
+
+/// Read the continuation of a token field holding `value` from `in`.
+static bool
+GetLength(const unsigned char *in, unsigned *i, unsigned length,
+          unsigned *value)
+{
+    if (*value < TOKEN_FIELD_MAX) {
+        return true;
+    }
+    unsigned char b;
+    do {
+        if (*i == length) {
+            return false;
+        }
+        b = in[(*i)++];
+        *value += b;
+    } while (b == 255);
+    return true;
+}
+
+bool
+LzDecompress(const char *buffer, unsigned length, char *data, unsigned size)
+{
+    ASSERT(buffer != nullptr);
+    ASSERT(data != nullptr);
+
+    const unsigned char *in = (const unsigned char *) buffer;
+    unsigned char *out = (unsigned char *) data;
+    unsigned i = 0;
+    unsigned o = 0;
+    while (o < size) {
+        if (i == length) {
+            return false;
+        }
+        unsigned token = in[i++];
+
+        unsigned numLiterals = token >> 4;
+        if (!GetLength(in, &i, length, &numLiterals)
+              || numLiterals > length - i || numLiterals > size - o) {
+            return false;
+        }
+        memcpy(&out[o], &in[i], numLiterals);
+        i += numLiterals;
+        o += numLiterals;
+        if (o == size) {
+            break;
+        }
+
+        if (length - i < 2) {
+            return false;
+        }
+        unsigned distance = in[i] | in[i + 1] << 8;
+        i += 2;
+        unsigned matchLength = token & TOKEN_FIELD_MAX;
+        if (!GetLength(in, &i, length, &matchLength)) {
+            return false;
+        }
+        matchLength += LZ_MIN_MATCH;
+        if (distance == 0 || distance > o || matchLength > size - o) {
+            return false;
+        }
+        // Byte by byte, as the match may overlap what it produces.
+        for (unsigned j = 0; j < matchLength; j++, o++) {
+            out[o] = out[o - distance];
+        }
+    }
+    return i == length;
+}
@@ -0,0 +1,40 @@
+/// A fast LZ77 codec for pages, in the style of LZ4.
+///
+/// The compressed data is a sequence of records, each made of a token byte,
+/// a run of literal bytes copied as they are, and a match: a copy of bytes
+/// already decompressed, given by its distance back from the end of the
+/// output.  The high four bits of the token are the number of literals and
+/// the low four bits the length of the match minus `LZ_MIN_MATCH`; a field
+/// of 15 is continued by bytes that are added to it, up to the first one
+/// below 255.  The literals follow the token and its continuation, and then
+/// come the two bytes of the distance, least significant first, and the
+/// continuation of the match length.  The last record has literals only.
+///
+/// Matches are found with a small hash table of the last position where
+/// each group of four bytes was seen, so compressing takes a single pass,
+/// and decompressing is a loop of copies.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_VMEM_LZCODEC__HH
+#define NACHOS_VMEM_LZCODEC__HH
+
+
+/// Shortest match that is worth encoding.
+const unsigned LZ_MIN_MATCH = 4;
+
+/// Compress the `size` bytes at `data` into `buffer`.  Return the length of
+/// the result, or 0 if it does not fit in `capacity` bytes.
+unsigned LzCompress(const char *data, unsigned size,
+                    char *buffer, unsigned capacity);
+
+/// Decompress the `length` bytes at `buffer`, which must decompress to
+/// exactly `size` bytes, into `data`.  Return false if they are not the
+/// output of `LzCompress`.
+bool LzDecompress(const char *buffer, unsigned length,
+                  char *data, unsigned size);
+
+
+#endif
@@ -0,0 +1,270 @@
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "swap_area.hh"
+#include "lz_codec.hh"
+#include "machine/mmu.hh"
+#include "threads/system.hh"
+
+#include <string.h>
+
+
+SwapArea::SwapArea(const char *name, unsigned slotCount, unsigned budget)
+{
+    ASSERT(name != nullptr);
+    ASSERT(PAGE_SIZE == SECTOR_SIZE);
+    ASSERT(slotCount > 0 && slotCount <= NUM_SECTORS);
+
+    numSlots = slotCount;
+    disk = new SynchDisk(name);
+    slots = new Bitmap(numSlots);
+    users = new unsigned [numSlots];
+    busy = new Bitmap(numSlots);
+    freed = new Bitmap(numSlots);
+    numReserved = 0;
+    transferLock = new Lock("swap transfer lock");
+    transferDone = new Condition("swap transfer done", transferLock);
+    numWaiters = 0;
+
+    pooled = new char * [numSlots];
+    pooledLength = new unsigned [numSlots];
+    pooledStamp = new unsigned long [numSlots];
+    for (unsigned i = 0; i < numSlots; i++) {
+        pooled[i] = nullptr;
+    }
+    poolClock = 0;
+    poolBudget = budget;
+    poolBytes = 0;
+}
+
+SwapArea::~SwapArea()
+{
+    delete slots;
+    delete [] users;
+    delete busy;
+    delete freed;
+    delete transferDone;
+    delete transferLock;
+    for (unsigned i = 0; i < numSlots; i++) {
+        delete [] pooled[i];
+    }
+    delete [] pooled;
+    delete [] pooledLength;
+    delete [] pooledStamp;
+    delete disk;
+}
+
+unsigned
+SwapArea::AllocateSlot()
+{
+    int slot = slots->Find();
+    if (slot == -1) {
+        return NO_SLOT;
+    }
+    users[slot] = 1;
+    return slot;
+}
+
+bool
+SwapArea::Reserve(unsigned count)
+{
+    // Slots freed while being written are still taken until the write
+    // ends, but no longer reserved.
+    unsigned pending = numSlots - freed->CountClear();
+    if (numReserved + pending + count > numSlots) {
+        return false;
+    }
+    numReserved += count;
+    return true;
+}
+
+void
+SwapArea::Unreserve(unsigned count)
+{
+    ASSERT(count <= numReserved);
+    numReserved -= count;
+}
+
+void
+SwapArea::FreeSlot(unsigned slot)
+{
+    ASSERT(slot < numSlots && slots->Test(slot) && users[slot] > 0);
+    if (--users[slot] > 0) {
+        return;
+    }
+    if (busy->Test(slot)) {
+        freed->Mark(slot);
+    } else {
+        Unpool(slot);
+        slots->Clear(slot);
+    }
+}
+
+void
+SwapArea::ShareSlot(unsigned slot)
+{
+    ASSERT(slot < numSlots && slots->Test(slot) && users[slot] > 0);
+    users[slot]++;
+}
+
+bool
+SwapArea::IsShared(unsigned slot) const
+{
+    ASSERT(slot < numSlots);
+    return users[slot] > 1;
+}
+
+void
+SwapArea::Begin(unsigned slot)
+{
+    // Releasing the lock may switch threads, so test again after it.
+    while (busy->Test(slot)) {
+        transferLock->Acquire();
+        numWaiters++;
+        while (busy->Test(slot)) {
+            transferDone->Wait();
+        }
+        numWaiters--;
+        transferLock->Release();
+    }
+    busy->Mark(slot);
+}
+
+void
+SwapArea::End(unsigned slot)
+{
+    busy->Clear(slot);
+    if (freed->Test(slot)) {
+        freed->Clear(slot);
+        Unpool(slot);
+        slots->Clear(slot);
+    }
+
+    // Waiters test the slot holding the lock, so that this cannot come
+    // between their test and their wait.
+    if (numWaiters > 0) {
+        transferLock->Acquire();
+        transferDone->Broadcast();
+        transferLock->Release();
+    }
+}
+
+void
+SwapArea::ReadSlot(unsigned slot, char *data)
+{
+    ASSERT(slot < numSlots && slots->Test(slot));
+    ASSERT(data != nullptr);
+    Begin(slot);
+    if (pooled[slot] != nullptr) {
+        bool ok = LzDecompress(pooled[slot], pooledLength[slot],
+                               data, PAGE_SIZE);
+        ASSERT(ok);
+        stats->numSwapPoolHits++;
+    } else {
+        disk->ReadSector(slot, data);
+        if (poolBudget > 0) {
+            stats->numSwapPoolMisses++;
+        }
+    }
+    End(slot);
+}
+
+void
+SwapArea::WriteSlot(unsigned slot, const char *data)
+{
+    ASSERT(slot < numSlots && slots->Test(slot));
+    ASSERT(data != nullptr);
+    Begin(slot);
+    Unpool(slot);
+    if (!Pool(slot, data)) {
+        disk->WriteSector(slot, data);
+    }
+    End(slot);
+}
+
+unsigned
+SwapArea::CountFree() const
+{
+    return slots->CountClear();
+}
+
+bool
+SwapArea::Pool(unsigned slot, const char *data)
+{
+    if (poolBudget == 0) {
+        return false;
+    }
+
+    char buffer[PAGE_SIZE];
+    unsigned length = LzCompress(data, PAGE_SIZE, buffer, PAGE_SIZE - 1);
+    if (length == 0 || length > poolBudget) {
+        stats->numSwapPoolRejects++;
+        return false;
+    }
+
+    // Reserve the room first: writing pages back blocks, and other pages
+    // may be pooled meanwhile.
+    poolBytes += length;
+    while (poolBytes > poolBudget) {
+        if (!WriteBackOldest()) {
+            // Every byte is reserved by pages on their way in.
+            poolBytes -= length;
+            stats->numSwapPoolRejects++;
+            return false;
+        }
+    }
+
+    pooled[slot] = new char [length];
+    memcpy(pooled[slot], buffer, length);
+    pooledLength[slot] = length;
+    pooledStamp[slot] = ++poolClock;
+    stats->numSwapPoolStores++;
+    stats->swapPoolBytesIn += PAGE_SIZE;
+    stats->swapPoolBytesOut += length;
+    DEBUG('v', "Pooled slot %u in %u bytes\n", slot, length);
+    return true;
+}
+
+void
+SwapArea::Unpool(unsigned slot)
+{
+    if (pooled[slot] == nullptr) {
+        return;
+    }
+    poolBytes -= pooledLength[slot];
+    delete [] pooled[slot];
+    pooled[slot] = nullptr;
+}
+
+bool
+SwapArea::WriteBackOldest()
+{
+    unsigned victim = numSlots;
+    for (unsigned i = 0; i < numSlots; i++) {
+        if (pooled[i] != nullptr
+              && (victim == numSlots
+                  || pooledStamp[i] < pooledStamp[victim])) {
+            victim = i;
+        }
+    }
+    if (victim == numSlots) {
+        return false;
+    }
+
+    // A pooled slot is never busy, as writing it drops its copy first and
+    // reading it does not block, so this does not wait.  Once the copy is
+    // dropped, reading the slot waits for the disk to have it.
+    Begin(victim);
+    char data[PAGE_SIZE];
+    bool ok = LzDecompress(pooled[victim], pooledLength[victim],
+                           data, PAGE_SIZE);
+    ASSERT(ok);
+    Unpool(victim);
+    DEBUG('v', "Writing pooled slot %u back\n", victim);
+    stats->numSwapPoolWritebacks++;
+    disk->WriteSector(victim, data);
+    End(victim);
+    return true;
+}
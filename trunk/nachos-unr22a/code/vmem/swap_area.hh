@@ -0,0 +1,140 @@
+/// Swap area: a disk reserved for pages evicted from main memory.
+///
+/// The area is divided in slots of one page each, handed out by a bitmap as
+/// pages are first written out.  Slots are read and written straight from
+/// the disk, one sector each, without going through the file system.
+///
+/// Transfers of a slot are not left to the order in which the disk takes
+/// requests, which threads waiting for it can overtake: a transfer waits
+/// until the previous one of the same slot is over, and a slot freed while
+/// it is being written is only handed out again afterwards.
+///
+/// A slot can be shared by the pages of several address spaces forked from
+/// one another, and counts them: it is only released when the last of them
+/// frees it.
+///
+/// Slots are only taken when pages are evicted, too late for the process
+/// to be told that there is no room left.  So room is reserved earlier, a
+/// page at a time, as pages are first touched: as long as each page that
+/// may be written out holds a reservation, there is always a free slot for
+/// it.
+///
+/// In front of the disk there may be a pool of compressed pages, limited to
+/// a number of bytes.  A page written to a slot is compressed with
+/// `LzCompress` and kept in the pool, and only reaches the disk when there
+/// is no room left for it: the pages pooled longest ago are then written
+/// back to their slots until there is.  Pages that do not compress go
+/// straight to the disk.  Reading a pooled slot just decompresses it, and
+/// the pooled copy stays, as the page may be evicted again without being
+/// written.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_VMEM_SWAPAREA__HH
+#define NACHOS_VMEM_SWAPAREA__HH
+
+
+#include "filesys/synch_disk.hh"
+#include "lib/bitmap.hh"
+#include "threads/condition.hh"
+
+
+class SwapArea {
+public:
+
+    /// Marks a page without a slot.
+    static const unsigned NO_SLOT = ~0U;
+
+    /// Open the swap disk stored in the UNIX file `name`, and use its first
+    /// `numSlots` sectors, at most `NUM_SECTORS`.  Compressed pages are
+    /// pooled in up to `poolBudget` bytes of memory; 0 disables the pool.
+    SwapArea(const char *name, unsigned numSlots = NUM_SECTORS,
+             unsigned poolBudget = 0);
+
+    ~SwapArea();
+
+    /// Take a free slot, used by one page, or return `NO_SLOT` if there is
+    /// none.
+    unsigned AllocateSlot();
+
+    /// Reserve room for `count` more pages, or return false, reserving
+    /// nothing, if the slots cannot hold them along with those reserved
+    /// already.
+    bool Reserve(unsigned count);
+
+    /// Give back the room reserved for `count` pages.
+    void Unreserve(unsigned count);
+
+    /// Drop one of the pages using `slot`, releasing it if it was the last.
+    void FreeSlot(unsigned slot);
+
+    /// Count one more page using `slot`.
+    void ShareSlot(unsigned slot);
+
+    /// Whether `slot` is used by more than one page, so that it must not be
+    /// overwritten.
+    bool IsShared(unsigned slot) const;
+
+    /// Copy a page between `data` and `slot`.
+    void ReadSlot(unsigned slot, char *data);
+    void WriteSlot(unsigned slot, const char *data);
+
+    unsigned CountFree() const;
+
+private:
+    SynchDisk *disk;
+    unsigned numSlots;
+
+    /// Wait until nothing is being transferred to or from `slot`, and
+    /// mark it busy.
+    void Begin(unsigned slot);
+
+    /// Mark `slot` idle again, releasing it if it was freed meanwhile.
+    void End(unsigned slot);
+
+    /// Slots in use, and the number of pages using each.
+    Bitmap *slots;
+    unsigned *users;
+
+    /// Pages that hold a reservation.
+    unsigned numReserved;
+
+    /// Slots with a transfer in progress, and those among them that were
+    /// freed meanwhile.
+    Bitmap *busy;
+    Bitmap *freed;
+
+    /// Signalled whenever a transfer ends, if some thread is waiting in
+    /// `Begin`.
+    Lock *transferLock;
+    Condition *transferDone;
+    unsigned numWaiters;
+
+    /// Compress the page at `data` into the pool as the contents of `slot`,
+    /// making room if needed.  Return false if it has to go to the disk.
+    bool Pool(unsigned slot, const char *data);
+
+    /// Drop the pooled copy of `slot`, if any.
+    void Unpool(unsigned slot);
+
+    /// Write the page pooled longest ago back to its slot.  Return false if
+    /// there is none.
+    bool WriteBackOldest();
+
+    /// Compressed copy of each slot, or null, and its length.  A copy is
+    /// stamped when pooled, with a counter, to tell the oldest.
+    char **pooled;
+    unsigned *pooledLength;
+    unsigned long *pooledStamp;
+    unsigned long poolClock;
+
+    /// Bytes the pool may take, and bytes it takes or that are reserved for
+    /// copies being made.
+    unsigned poolBudget;
+    unsigned poolBytes;
+};
+
+
+#endif
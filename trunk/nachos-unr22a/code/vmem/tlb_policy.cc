@@ -0,0 +1,276 @@
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "tlb_policy.hh"
+#include "lib/assert.hh"
+#include "machine/system_dep.hh"
+
+#include <stdio.h>
+
+
+const char *
+TlbReplacementName(TlbReplacement kind)
+{
+    switch (kind) {
+        case FIFO_TLB:   return "fifo";
+        case RANDOM_TLB: return "random";
+        case LRU_TLB:    return "lru";
+        case NRU_TLB:    return "nru";
+    }
+    return "unknown";
+}
+
+/// Common part of FIFO and LRU: the victim is the entry with the oldest
+/// stamp, and stamps are taken from a counter.
+class StampPolicy : public TlbPolicy {
+public:
+    StampPolicy(unsigned size)
+    {
+        numEntries = size;
+        stamps = new unsigned long [size];
+        for (unsigned i = 0; i < size; i++) {
+            stamps[i] = 0;
+        }
+        clock = 0;
+    }
+
+    ~StampPolicy()
+    {
+        delete [] stamps;
+    }
+
+    unsigned Victim(const TranslationEntry *tlb)
+    {
+        unsigned victim = 0;
+        for (unsigned i = 1; i < numEntries; i++) {
+            if (stamps[i] < stamps[victim]) {
+                victim = i;
+            }
+        }
+        return victim;
+    }
+
+protected:
+    void Stamp(unsigned index)
+    {
+        stamps[index] = ++clock;
+    }
+
+private:
+    unsigned long *stamps;
+    unsigned long clock;
+    unsigned numEntries;
+};
+
+class FifoPolicy : public StampPolicy {
+public:
+    FifoPolicy(unsigned size) : StampPolicy(size) {}
+
+    void Loaded(unsigned index)
+    {
+        Stamp(index);
+    }
+};
+
+class LruPolicy : public StampPolicy {
+public:
+    LruPolicy(unsigned size) : StampPolicy(size) {}
+
+    void Touch(unsigned index)
+    {
+        Stamp(index);
+    }
+
+    void Loaded(unsigned index)
+    {
+        Stamp(index);
+    }
+};
+
+class RandomPolicy : public TlbPolicy {
+public:
+    RandomPolicy(unsigned size)
+    {
+        numEntries = size;
+    }
+
+    /// Drawn from the same generator as the timer, so that `-rs` makes the
+    /// choices reproducible too.
+    unsigned Victim(const TranslationEntry *tlb)
+    {
+        return SystemDep::Random() % numEntries;
+    }
+
+private:
+    unsigned numEntries;
+};
+
+class NruPolicy : public TlbPolicy {
+public:
+    NruPolicy(unsigned size)
+    {
+        numEntries = size;
+        hand = 0;
+    }
+
+    unsigned Victim(const TranslationEntry *tlb)
+    {
+        unsigned victim = hand;
+        unsigned best = 4;
+        for (unsigned i = 0; i < numEntries && best > 0; i++) {
+            unsigned index = (hand + i) % numEntries;
+            unsigned rank = 2 * tlb[index].use + tlb[index].dirty;
+            if (rank < best) {
+                victim = index;
+                best = rank;
+            }
+        }
+        hand = (victim + 1) % numEntries;
+        return victim;
+    }
+
+    bool ReadsUseBits() const
+    {
+        return true;
+    }
+
+private:
+    unsigned numEntries;
+    unsigned hand;
+};
+
+TlbPolicy *
+TlbPolicy::Create(TlbReplacement kind, unsigned size)
+{
+    ASSERT(size > 0);
+
+    switch (kind) {
+        case FIFO_TLB:   return new FifoPolicy(size);
+        case RANDOM_TLB: return new RandomPolicy(size);
+        case LRU_TLB:    return new LruPolicy(size);
+        case NRU_TLB:    return new NruPolicy(size);
+    }
+    ASSERT(false);
+    return nullptr;
+}
+
+TlbSimulator::TlbSimulator(TlbReplacement replacement, unsigned numEntries)
+{
+    kind = replacement;
+    size = numEntries;
+    policy = TlbPolicy::Create(kind, size);
+    entries = new TranslationEntry[size];
+    for (unsigned i = 0; i < size; i++) {
+        entries[i].valid = false;
+    }
+    last = 0;
+    hits = misses = evictions = 0;
+}
+
+TlbSimulator::~TlbSimulator()
+{
+    delete policy;
+    delete [] entries;
+}
+
+void
+TlbSimulator::Access(unsigned asid, unsigned vpn, bool writing,
+                     unsigned count)
+{
+    TranslationEntry *e = &entries[last];
+    if (!e->valid || e->virtualPage != vpn || e->asid != asid) {
+        unsigned i = 0;
+        while (i < size && !(entries[i].valid && entries[i].virtualPage == vpn
+                               && entries[i].asid == asid)) {
+            i++;
+        }
+
+        if (i == size) {
+            // Load the page like the kernel does: into a free entry if there
+            // is one, and otherwise where the policy says.
+            misses++;
+            count--;
+            i = 0;
+            while (i < size && entries[i].valid) {
+                i++;
+            }
+            if (i == size) {
+                i = policy->Victim(entries);
+                evictions++;
+                if (policy->ReadsUseBits() && entries[i].use) {
+                    for (unsigned j = 0; j < size; j++) {
+                        entries[j].use = false;
+                    }
+                }
+            }
+            entries[i].valid = true;
+            entries[i].virtualPage = vpn;
+            entries[i].asid = asid;
+            entries[i].use = false;
+            entries[i].dirty = false;
+            policy->Loaded(i);
+        }
+        last = i;
+        e = &entries[i];
+    }
+
+    hits += count;
+    e->use = true;
+    if (writing) {
+        e->dirty = true;
+    }
+    policy->Touch(last);
+}
+
+TlbSweep::TlbSweep(const unsigned *sizes, unsigned n)
+{
+    ASSERT(sizes != nullptr);
+
+    numSizes = n;
+    numSimulators = NUM_TLB_POLICIES * numSizes;
+    simulators = new TlbSimulator * [numSimulators];
+    for (unsigned p = 0; p < NUM_TLB_POLICIES; p++) {
+        for (unsigned s = 0; s < numSizes; s++) {
+            simulators[p * numSizes + s]
+              = new TlbSimulator((TlbReplacement) p, sizes[s]);
+        }
+    }
+}
+
+TlbSweep::~TlbSweep()
+{
+    for (unsigned i = 0; i < numSimulators; i++) {
+        delete simulators[i];
+    }
+    delete [] simulators;
+}
+
+void
+TlbSweep::Print() const
+{
+    if (numSimulators == 0) {
+        return;
+    }
+    unsigned long references = simulators[0]->hits + simulators[0]->misses;
+    printf("TLB sweep: %lu references; misses, miss ratio and evictions "
+           "per size\n", references);
+
+    printf("%8s", "policy");
+    for (unsigned s = 0; s < numSizes; s++) {
+        printf(" %25u", simulators[s]->GetSize());
+    }
+    printf("\n");
+
+    for (unsigned p = 0; p < NUM_TLB_POLICIES; p++) {
+        printf("%8s", TlbReplacementName((TlbReplacement) p));
+        for (unsigned s = 0; s < numSizes; s++) {
+            const TlbSimulator *t = simulators[p * numSizes + s];
+            printf(" %8lu %6.2f%% %8lu", t->misses,
+                   references > 0 ? 100.0 * t->misses / references : 0.0,
+                   t->evictions);
+        }
+        printf("\n");
+    }
+}
@@ -0,0 +1,131 @@
+/// Replacement policies for the TLB, and simulated TLBs to compare them.
+///
+/// The kernel loads the TLB itself, so on a miss it has to pick the entry to
+/// replace whenever every entry is valid.  Each policy keeps its own state
+/// about the entries, updated as they are loaded and used:
+///
+/// * FIFO replaces the entry loaded longest ago.
+/// * RANDOM replaces any entry, with a generator of its own, so that it does
+///   not change the sequence of random yields.
+/// * LRU replaces the entry used longest ago.
+/// * NRU (not recently used) replaces an entry whose `use` bit is clear,
+///   preferring clean ones, and takes the next one after the last victim
+///   among equals.  Once every entry is used, the kernel clears the bits.
+///
+/// A `TlbSweep` runs the references of the workload through simulated TLBs
+/// of several sizes, one per policy, counting their misses.  The simulation
+/// is driven by the references only: invalidations done by the kernel, when
+/// pages are evicted or copied, are not seen.
+///
+/// Copyright (c) 2016-2021 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_VMEM_TLBPOLICY__HH
+#define NACHOS_VMEM_TLBPOLICY__HH
+
+
+#include "machine/translation_entry.hh"
+
+
+enum TlbReplacement {
+    FIFO_TLB,
+    RANDOM_TLB,
+    LRU_TLB,
+    NRU_TLB
+};
+
+const unsigned NUM_TLB_POLICIES = 4;
+
+/// Name of `kind`, as given on the command line.
+const char *TlbReplacementName(TlbReplacement kind);
+
+/// Policy that picks a TLB entry to replace.
+class TlbPolicy {
+public:
+
+    /// Make a policy of `kind` for a TLB of `size` entries.
+    static TlbPolicy *Create(TlbReplacement kind, unsigned size);
+
+    virtual ~TlbPolicy() {}
+
+    /// Entry `index` was used by a translation.
+    virtual void Touch(unsigned index) {}
+
+    /// Entry `index` was loaded.
+    virtual void Loaded(unsigned index) {}
+
+    /// Choose the entry of `tlb` to replace, every entry being valid.
+    virtual unsigned Victim(const TranslationEntry *tlb) = 0;
+
+    /// Whether the policy reads the `use` bits, which then have to be
+    /// cleared whenever the victim has it set.
+    virtual bool ReadsUseBits() const
+    {
+        return false;
+    }
+};
+
+/// A TLB of any size, fed with the references of the real one.
+class TlbSimulator {
+public:
+
+    TlbSimulator(TlbReplacement kind, unsigned size);
+
+    ~TlbSimulator();
+
+    /// Page `vpn` of the space with identifier `asid` was referenced
+    /// `count` times in a row, and written if `writing`.
+    void Access(unsigned asid, unsigned vpn, bool writing, unsigned count);
+
+    TlbReplacement GetKind() const
+    {
+        return kind;
+    }
+
+    unsigned GetSize() const
+    {
+        return size;
+    }
+
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+
+private:
+    TlbReplacement kind;
+    TlbPolicy *policy;
+    TranslationEntry *entries;
+    unsigned size;
+
+    /// Entry that matched last, checked first.
+    unsigned last;
+};
+
+/// Simulated TLBs of every policy and several sizes.
+class TlbSweep {
+public:
+
+    /// Simulate TLBs of each of the `numSizes` sizes in `sizes`.
+    TlbSweep(const unsigned *sizes, unsigned numSizes);
+
+    ~TlbSweep();
+
+    void Access(unsigned asid, unsigned vpn, bool writing, unsigned count)
+    {
+        for (unsigned i = 0; i < numSimulators; i++) {
+            simulators[i]->Access(asid, vpn, writing, count);
+        }
+    }
+
+    /// Print the misses of every simulated TLB, one row per policy.
+    void Print() const;
+
+private:
+    TlbSimulator **simulators;
+    unsigned numSimulators;
+    unsigned numSizes;
+};
+
+
+#endif